@@ -0,0 +1,139 @@
+/** \ingroup benchmarks
+ * \{
+ *
+ * \file benchmarks/allocation_replay.hpp
+ * \brief This file contains the replay of allocation
+ *        traces against arbitrary memory resources.
+ */
+
+#ifndef H_benchmarks_allocation_replay
+#define H_benchmarks_allocation_replay
+
+#include "harness.hpp"
+
+#include "kernel/recording_resource.hpp"
+#include "target/target.hpp"
+
+#include <memory_resource>
+#include <unordered_map>
+#include <algorithm>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+
+namespace UtopiaOS
+{
+    namespace benchmarks
+    {
+        /** \struct replay_outcome
+         * \brief The figures of a replay besides the latencies.
+         */
+        struct replay_outcome
+        {
+            std::size_t failures; /**< Allocations the resource could not satisfy */
+            std::size_t unmatched; /**< Deallocations of memory the trace did not allocate */
+            std::size_t skipped; /**< Incomplete records and recorded failures */
+            std::size_t peak_live_bytes; /**< The largest number of requested bytes in use */
+        };
+        
+        /** \brief How many records a replay processes between
+         *         two samples of its footprint.
+         */
+        static constexpr std::size_t replay_sample_interval = 256;
+        
+        /** \brief Replays an allocation trace.
+         * \param[in] trace The trace
+         * \param[in] r The resource to replay the requests on
+         * \param[inout] latencies The recorder of the latencies
+         *               of all replayed requests
+         * \param[in] probe The probe of the footprint, which is
+         *            sampled every \a replay_sample_interval
+         *            records and at the end of the trace
+         * \returns The figures of the replay
+         *
+         * Every request is made on behalf of the processor that
+         * made it originally, so that per-processor resources see
+         * the same distribution. Memory that is still allocated
+         * at the end of the trace is freed without being measured.
+         * Deallocations whose allocation is not in the trace, e.g.
+         * because it was made before recording started or its
+         * record was dropped, are skipped.
+         */
+        inline replay_outcome replay_trace( const kernel::allocation_trace_view &trace,
+                                           std::pmr::memory_resource *r,
+                                           latency_recorder &latencies,
+                                           const peak_probe &probe )
+        {
+            struct live_block
+            {
+                void *p;
+                std::size_t bytes;
+                std::size_t alignment;
+            };
+            
+            replay_outcome outcome = { 0, 0, 0, 0 };
+            std::unordered_map<std::uint64_t, live_block> live;
+            live.reserve( trace.size() );
+            std::size_t live_bytes = 0;
+            
+            unsigned cpu = target::hosted_cpu;
+            for( std::size_t i = 0; i != trace.size(); ++i )
+            {
+                if( i % replay_sample_interval == 0 )
+                    probe.sample();
+                
+                kernel::allocation_event event;
+                if( trace.read( i, event ) == false ||
+                   event.kind == kernel::allocation_event_kind::failure )
+                {
+                    ++outcome.skipped;
+                    continue;
+                }
+                
+                target::hosted_cpu = event.cpu % UTOPIAOS_KERNEL_MAX_CPUS;
+                if( event.kind == kernel::allocation_event_kind::allocate )
+                {
+                    live_block block = { nullptr, std::size_t( event.bytes ), event.alignment };
+                    try
+                    {
+                        block.p = latencies.measure( [&] {
+                            return r->allocate( block.bytes, block.alignment );
+                        } );
+                    } catch( const std::bad_alloc & )
+                    {
+                        ++outcome.failures;
+                        continue;
+                    }
+                    
+                    live[event.address] = block;
+                    live_bytes += block.bytes;
+                    outcome.peak_live_bytes = std::max( outcome.peak_live_bytes, live_bytes );
+                } else
+                {
+                    auto it = live.find( event.address );
+                    if( it == live.end() )
+                    {
+                        ++outcome.unmatched;
+                        continue;
+                    }
+                    
+                    const live_block &block = it->second;
+                    latencies.measure( [&] { r->deallocate( block.p, block.bytes, block.alignment ); } );
+                    live_bytes -= block.bytes;
+                    live.erase( it );
+                }
+            }
+            
+            probe.sample();
+            for( const auto &entry : live )
+                r->deallocate( entry.second.p, entry.second.bytes, entry.second.alignment );
+            
+            target::hosted_cpu = cpu;
+            return outcome;
+        }
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,664 @@
+/** \ingroup benchmarks
+ * \{
+ *
+ * \file benchmarks/allocator_benchmarks.cpp
+ * \brief This file contains the benchmarks of the
+ *        kernel allocators.
+ *
+ * Usage: allocator_benchmarks [--quick]
+ *
+ * With \a --quick the sizes are reduced, so that a run
+ * finishes within seconds. Every row reports the number of
+ * operations, the throughput, the latency percentiles and
+ * the peak memory. The peak is taken from the upstream
+ * resource where there is one, and otherwise from the pages
+ * the allocator takes from its page frame allocators during
+ * the run. The rows of the memory manager itself report none.
+ */
+
+#include "harness.hpp"
+#include "synthetic_memory_map.hpp"
+
+#include "kernel/memory_manager.hpp"
+#include "kernel/boot_profile.hpp"
+#include "kernel/memory_map.hpp"
+#include "kernel/buddy_resource.hpp"
+#include "kernel/cached_buddy_resource.hpp"
+#include "kernel/headerless_buddy_resource.hpp"
+#include "kernel/static_buddy_resource.hpp"
+#include "kernel/distributed_resource.hpp"
+#include "kernel/page_frame_region.hpp"
+#include "kernel/fallible_resource.hpp"
+#include "target/target.hpp"
+#include "io/logger.hpp"
+
+#include <memory_resource>
+#include <type_traits>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+
+using namespace UtopiaOS;
+using namespace benchmarks;
+
+namespace
+{
+    /** \brief The sizes of the random-size pattern */
+    std::size_t random_size( std::mt19937 &random )
+    {
+        // Small requests dominate, as they do in the kernel.
+        std::uniform_int_distribution<int> exponent( 4, 12 );
+        std::uniform_int_distribution<std::size_t> jitter( 0, 15 );
+        return (std::size_t( 1 ) << exponent( random )) - jitter( random );
+    }
+
+    /** \brief Allocates memory without ending the run
+     *         once the resource is exhausted.
+     * \tparam Resource The type the request is bound to
+     * \param[in] r The resource
+     * \param[in] bytes The size of the request
+     * \param[inout] failures The counter of failed requests
+     * \returns The memory or \a nullptr if the request failed.
+     */
+    template<class Resource>
+    void *allocate( Resource *r, std::size_t bytes, std::size_t &failures )
+    {
+        void *p = nullptr;
+        if constexpr( std::is_base_of<kernel::fallible_resource, Resource>::value )
+            p = r->try_allocate( bytes );
+        else
+        {
+            // Catching the exception costs nothing until one is
+            // thrown, unlike resolving the resource every time.
+            try
+            {
+                p = r->allocate( bytes );
+            } catch( const std::bad_alloc & )
+            {
+            }
+        }
+        
+        failures += (p == nullptr);
+        return p;
+    }
+    
+    /** \brief Frees memory returned by \a allocate. */
+    template<class Resource>
+    void deallocate( Resource *r, void *p, std::size_t bytes )
+    {
+        if( p != nullptr )
+            r->deallocate( p, bytes );
+    }
+    
+    /** \brief Allocates blocks and frees them in reverse order.
+     * \tparam Resource The type the requests are bound to
+     */
+    template<class Resource>
+    result lifo( const std::string &name, Resource *r,
+                std::size_t count, std::size_t bytes, const peak_probe &probe )
+    {
+        std::vector<void *> blocks( count );
+        latency_recorder latencies( 2 * count );
+        std::size_t failures = 0;
+
+        auto begin = benchmark_clock::now();
+        for( std::size_t i = 0; i != count; ++i )
+            blocks[i] = latencies.measure( [&] { return allocate( r, bytes, failures ); } );
+        probe.sample();
+        for( std::size_t i = count; i != 0; --i )
+            latencies.measure( [&] { deallocate( r, blocks[i - 1], bytes ); } );
+        auto end = benchmark_clock::now();
+
+        return summarize( name + "/lifo", latencies, nanoseconds( begin, end ), probe.peak(),
+                         failures );
+    }
+
+    /** \brief Allocates blocks and frees them in the same order.
+     * \tparam Resource The type the requests are bound to
+     */
+    template<class Resource>
+    result fifo( const std::string &name, Resource *r,
+                std::size_t count, std::size_t bytes, const peak_probe &probe )
+    {
+        std::vector<void *> blocks( count );
+        latency_recorder latencies( 2 * count );
+        std::size_t failures = 0;
+
+        auto begin = benchmark_clock::now();
+        for( std::size_t i = 0; i != count; ++i )
+            blocks[i] = latencies.measure( [&] { return allocate( r, bytes, failures ); } );
+        probe.sample();
+        for( std::size_t i = 0; i != count; ++i )
+            latencies.measure( [&] { deallocate( r, blocks[i], bytes ); } );
+        auto end = benchmark_clock::now();
+
+        return summarize( name + "/fifo", latencies, nanoseconds( begin, end ), probe.peak(),
+                         failures );
+    }
+    
+    /** \brief How many operations a run performs between
+     *         two samples of its footprint.
+     */
+    static constexpr std::size_t sample_interval = 1024;
+
+    /** \brief Keeps a working set of random-size blocks and
+     *         replaces random members of it.
+     * \param[in] latencies The recorder of the latencies
+     * \param[in] r The resource
+     * \param[in] working_set The number of live blocks
+     * \param[in] operations The number of replacements
+     * \param[in] seed The seed of the sizes and victims
+     * \param[inout] failures The counter of failed allocations
+     * \param[in] probe The probe, which is sampled every
+     *            \a sample_interval replacements
+     */
+    void random_churn( latency_recorder &latencies, std::pmr::memory_resource *r,
+                      std::size_t working_set, std::size_t operations, unsigned seed,
+                      std::size_t &failures, const peak_probe &probe )
+    {
+        std::mt19937 random( seed );
+        std::vector<std::pair<void *, std::size_t>> blocks( working_set );
+
+        for( auto &block : blocks )
+        {
+            block.second = random_size( random );
+            block.first = latencies.measure( [&] { return allocate( r, block.second, failures ); } );
+        }
+        probe.sample();
+
+        std::uniform_int_distribution<std::size_t> victim( 0, working_set - 1 );
+        for( std::size_t i = 0; i != operations; ++i )
+        {
+            auto &block = blocks[victim( random )];
+            latencies.measure( [&] { deallocate( r, block.first, block.second ); } );
+            block.second = random_size( random );
+            block.first = latencies.measure( [&] { return allocate( r, block.second, failures ); } );
+            
+            if( (i + 1) % sample_interval == 0 )
+                probe.sample();
+        }
+
+        for( auto &block : blocks )
+            latencies.measure( [&] { deallocate( r, block.first, block.second ); } );
+    }
+
+    result random_sizes( const std::string &name, std::pmr::memory_resource *r,
+                        std::size_t working_set, std::size_t operations,
+                        const peak_probe &probe )
+    {
+        latency_recorder latencies( 2 * (working_set + operations) );
+        std::size_t failures = 0;
+
+        auto begin = benchmark_clock::now();
+        random_churn( latencies, r, working_set, operations, 42, failures, probe );
+        auto end = benchmark_clock::now();
+
+        return summarize( name + "/random-size", latencies, nanoseconds( begin, end ),
+                         probe.peak(), failures );
+    }
+
+    /** \brief One thread allocates, another one frees.
+     *
+     * The threads act as different processors, so that
+     * every block is freed remotely. A failed allocation is
+     * passed on as the address of the ring, which is never
+     * freed.
+     */
+    result producer_consumer( const std::string &name, std::pmr::memory_resource *r,
+                             std::size_t count, std::size_t bytes, const peak_probe &probe )
+    {
+        static constexpr std::size_t ring_size = 1024;
+        std::vector<std::atomic<void *>> ring( ring_size );
+        for( auto &slot : ring )
+            slot.store( nullptr, std::memory_order_relaxed );
+
+        latency_recorder produced( count ), consumed( count );
+        std::size_t failures = 0;
+        void *failed = &ring;
+
+        auto begin = benchmark_clock::now();
+        std::thread producer( [&] {
+            target::hosted_cpu = 1;
+            for( std::size_t i = 0; i != count; ++i )
+            {
+                void *p = produced.measure( [&] { return allocate( r, bytes, failures ); } );
+                if( p == nullptr )
+                    p = failed;
+                if( (i + 1) % sample_interval == 0 )
+                    probe.sample();
+                
+                std::atomic<void *> &slot = ring[i % ring_size];
+                while( slot.load( std::memory_order_acquire ) != nullptr )
+                    std::this_thread::yield();
+                slot.store( p, std::memory_order_release );
+            }
+        } );
+        std::thread consumer( [&] {
+            target::hosted_cpu = 2;
+            for( std::size_t i = 0; i != count; ++i )
+            {
+                std::atomic<void *> &slot = ring[i % ring_size];
+                void *p;
+                while( (p = slot.load( std::memory_order_acquire )) == nullptr )
+                    std::this_thread::yield();
+                slot.store( nullptr, std::memory_order_release );
+                if( p != failed )
+                    consumed.measure( [&] { r->deallocate( p, bytes ); } );
+            }
+        } );
+        producer.join();
+        consumer.join();
+        auto end = benchmark_clock::now();
+
+        produced.merge( consumed );
+        return summarize( name + "/producer-consumer", produced, nanoseconds( begin, end ),
+                         probe.peak(), failures );
+    }
+
+    /** \brief Runs the random-size pattern on several
+     *         threads, each acting as its own processor.
+     */
+    result multi_threaded( const std::string &name, std::pmr::memory_resource *r,
+                          unsigned num_threads, std::size_t working_set,
+                          std::size_t operations, const peak_probe &probe )
+    {
+        std::vector<latency_recorder> latencies;
+        for( unsigned t = 0; t != num_threads; ++t )
+            latencies.emplace_back( 2 * (working_set + operations) );
+        std::vector<std::size_t> failures( num_threads, 0 );
+
+        auto begin = benchmark_clock::now();
+        std::vector<std::thread> threads;
+        for( unsigned t = 0; t != num_threads; ++t )
+            threads.emplace_back( [&, t] {
+                target::hosted_cpu = t;
+                random_churn( latencies[t], r, working_set, operations, 42 + t, failures[t],
+                             probe );
+            } );
+        for( std::thread &thread : threads )
+            thread.join();
+        auto end = benchmark_clock::now();
+
+        for( unsigned t = 1; t != num_threads; ++t )
+            latencies[0].merge( latencies[t] );
+
+        return summarize( name + "/multi-threaded-" + std::to_string( num_threads ),
+                         latencies[0], nanoseconds( begin, end ), probe.peak(),
+                         std::accumulate( failures.begin(), failures.end(), std::size_t( 0 ) ) );
+    }
+
+    /** \brief How much the construction time per descriptor may
+     *         grow from the first map of at least 1000 descriptors
+     *         to the largest one before it is reported.
+     */
+    static constexpr double max_construction_growth = 3.0;
+    
+    /** \brief Times the construction of memory managers and
+     *         checks that it scales linearly with the map.
+     */
+    void construction( const std::vector<std::size_t> &sizes )
+    {
+        for( bool sorted : { true, false } )
+        {
+            std::string name = std::string( "memory_manager/construct/" ) +
+                               (sorted ? "sorted" : "unsorted");
+            double baseline = 0.0, growth = 0.0;
+            std::size_t baseline_size = 0, largest_size = 0;
+            
+            for( std::size_t num_descriptors : sizes )
+            {
+                synthetic_memory_map map( num_descriptors, sorted );
+                std::vector<char> conversion_memory;
+
+                std::size_t repetitions = std::max( std::size_t( 1 ), 2000 / num_descriptors );
+                latency_recorder latencies( repetitions );
+
+                auto begin = benchmark_clock::now();
+                for( std::size_t i = 0; i != repetitions; ++i )
+                {
+                    auto manager = latencies.measure( [&] {
+                        return construct_memory_manager( map, conversion_memory );
+                    } );
+                }
+                auto end = benchmark_clock::now();
+
+                result r = summarize( name + "/" + std::to_string( num_descriptors ),
+                                     latencies, nanoseconds( begin, end ), 0 );
+                print( r );
+                
+                if( num_descriptors < 1000 )
+                    continue;
+                
+                double per_descriptor = double( r.p50 ) / double( num_descriptors );
+                if( baseline_size == 0 )
+                {
+                    baseline = per_descriptor;
+                    baseline_size = num_descriptors;
+                } else
+                {
+                    growth = per_descriptor / baseline;
+                    largest_size = num_descriptors;
+                }
+            }
+            
+            if( largest_size == 0 )
+                continue;
+            
+            std::printf( "%-44s %9.2fx per descriptor from %zu to %zu\n",
+                        (name + "/scaling").c_str(), growth, baseline_size, largest_size );
+            if( growth > max_construction_growth )
+                std::fprintf( stderr, "%s does not scale linearly\n", name.c_str() );
+        }
+    }
+
+    /** \brief Times how long several threads, each acting as
+     *         its own processor, take to set up the memory whose
+     *         setup a memory manager deferred upon construction.
+     *
+     * The map consists of large regions, so that most of its
+     * memory is deferred.
+     */
+    void deferred_initialization( std::size_t repetitions )
+    {
+        synthetic_memory_map map( 64, true, 1, std::size_t( 1 ) << 20 );
+        std::vector<char> conversion_memory;
+        
+        for( unsigned num_threads : { 1u, 2u, 4u, 8u } )
+        {
+            latency_recorder latencies( repetitions );
+            std::uint64_t elapsed = 0;
+            for( std::size_t i = 0; i != repetitions; ++i )
+            {
+                kernel::memory_manager manager = construct_memory_manager( map, conversion_memory );
+                
+                auto begin = benchmark_clock::now();
+                latencies.measure( [&] {
+                    std::vector<std::thread> threads;
+                    for( unsigned t = 0; t != num_threads; ++t )
+                        threads.emplace_back( [&manager, t] {
+                            target::hosted_cpu = t;
+                            initialize_all_memory( manager );
+                        } );
+                    for( std::thread &thread : threads )
+                        thread.join();
+                } );
+                elapsed += nanoseconds( begin, benchmark_clock::now() );
+                
+                if( manager.all_memory_available() == false )
+                    std::fprintf( stderr, "deferred memory was not published\n" );
+            }
+            
+            print( summarize( "memory_manager/initialize-deferred-" + std::to_string( num_threads ),
+                             latencies, elapsed, 0 ) );
+        }
+    }
+    
+    /** \struct stdout_logger
+     * \brief A logger that prints every call as a line.
+     */
+    struct stdout_logger : public io::logger
+    {
+        virtual void log( unsigned number_of_strings, ... ) override
+        {
+            va_list args;
+            va_start( args, number_of_strings );
+            for( ; number_of_strings != 0; --number_of_strings )
+                std::fputs( va_arg( args, io::const_stringref ), stdout );
+            va_end( args );
+            std::fputc( '\n', stdout );
+        }
+    };
+    
+    /** \brief Prints the boot profile of the construction
+     *         of a memory manager from an unsorted map.
+     */
+    void boot_profile( std::size_t num_descriptors )
+    {
+        synthetic_memory_map map( num_descriptors, false );
+        std::vector<char> conversion_memory;
+        
+        kernel::reset_boot_profile();
+        {
+            kernel::boot_phase phase( "memory manager" );
+            construct_memory_manager( map, conversion_memory );
+        }
+        
+        stdout_logger logger;
+        std::printf( "\nboot profile of memory_manager/construct/unsorted/%zu\n", num_descriptors );
+        kernel::log_boot_profile( &logger );
+        std::printf( "\n" );
+    }
+    
+    void buddy( std::size_t count )
+    {
+        static constexpr std::size_t arena = std::size_t( 1 ) << 20;
+
+        {
+            tracking_resource upstream;
+            kernel::buddy_resource buddy( 64, arena, arena, &upstream );
+            print( lifo( "buddy_resource", &buddy, count, 256, peak_probe( &upstream ) ) );
+            print( fifo( "buddy_resource", &buddy, count, 256, peak_probe( &upstream ) ) );
+            print( random_sizes( "buddy_resource", &buddy, count / 10, count,
+                                peak_probe( &upstream ) ) );
+        }
+
+        {
+            tracking_resource upstream;
+            kernel::buddy_resource buddy( 64, arena, arena, &upstream );
+            kernel::cached_buddy_resource cache( &buddy, arena / 16 );
+            print( lifo( "cached_buddy_resource", &cache, count, 256, peak_probe( &upstream ) ) );
+            print( fifo( "cached_buddy_resource", &cache, count, 256, peak_probe( &upstream ) ) );
+            print( random_sizes( "cached_buddy_resource", &cache, count / 10, count,
+                                peak_probe( &upstream ) ) );
+        }
+        
+        {
+            // The direct rows bind to the concrete type and
+            // show the cost of the virtual interface.
+            tracking_resource upstream;
+            kernel::static_buddy_resource<64, arena, arena> buddy( &upstream );
+            std::pmr::memory_resource *r = &buddy;
+            print( lifo( "static_buddy_resource", r, count, 256, peak_probe( &upstream ) ) );
+            print( fifo( "static_buddy_resource", r, count, 256, peak_probe( &upstream ) ) );
+            print( random_sizes( "static_buddy_resource", r, count / 10, count,
+                                peak_probe( &upstream ) ) );
+            print( lifo( "static_buddy_resource/direct", &buddy, count, 256,
+                        peak_probe( &upstream ) ) );
+            print( fifo( "static_buddy_resource/direct", &buddy, count, 256,
+                        peak_probe( &upstream ) ) );
+        }
+        
+        {
+            tracking_resource upstream;
+            kernel::headerless_buddy_resource buddy( 64, arena, &upstream );
+            print( lifo( "headerless_buddy_resource", &buddy, count, 256, peak_probe( &upstream ) ) );
+            print( fifo( "headerless_buddy_resource", &buddy, count, 256, peak_probe( &upstream ) ) );
+            print( random_sizes( "headerless_buddy_resource", &buddy, count / 10, count,
+                                peak_probe( &upstream ) ) );
+        }
+    }
+    
+    /** \brief Allocates blocks of a given size from a resource
+     *         and returns the bytes it held at its peak.
+     */
+    template<class Resource>
+    std::size_t held_bytes( std::size_t count, std::size_t bytes )
+    {
+        static constexpr std::size_t arena = std::size_t( 1 ) << 20;
+        tracking_resource upstream;
+        std::size_t failures = 0;
+        {
+            Resource buddy( 64, arena, &upstream );
+            std::vector<void *> blocks( count );
+            for( void *&block : blocks )
+                block = allocate( &buddy, bytes, failures );
+            for( void *block : blocks )
+                deallocate( &buddy, block, bytes );
+        }
+        
+        if( failures != 0 )
+            std::printf( "    %zu allocations failed\n", failures );
+        return upstream.peak_bytes();
+    }
+    
+    /** \brief Compares the memory the buddy resources hold for
+     *         power-of-two requests, which the header of a
+     *         \a buddy_resource doubles.
+     */
+    void footprint( std::size_t count )
+    {
+        // The arenas of both are a single top-level block.
+        struct single_arena_buddy : kernel::buddy_resource
+        {
+            single_arena_buddy( std::size_t min_bs, std::size_t max_bs, std::pmr::memory_resource *upstream )
+            : kernel::buddy_resource( min_bs, max_bs, max_bs, upstream ) {}
+        };
+        
+        std::printf( "\n%-44s %12s %12s %12s\n", "footprint", "requested KiB",
+                    "buddy KiB", "headerless KiB" );
+        for( std::size_t bytes = 64; bytes <= kernel::pagesize; bytes <<= 2 )
+        {
+            // Every size requests the same number of bytes.
+            std::size_t blocks = std::max( count * 256 / bytes, std::size_t( 1 ) );
+            std::printf( "%-44s %12zu %12zu %12zu\n",
+                        ("held/" + std::to_string( bytes )).c_str(),
+                        blocks * bytes / 1024,
+                        held_bytes<single_arena_buddy>( blocks, bytes ) / 1024,
+                        held_bytes<kernel::headerless_buddy_resource>( blocks, bytes ) / 1024 );
+        }
+        std::printf( "\n" );
+    }
+
+    void distributed( const std::vector<std::size_t> &sizes )
+    {
+        static constexpr std::size_t pages_per_region = 8;
+        const std::size_t region_size = pages_per_region * kernel::pagesize;
+
+        for( std::size_t num_regions : sizes )
+        {
+            // The resource allocates its routing table from
+            // the first region, which is made large enough.
+            std::size_t first_size = std::max( region_size,
+                ((num_regions * 256 + kernel::pagesize - 1) / kernel::pagesize) * kernel::pagesize );
+
+            // The regions are laid out with gaps, as
+            // they are in a real memory map.
+            std::size_t mapping_size = first_size + 2 * num_regions * region_size;
+            void *mapping = mmap( nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+            if( mapping == MAP_FAILED )
+                throw std::bad_alloc();
+
+            std::uintptr_t base = (target::ptr_to_uintptr( mapping ) + kernel::pagesize - 1) &
+                ~(kernel::pagesize - 1);
+            std::vector<target::memory_region> regions = { { base, first_size } };
+            for( std::size_t i = 1; i != num_regions; ++i )
+                regions.push_back( { base + first_size + 2 * i * region_size, region_size } );
+
+            std::size_t first_words = kernel::page_frame_region::bitmap_words( regions[0],
+                                                                              kernel::pagesize );
+            std::size_t words = kernel::page_frame_region::bitmap_words( regions.back(),
+                                                                        kernel::pagesize );
+            std::vector<std::size_t> bitmaps( first_words + words * num_regions );
+
+            std::allocator<kernel::page_frame_region> allocator;
+            kernel::page_frame_region *frames = allocator.allocate( num_regions );
+            std::vector<std::pmr::memory_resource *> resources;
+            for( std::size_t i = 0; i != num_regions; ++i )
+            {
+                std::size_t *bitmap = bitmaps.data() + (i == 0 ? 0 : first_words + i * words);
+                new (frames + i) kernel::page_frame_region( regions[i], kernel::pagesize, bitmap );
+                resources.push_back( frames + i );
+            }
+
+            {
+                kernel::distributed_resource pages( resources.begin(), resources.end(),
+                                                   regions.begin(), kernel::pagesize );
+                auto free_pages = [&] ( void ) {
+                    std::size_t sum = 0;
+                    for( std::size_t i = 0; i != num_regions; ++i )
+                        sum += frames[i].free_pages();
+                    return sum;
+                };
+                std::size_t free_before = free_pages();
+                auto footprint = [&] ( void ) {
+                    return (free_before - free_pages()) * kernel::pagesize;
+                };
+
+                std::size_t count = std::min( (num_regions - 1) * pages_per_region,
+                                             std::size_t( 200000 ) );
+                std::string name = "distributed_resource/" + std::to_string( num_regions );
+                print( lifo( name, &pages, count, kernel::pagesize, peak_probe( footprint ) ) );
+                print( fifo( name, &pages, count, kernel::pagesize, peak_probe( footprint ) ) );
+            }
+
+            for( std::size_t i = 0; i != num_regions; ++i )
+                frames[i].~page_frame_region();
+            allocator.deallocate( frames, num_regions );
+            munmap( mapping, mapping_size );
+        }
+    }
+
+    void synchronized( std::size_t count )
+    {
+        // About half of the regions after the first one are
+        // conventional memory. Together they hold the largest
+        // working set, the blocks of lifo and fifo, several times
+        // over, so that the runs measure the allocator rather
+        // than its exhaustion.
+        static constexpr std::size_t num_descriptors = 1000;
+        std::size_t max_region_pages = std::max( std::size_t( 16 ),
+            8 * count * 256 / kernel::pagesize / (num_descriptors / 2) );
+        
+        synthetic_memory_map map( num_descriptors, true, 1, max_region_pages );
+        std::vector<char> conversion_memory;
+        kernel::memory_manager manager = construct_memory_manager( map, conversion_memory );
+        initialize_all_memory( manager );
+
+        unsigned num_threads = std::clamp( std::thread::hardware_concurrency(), 2u,
+                                          unsigned( UTOPIAOS_KERNEL_MAX_CPUS ) );
+        std::pmr::memory_resource *r = manager.synchronized_resource();
+        const std::string name = "synchronized_resource";
+
+        print( lifo( name, r, count, 256, footprint_probe( manager ) ) );
+        print( fifo( name, r, count, 256, footprint_probe( manager ) ) );
+        print( random_sizes( name, r, count / 10, count, footprint_probe( manager ) ) );
+        print( producer_consumer( name, r, count, 256, footprint_probe( manager ) ) );
+        print( multi_threaded( name, r, num_threads, count / 10 / num_threads,
+                              count / num_threads, footprint_probe( manager ) ) );
+    }
+}
+
+int main( int argc, char **argv )
+{
+    bool quick = (argc > 1 && std::strcmp( argv[1], "--quick" ) == 0);
+
+    std::vector<std::size_t> sizes = { 10, 100, 1000, 10000, 100000 };
+    if( quick )
+        sizes.resize( 3 );
+
+    std::size_t count = (quick ? 10000 : 100000);
+
+    print_header();
+    construction( quick ? std::vector<std::size_t>{ 10, 100, 1000, 10000 } : sizes );
+    deferred_initialization( quick ? 3 : 10 );
+    boot_profile( sizes.back() );
+    print_header();
+    buddy( count );
+    footprint( count );
+    print_header();
+    distributed( sizes );
+    synchronized( count );
+
+    return 0;
+}
+
+/** \} */
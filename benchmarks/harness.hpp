@@ -0,0 +1,254 @@
+/** \defgroup benchmarks Benchmarks
+ * \brief Hosted microbenchmarks of the kernel allocators.
+ * \{
+ *
+ * \file benchmarks/harness.hpp
+ * \brief This file contains the measuring and reporting
+ *        facilities shared by the benchmarks.
+ */
+
+#ifndef H_benchmarks_harness
+#define H_benchmarks_harness
+
+#include <memory_resource>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+namespace UtopiaOS
+{
+    namespace benchmarks
+    {
+        using benchmark_clock = std::chrono::steady_clock;
+        
+        /** \brief Returns the nanoseconds between two points in time. */
+        inline std::uint64_t nanoseconds( benchmark_clock::time_point begin,
+                                         benchmark_clock::time_point end )
+        {
+            return static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>( end - begin ).count() );
+        }
+        
+        /** \class latency_recorder
+         * \brief Collects the latencies of single operations.
+         *
+         * Every sample includes the cost of reading the clock
+         * twice, which is in the order of 20ns.
+         */
+        class latency_recorder
+        {
+        private:
+            std::vector<std::uint64_t> samples;
+        public:
+            /** \brief Reserves room for a number of samples,
+             *         so that recording does not allocate.
+             */
+            explicit latency_recorder( std::size_t expected_samples = 0 )
+            { samples.reserve( expected_samples ); }
+            
+            /** \brief Runs a function and records its latency.
+             * \tparam Function The function object type
+             * \param[in] f The function to run
+             * \returns What \a f returns.
+             */
+            template<class Function>
+            auto measure( Function f )
+            {
+                auto begin = benchmark_clock::now();
+                if constexpr( std::is_void<decltype( f() )>::value )
+                {
+                    f();
+                    samples.push_back( nanoseconds( begin, benchmark_clock::now() ) );
+                } else
+                {
+                    auto result = f();
+                    samples.push_back( nanoseconds( begin, benchmark_clock::now() ) );
+                    return result;
+                }
+            }
+            
+            /** \brief Appends the samples of another recorder. */
+            void merge( const latency_recorder &other )
+            { samples.insert( samples.end(), other.samples.begin(), other.samples.end() ); }
+            
+            std::size_t size( void ) const
+            { return samples.size(); }
+            
+            /** \brief Returns a percentile of the latencies.
+             * \param[in] p The percentile, between \a 0 and \a 100
+             * \returns The latency in nanoseconds below which
+             *          \a p percent of the samples lie.
+             */
+            std::uint64_t percentile( double p )
+            {
+                if( samples.empty() )
+                    return 0;
+                
+                auto index = static_cast<std::size_t>( p / 100.0 * double( samples.size() - 1 ) );
+                std::nth_element( samples.begin(), samples.begin() + index, samples.end() );
+                return samples[index];
+            }
+        };
+        
+        /** \class tracking_resource
+         * \brief A thread-safe memory resource that forwards to
+         *        another one and keeps track of the number of
+         *        bytes in use.
+         */
+        class tracking_resource : public std::pmr::memory_resource
+        {
+        private:
+            std::pmr::memory_resource *upstream;
+            std::atomic<std::size_t> current;
+            std::atomic<std::size_t> peak;
+            
+            virtual void* do_allocate( std::size_t bytes, std::size_t alignment ) override
+            {
+                void *p = upstream->allocate( bytes, alignment );
+                
+                std::size_t now = current.fetch_add( bytes, std::memory_order_relaxed ) + bytes;
+                std::size_t old_peak = peak.load( std::memory_order_relaxed );
+                while( now > old_peak &&
+                      peak.compare_exchange_weak( old_peak, now, std::memory_order_relaxed ) == false )
+                {}
+                
+                return p;
+            }
+            
+            virtual void do_deallocate( void* p, std::size_t bytes, std::size_t alignment ) override
+            {
+                current.fetch_sub( bytes, std::memory_order_relaxed );
+                upstream->deallocate( p, bytes, alignment );
+            }
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override
+            { return (this == &other); }
+        public:
+            explicit tracking_resource( std::pmr::memory_resource *up
+                                           = std::pmr::new_delete_resource() )
+            : upstream( up ), current( 0 ), peak( 0 ) {}
+            
+            /** \brief Returns the largest number of bytes
+             *         that were in use at once.
+             */
+            std::size_t peak_bytes( void ) const
+            { return peak.load( std::memory_order_relaxed ); }
+        };
+        
+        /** \struct peak_probe
+         * \brief Measures the peak memory of a run, either by
+         *        a \a tracking_resource or by samples of the
+         *        footprint the allocator reports.
+         *
+         * The footprint is only known where the run calls
+         * \a sample, which it should do whenever it holds the
+         * most memory, from any thread. A probe with neither
+         * reports no memory.
+         */
+        struct peak_probe
+        {
+            const tracking_resource *tracker;
+            std::function<std::size_t( void )> footprint;
+            mutable std::atomic<std::size_t> sampled;
+            
+            explicit peak_probe( const tracking_resource *t = nullptr )
+            : tracker( t ), sampled( 0 ) {}
+            
+            /** \brief Constructs a probe that samples a footprint.
+             * \param[in] f A thread-safe function that returns
+             *            the bytes the allocator holds since
+             *            the start of the run.
+             */
+            explicit peak_probe( std::function<std::size_t( void )> f )
+            : tracker( nullptr ), footprint( std::move( f ) ), sampled( 0 ) {}
+            
+            /** \brief Takes a sample of the footprint. */
+            void sample( void ) const
+            {
+                if( !footprint )
+                    return;
+                
+                std::size_t now = footprint();
+                std::size_t old_peak = sampled.load( std::memory_order_relaxed );
+                while( now > old_peak &&
+                      sampled.compare_exchange_weak( old_peak, now, std::memory_order_relaxed ) == false )
+                {}
+            }
+            
+            std::size_t peak( void ) const
+            {
+                if( tracker != nullptr )
+                    return tracker->peak_bytes();
+                
+                sample();
+                return sampled.load( std::memory_order_relaxed );
+            }
+        };
+        
+        /** \struct result
+         * \brief The outcome of a benchmark.
+         */
+        struct result
+        {
+            std::string name;
+            std::size_t operations;
+            std::uint64_t elapsed_ns;
+            std::uint64_t p50, p90, p99, p999, max;
+            std::size_t peak_bytes;
+            std::size_t failures; /**< Allocations that could not be satisfied */
+        };
+        
+        /** \brief Summarizes the recorded latencies.
+         * \param[in] name The name of the benchmark
+         * \param[in] latencies The latencies of all operations
+         * \param[in] elapsed_ns The wall-clock time of the run
+         * \param[in] peak_bytes The peak memory of the run
+         * \param[in] failures The number of failed allocations
+         */
+        inline result summarize( std::string name, latency_recorder &latencies,
+                                std::uint64_t elapsed_ns, std::size_t peak_bytes,
+                                std::size_t failures = 0 )
+        {
+            return { std::move( name ), latencies.size(), elapsed_ns,
+                     latencies.percentile( 50 ), latencies.percentile( 90 ),
+                     latencies.percentile( 99 ), latencies.percentile( 99.9 ),
+                     latencies.percentile( 100 ), peak_bytes, failures };
+        }
+        
+        /** \brief Prints the header of the result table. */
+        inline void print_header( void )
+        {
+            std::printf( "%-44s %10s %12s %8s %8s %8s %8s %10s %12s\n",
+                        "benchmark", "ops", "ops/s", "p50 ns", "p90 ns",
+                        "p99 ns", "p99.9 ns", "max ns", "peak KiB" );
+        }
+        
+        /** \brief Prints a row of the result table. */
+        inline void print( const result &r )
+        {
+            double seconds = double( r.elapsed_ns ) / 1e9;
+            std::printf( "%-44s %10zu %12.0f %8llu %8llu %8llu %8llu %10llu %12zu\n",
+                        r.name.c_str(), r.operations,
+                        (seconds > 0 ? double( r.operations ) / seconds : 0.0),
+                        static_cast<unsigned long long>( r.p50 ),
+                        static_cast<unsigned long long>( r.p90 ),
+                        static_cast<unsigned long long>( r.p99 ),
+                        static_cast<unsigned long long>( r.p999 ),
+                        static_cast<unsigned long long>( r.max ),
+                        r.peak_bytes / 1024 );
+            if( r.failures != 0 )
+                std::printf( "    %zu allocations failed\n", r.failures );
+            std::fflush( stdout );
+        }
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,203 @@
+/** \ingroup benchmarks
+ * \{
+ *
+ * \file benchmarks/replay_allocations.cpp
+ * \brief This file contains a tool that captures
+ *        and replays allocation traces.
+ *
+ * Usage:
+ *  - replay_allocations --capture <trace> [requests]
+ *  - replay_allocations <trace> [resource...]
+ *
+ * The first form records a synthetic workload into a trace
+ * file. The second one replays a trace, e.g. one saved from
+ * an \a allocation_trace in the kernel, on each of the given
+ * resources, which are \a new_delete, \a buddy, \a cached_buddy,
+ * \a headerless_buddy, \a pages and \a synchronized, or all of
+ * them by default.
+ * Every resource reports the time, the latency percentiles
+ * and the peak footprint of the replay. The footprint of \a pages
+ * and \a synchronized is the number of pages they take from the
+ * page frame allocators of the memory manager.
+ */
+
+#include "harness.hpp"
+#include "allocation_replay.hpp"
+#include "synthetic_memory_map.hpp"
+
+#include "kernel/recording_resource.hpp"
+#include "kernel/buddy_resource.hpp"
+#include "kernel/cached_buddy_resource.hpp"
+#include "kernel/headerless_buddy_resource.hpp"
+#include "kernel/memory_manager.hpp"
+#include "target/target.hpp"
+
+#include <memory_resource>
+#include <stdexcept>
+#include <optional>
+#include <fstream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstring>
+#include <cstdio>
+
+using namespace UtopiaOS;
+using namespace benchmarks;
+
+namespace
+{
+    /** \brief Records a random-size workload spread
+     *         over several processors.
+     * \param[in] path The file to save the trace to
+     * \param[in] requests The number of allocations
+     */
+    void capture( const std::string &path, std::size_t requests )
+    {
+        std::vector<std::uint64_t> storage( 8 + 5 * 2 * requests );
+        kernel::allocation_trace trace( storage.data(), storage.size() * sizeof(std::uint64_t) );
+        kernel::recording_resource recorder( std::pmr::new_delete_resource(), &trace );
+        
+        std::mt19937 random( 1 );
+        std::uniform_int_distribution<int> exponent( 4, 12 );
+        std::vector<std::pair<void *, std::size_t>> blocks( std::max( requests / 10,
+                                                                     std::size_t( 1 ) ) );
+        std::uniform_int_distribution<std::size_t> victim( 0, blocks.size() - 1 );
+        
+        for( std::size_t i = 0; i != requests; ++i )
+        {
+            target::hosted_cpu = i % 4;
+            auto &block = (i < blocks.size() ? blocks[i] : blocks[victim( random )]);
+            if( block.first != nullptr )
+                recorder.deallocate( block.first, block.second );
+            
+            block.second = std::size_t( 1 ) << exponent( random );
+            block.first = recorder.allocate( block.second );
+        }
+        
+        for( auto &block : blocks )
+            recorder.deallocate( block.first, block.second );
+        target::hosted_cpu = 0;
+        
+        std::ofstream file( path, std::ios::binary );
+        file.write( reinterpret_cast<const char *>( storage.data() ),
+                   static_cast<std::streamsize>( trace.used_bytes() ) );
+        if( !file )
+            throw std::runtime_error( "The trace could not be written." );
+        
+        std::printf( "captured %zu bytes into %s\n", trace.used_bytes(), path.c_str() );
+    }
+    
+    /** \brief Reads a trace file into memory aligned to 8 bytes. */
+    std::vector<std::uint64_t> load( const std::string &path, std::size_t &size )
+    {
+        std::ifstream file( path, std::ios::binary | std::ios::ate );
+        if( !file )
+            throw std::runtime_error( "The trace could not be opened." );
+        
+        size = static_cast<std::size_t>( file.tellg() );
+        std::vector<std::uint64_t> storage( (size + sizeof(std::uint64_t) - 1) /
+                                           sizeof(std::uint64_t) );
+        file.seekg( 0 );
+        file.read( reinterpret_cast<char *>( storage.data() ),
+                  static_cast<std::streamsize>( size ) );
+        return storage;
+    }
+    
+    void report( const std::string &resource, const kernel::allocation_trace_view &trace,
+                std::pmr::memory_resource *r, const peak_probe &probe )
+    {
+        latency_recorder latencies( trace.size() );
+        
+        auto begin = benchmark_clock::now();
+        replay_outcome outcome = replay_trace( trace, r, latencies, probe );
+        auto end = benchmark_clock::now();
+        
+        print( summarize( "replay/" + resource, latencies, nanoseconds( begin, end ),
+                         probe.peak() ) );
+        std::printf( "    requested peak %zu KiB, %zu failed, %zu unmatched, %zu skipped\n",
+                    outcome.peak_live_bytes / 1024, outcome.failures,
+                    outcome.unmatched, outcome.skipped );
+    }
+    
+    void replay( const std::string &path, std::vector<std::string> resources )
+    {
+        std::size_t size;
+        std::vector<std::uint64_t> storage = load( path, size );
+        kernel::allocation_trace_view trace( storage.data(), size );
+        
+        std::printf( "%s: %zu records, %llu dropped\n", path.c_str(), trace.size(),
+                    static_cast<unsigned long long>( trace.dropped() ) );
+        
+        if( resources.empty() )
+            resources = { "new_delete", "buddy", "cached_buddy", "headerless_buddy",
+                          "pages", "synchronized" };
+        
+        const std::size_t arena = std::size_t( 1 ) << 20;
+        std::optional<synthetic_memory_map> map;
+        std::vector<char> conversion_memory;
+        
+        print_header();
+        for( const std::string &resource : resources )
+        {
+            tracking_resource upstream;
+            if( resource == "new_delete" )
+                report( resource, trace, &upstream, peak_probe( &upstream ) );
+            else if( resource == "buddy" )
+            {
+                kernel::buddy_resource buddy( 64, arena, arena, &upstream );
+                report( resource, trace, &buddy, peak_probe( &upstream ) );
+            } else if( resource == "cached_buddy" )
+            {
+                kernel::buddy_resource buddy( 64, arena, arena, &upstream );
+                kernel::cached_buddy_resource cache( &buddy, arena / 16 );
+                report( resource, trace, &cache, peak_probe( &upstream ) );
+            } else if( resource == "headerless_buddy" )
+            {
+                kernel::headerless_buddy_resource buddy( 64, arena, &upstream );
+                report( resource, trace, &buddy, peak_probe( &upstream ) );
+            } else if( resource == "pages" || resource == "synchronized" )
+            {
+                if( !map )
+                    map.emplace( 1000, true );
+                
+                kernel::memory_manager manager = construct_memory_manager( *map, conversion_memory );
+                initialize_all_memory( manager );
+                report( resource, trace, (resource == "pages" ? manager.page_resource() :
+                                          manager.synchronized_resource()),
+                       footprint_probe( manager ) );
+            } else
+                throw std::invalid_argument( "Unknown resource: " + resource );
+        }
+    }
+}
+
+int main( int argc, char **argv )
+{
+    if( argc < 2 )
+    {
+        std::fprintf( stderr, "usage: %s --capture <trace> [requests]\n"
+                     "       %s <trace> [resource...]\n", argv[0], argv[0] );
+        return 1;
+    }
+    
+    try
+    {
+        if( std::strcmp( argv[1], "--capture" ) == 0 )
+        {
+            if( argc < 3 )
+                throw std::invalid_argument( "The trace file is missing." );
+            
+            capture( argv[2], (argc > 3 ? std::stoul( argv[3] ) : 100000) );
+        } else
+            replay( argv[1], std::vector<std::string>( argv + 2, argv + argc ) );
+    } catch( const std::exception &e )
+    {
+        std::fprintf( stderr, "%s\n", e.what() );
+        return 1;
+    }
+    
+    return 0;
+}
+
+/** \} */
@@ -0,0 +1,151 @@
+/** \ingroup benchmarks
+ * \{
+ *
+ * \file benchmarks/scheduler_benchmarks.cpp
+ * \brief This file contains the benchmarks of the
+ *        work-stealing scheduler of the kernel.
+ *
+ * Usage: scheduler_benchmarks [--quick]
+ *
+ * Every thread acts as its own processor. The latencies
+ * are those of single spawns or of whole fork-join runs,
+ * that start on one processor and spread by stealing.
+ */
+
+#include "harness.hpp"
+
+#include "kernel/scheduler.hpp"
+#include "target/target.hpp"
+
+#include <memory_resource>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <cstdio>
+
+using namespace UtopiaOS;
+using namespace benchmarks;
+
+namespace
+{
+    /** \brief The number of tasks every processor can have spawned */
+    static constexpr std::size_t tasks_per_processor = 1024;
+    
+    /** \brief The number of leaves below which a range is not split */
+    static constexpr std::size_t leaves_per_task = 16;
+    
+    /** \brief Does a small amount of work that
+     *         cannot be optimized away.
+     */
+    std::uint64_t leaf_work( std::uint64_t seed )
+    {
+        std::uint64_t x = seed;
+        for( int i = 0; i != 64; ++i )
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        return x;
+    }
+    
+    /** \brief Processes a range of leaves by splitting it
+     *         into tasks until it is small enough.
+     */
+    void fork_join( kernel::scheduler &s, std::size_t begin, std::size_t end,
+                   std::atomic<std::uint64_t> &checksum, std::atomic<std::size_t> &pending )
+    {
+        while( end - begin > leaves_per_task )
+        {
+            std::size_t middle = begin + (end - begin) / 2;
+            pending.fetch_add( 1, std::memory_order_relaxed );
+            s.spawn( [&s, middle, end, &checksum, &pending] {
+                fork_join( s, middle, end, checksum, pending );
+                pending.fetch_sub( 1, std::memory_order_release );
+            } );
+            end = middle;
+        }
+        
+        std::uint64_t sum = 0;
+        for( std::size_t leaf = begin; leaf != end; ++leaf )
+            sum += leaf_work( leaf );
+        checksum.fetch_add( sum, std::memory_order_relaxed );
+    }
+    
+    result spawn_run( std::size_t count )
+    {
+        kernel::scheduler s( std::pmr::new_delete_resource(), 1, tasks_per_processor );
+        latency_recorder latencies( count );
+        std::uint64_t sum = 0;
+        
+        target::hosted_cpu = 0;
+        auto begin = benchmark_clock::now();
+        for( std::size_t i = 0; i != count; ++i )
+            latencies.measure( [&] {
+                s.spawn( [&sum, i] { sum += i; } );
+                s.run_one();
+            } );
+        auto end = benchmark_clock::now();
+        
+        if( sum != count * (count - 1) / 2 )
+            std::fprintf( stderr, "spawn-run lost tasks\n" );
+        
+        return summarize( "scheduler/spawn-run", latencies, nanoseconds( begin, end ), 0 );
+    }
+    
+    result parallel_fork_join( unsigned num_threads, std::size_t leaves, std::size_t runs )
+    {
+        kernel::scheduler s( std::pmr::new_delete_resource(), num_threads, tasks_per_processor );
+        latency_recorder latencies( runs );
+        std::uint64_t expected = 0;
+        for( std::size_t leaf = 0; leaf != leaves; ++leaf )
+            expected += leaf_work( leaf );
+        
+        auto begin = benchmark_clock::now();
+        std::vector<std::thread> threads;
+        for( unsigned t = 1; t != num_threads; ++t )
+            threads.emplace_back( [&s, t] {
+                target::hosted_cpu = t;
+                s.run( [] { UTOPIAOS_CPU_RELAX(); } );
+            } );
+        
+        target::hosted_cpu = 0;
+        for( std::size_t run = 0; run != runs; ++run )
+        {
+            std::atomic<std::uint64_t> checksum( 0 );
+            std::atomic<std::size_t> pending( 0 );
+            latencies.measure( [&] {
+                fork_join( s, 0, leaves, checksum, pending );
+                while( pending.load( std::memory_order_acquire ) != 0 )
+                    if( s.run_one() == false )
+                        UTOPIAOS_CPU_RELAX();
+            } );
+            
+            if( checksum.load( std::memory_order_relaxed ) != expected )
+                std::fprintf( stderr, "fork-join lost tasks\n" );
+        }
+        
+        s.stop();
+        for( std::thread &thread : threads )
+            thread.join();
+        auto end = benchmark_clock::now();
+        
+        return summarize( "scheduler/fork-join-" + std::to_string( num_threads ),
+                         latencies, nanoseconds( begin, end ), 0 );
+    }
+}
+
+int main( int argc, char **argv )
+{
+    bool quick = (argc > 1 && std::strcmp( argv[1], "--quick" ) == 0);
+    
+    std::size_t count = (quick ? 100000 : 1000000);
+    std::size_t runs = (quick ? 20 : 200);
+    
+    print_header();
+    print( spawn_run( count ) );
+    for( unsigned num_threads : { 1u, 2u, 4u, 8u } )
+        print( parallel_fork_join( num_threads, std::size_t( 1 ) << 16, runs ) );
+    
+    return 0;
+}
+
+/** \} */
@@ -0,0 +1,203 @@
+/** \ingroup benchmarks
+ * \{
+ *
+ * \file benchmarks/synthetic_memory_map.hpp
+ * \brief This file contains the \a synthetic_memory_map
+ *        class, that fabricates UEFI memory maps backed
+ *        by host memory.
+ */
+
+#ifndef H_benchmarks_synthetic_memory_map
+#define H_benchmarks_synthetic_memory_map
+
+#include "harness.hpp"
+
+#include "target/target.hpp"
+#include "UEFI/memory.hpp"
+#include "target/memory.hpp"
+#include "kernel/constants.hpp"
+#include "kernel/memory_map.hpp"
+#include "kernel/memory_manager.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <random>
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/mman.h>
+
+namespace UtopiaOS
+{
+    namespace benchmarks
+    {
+        /** \class synthetic_memory_map
+         * \brief A UEFI memory map with a given number of
+         *        descriptors that describe real host memory.
+         *
+         * The first descriptor is a large conventional region
+         * that holds the bookkeeping of the memory manager.
+         * It is followed by regions of mixed types, which are
+         * small by default, about half of which are conventional
+         * memory. The memory is
+         * mapped lazily, so that only the pages the memory
+         * manager touches count towards the resident set.
+         */
+        class synthetic_memory_map
+        {
+        public:
+            /** \brief The number of pages of the first descriptor */
+            static constexpr std::size_t bookkeeping_pages = 1 << 14;
+        private:
+            std::vector<UEFI::memory_descriptor_v1> descriptors;
+            UEFI::memory_map map;
+            void *mapping;
+            std::size_t mapping_size;
+            std::uintptr_t first;
+            
+            static std::size_t align_up( std::size_t value, std::size_t alignment )
+            { return ((value + alignment - 1) / alignment) * alignment; }
+        public:
+            /** \brief Constructs a \a synthetic_memory_map object
+             * \param[in] num_descriptors The number of descriptors
+             * \param[in] sorted Whether the descriptors are sorted
+             *            by address, as most firmware does.
+             * \param[in] seed The seed of the random layout
+             * \param[in] max_region_pages The maximum number of
+             *            pages of the regions after the first one
+             *
+             * \throws std::bad_alloc if the memory cannot be mapped.
+             */
+            synthetic_memory_map( std::size_t num_descriptors, bool sorted,
+                                 unsigned seed = 1, std::size_t max_region_pages = 16 )
+            {
+                using UEFI::memory_type;
+                static constexpr memory_type other_types[] = {
+                    memory_type::EfiBootServicesCode, memory_type::EfiBootServicesData,
+                    memory_type::EfiLoaderData, memory_type::EfiRuntimeServicesData,
+                    memory_type::EfiACPIReclaimMemory, memory_type::EfiReservedMemoryType
+                };
+                
+                std::mt19937 random( seed );
+                std::uniform_int_distribution<std::size_t> pages( 2, std::max( max_region_pages,
+                                                                              std::size_t( 2 ) ) );
+                std::uniform_int_distribution<std::size_t> type( 0, 2 * std::size( other_types ) - 1 );
+                
+                descriptors.resize( std::max( num_descriptors, std::size_t( 1 ) ) );
+                descriptors[0] = { memory_type::EfiConventionalMemory, 0, 0, bookkeeping_pages, 0 };
+                
+                std::size_t total_pages = bookkeeping_pages;
+                for( std::size_t i = 1; i != descriptors.size(); ++i )
+                {
+                    std::size_t t = type( random );
+                    descriptors[i] = { (t < std::size( other_types ) ? other_types[t] :
+                                        memory_type::EfiConventionalMemory),
+                                       total_pages * kernel::pagesize, 0, pages( random ), 0 };
+                    total_pages += descriptors[i].number_of_pages;
+                }
+                
+                // The memory manager maps large pages, so the
+                // memory is aligned to them.
+                mapping_size = total_pages * kernel::pagesize + kernel::large_pagesize;
+                mapping = mmap( nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+                if( mapping == MAP_FAILED )
+                    throw std::bad_alloc();
+                
+                first = align_up( target::ptr_to_uintptr( mapping ), kernel::large_pagesize );
+                for( UEFI::memory_descriptor_v1 &descriptor : descriptors )
+                {
+                    descriptor.physical_start += first;
+                    descriptor.virtual_start = descriptor.physical_start;
+                }
+                
+                if( sorted == false )
+                    std::shuffle( descriptors.begin(), descriptors.end(), random );
+                
+                map = { descriptors.data(), descriptors.size(),
+                        sizeof(UEFI::memory_descriptor_v1), 1, 1 };
+            }
+            
+            synthetic_memory_map( const synthetic_memory_map & ) = delete;
+            
+            ~synthetic_memory_map( void )
+            { munmap( mapping, mapping_size ); }
+            
+            /** \brief Returns the UEFI memory map. */
+            const UEFI::memory_map &uefi( void ) const
+            { return map; }
+            
+            /** \brief Returns the first page of the bookkeeping
+             *         region, which serves as the memory occupied
+             *         by the kernel.
+             */
+            target::memory_region kernel_region( void ) const
+            { return { first, kernel::pagesize }; }
+        };
+        
+        /** \brief Constructs a memory manager the way the
+         *         kernel does upon boot.
+         * \param[in] map The memory map
+         * \param[inout] conversion_memory The memory used to
+         *            convert an unsorted memory map
+         * \returns The memory manager
+         */
+        inline kernel::memory_manager construct_memory_manager( const synthetic_memory_map &map,
+                                                              std::vector<char> &conversion_memory )
+        {
+            using kernel_memory_map = kernel::memory_map<
+                std::pmr::polymorphic_allocator<kernel::memory_descriptor>
+            >;
+            
+            std::array<target::memory_region, 1> omd = { { map.kernel_region() } };
+            
+            if( kernel::memory_map_view::is_usable( map.uefi() ) )
+                return kernel::memory_manager( kernel::memory_map_view( map.uefi() ),
+                                              omd.begin(), omd.end() );
+            
+            auto requirement = kernel_memory_map::maximum_conversion_requirement( map.uefi() );
+            conversion_memory.resize( requirement.size + requirement.alignment );
+            std::pmr::monotonic_buffer_resource resource( conversion_memory.data(),
+                                                         conversion_memory.size() );
+            
+            auto memmap = kernel::profile_boot_phase( "memory map conversion", [&] {
+                return kernel_memory_map( map.uefi(), &resource );
+            } );
+            return kernel::memory_manager( memmap, omd.begin(), omd.end() );
+        }
+        
+        /** \brief Sets up the memory whose setup a memory
+         *         manager deferred upon construction, the way
+         *         the processors of the kernel do.
+         * \param[inout] manager The memory manager
+         */
+        inline void initialize_all_memory( kernel::memory_manager &manager )
+        {
+            std::size_t cleared;
+            do
+                cleared = manager.initialize_deferred_memory( 64 );
+            while( cleared != 0 );
+        }
+        
+        /** \brief Returns a probe of the pages the allocators
+         *         of a memory manager take from its available
+         *         memory from now on.
+         * \param[in] manager The memory manager
+         */
+        inline peak_probe footprint_probe( kernel::memory_manager &manager )
+        {
+            std::size_t free_before = manager.free_pages();
+            return peak_probe( [&manager, free_before] ( void ) {
+                std::size_t free_now = manager.free_pages();
+                return (free_now < free_before ? (free_before - free_now) * kernel::pagesize : 0);
+            } );
+        }
+    }
+}
+
+#endif
+
+/** \} */
@@ -8,4 +8,8 @@
 
 #define UTOPIAOS_HOSTED @UTOPIAOS_HOSTED_ASNUMBER@
 
+#define UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS @UTOPIAOS_ALLOCATOR_STATISTICS_ASNUMBER@
+
+#define UTOPIAOS_LARGE_PAGE_RESERVATION @UTOPIAOS_LARGE_PAGE_RESERVATION@
+
 #endif
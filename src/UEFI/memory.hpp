@@ -218,7 +218,7 @@ namespace UtopiaOS
                 target::memory_region object_region = { target::ptr_to_uintptr( this ),
                     sizeof( memory_map ) };
                 target::memory_region descriptor_region = { target::ptr_to_uintptr( descriptors ),
-                    sizeof( number_of_descriptors * descriptor_size ) };
+                    number_of_descriptors * descriptor_size };
                 
                 return std::array<target::memory_region, 2>{ {object_region, descriptor_region } };
             }
@@ -232,9 +232,9 @@ namespace UtopiaOS
         
         /** \name v1 memory map traversal functions
          * \{ */
-        const_memmap_iterator_v1 cbegin_v1( const memory_map &memmap )
+        inline const_memmap_iterator_v1 cbegin_v1( const memory_map &memmap )
         { return const_memmap_iterator_v1( memmap.descriptors, memmap.descriptor_size ); }
-        const_memmap_iterator_v1 cend_v1( const memory_map &memmap )
+        inline const_memmap_iterator_v1 cend_v1( const memory_map &memmap )
         { return (const_memmap_iterator_v1( memmap.descriptors, memmap.descriptor_size )
                   += memmap.number_of_descriptors); }
         /* \} */
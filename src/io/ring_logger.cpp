@@ -0,0 +1,162 @@
+/** \ingroup io
+ * \{
+ *
+ * \file io/ring_logger.cpp
+ * \brief This file implements the \a ring_logger class,
+ *        that records log lines in per-processor ring
+ *        buffers and emits them later.
+ */
+
+#include "ring_logger.hpp"
+
+#include <stdexcept>
+#include <cstdarg>
+#include <cstring>
+#include <new>
+
+using namespace UtopiaOS;
+using namespace io;
+
+using detail::log_record;
+using detail::log_ring;
+
+ring_logger::ring_logger( void *storage, std::size_t records_per_cpu,
+                         overflow_policy overflow )
+: capacity( records_per_cpu ), policy( overflow ), num_dropped( 0 )
+{
+    if( capacity == 0 || (capacity & (capacity - 1)) != 0 )
+        throw std::invalid_argument( "The number of records has to be \
+a power of two." );
+
+    auto records = reinterpret_cast<log_record *>( storage );
+    for( log_ring &ring : rings )
+    {
+        ring.head.store( 0, std::memory_order_relaxed );
+        ring.tail.store( 0, std::memory_order_relaxed );
+        ring.records = records;
+        
+        for( std::size_t i = 0; i != capacity; ++i )
+        {
+            log_record *record = new (records++) log_record;
+            record->sequence.store( 0, std::memory_order_relaxed );
+            record->length.store( 0, std::memory_order_relaxed );
+        }
+    }
+}
+
+bool ring_logger::reserve( log_ring &ring, std::uint64_t &position ) noexcept
+{
+    if( policy == overflow_policy::drop_oldest )
+    {
+        position = ring.head.fetch_add( 1, std::memory_order_relaxed );
+        return true;
+    }
+    
+    position = ring.head.load( std::memory_order_relaxed );
+    do
+    {
+        if( position - ring.tail.load( std::memory_order_acquire ) >= capacity )
+        {
+            num_dropped.fetch_add( 1, std::memory_order_relaxed );
+            return false;
+        }
+    } while( ring.head.compare_exchange_weak( position, position + 1,
+                                             std::memory_order_relaxed ) == false );
+    
+    return true;
+}
+
+void ring_logger::log( unsigned number_of_strings, ... )
+{
+    char line[max_line_length];
+    std::size_t length = 0;
+    
+    va_list args;
+    va_start( args, number_of_strings );
+    for( ; number_of_strings != 0; --number_of_strings )
+    {
+        const_stringref string = va_arg( args, const_stringref );
+        while( *string != '\0' && length != max_line_length )
+            line[length++] = *string++;
+    }
+    va_end( args );
+    
+    log_ring &ring = rings[UTOPIAOS_CURRENT_CPU() % rings.size()];
+    std::uint64_t position;
+    if( reserve( ring, position ) == false )
+        return;
+    
+    log_record &record = ring.records[position & (capacity - 1)];
+    record.sequence.store( 2 * position + 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    
+    std::size_t num_words = (length + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+    std::memset( line + length, 0, num_words * sizeof(std::uint64_t) - length );
+    for( std::size_t i = 0; i != num_words; ++i )
+    {
+        std::uint64_t word;
+        std::memcpy( &word, line + i * sizeof(std::uint64_t), sizeof(word) );
+        record.text[i].store( word, std::memory_order_relaxed );
+    }
+    
+    record.length.store( static_cast<std::uint32_t>( length ), std::memory_order_relaxed );
+    record.sequence.store( 2 * position + 2, std::memory_order_release );
+}
+
+std::size_t ring_logger::drain( logger *sink )
+{
+    std::size_t emitted = 0;
+    
+    for( log_ring &ring : rings )
+    {
+        std::uint64_t position = ring.tail.load( std::memory_order_relaxed );
+        std::uint64_t head = ring.head.load( std::memory_order_acquire );
+        
+        // Records that were overwritten already are lost.
+        if( head - position > capacity )
+        {
+            num_dropped.fetch_add( head - position - capacity, std::memory_order_relaxed );
+            position = head - capacity;
+        }
+        
+        for( ; position != head; ++position )
+        {
+            const log_record &record = ring.records[position & (capacity - 1)];
+            std::uint64_t sequence = record.sequence.load( std::memory_order_acquire );
+            
+            // The record is still being written.
+            if( sequence < 2 * position + 2 )
+                break;
+            
+            char line[max_line_length + 1];
+            std::size_t length = record.length.load( std::memory_order_relaxed );
+            for( std::size_t i = 0; i != detail::log_record_words; ++i )
+            {
+                std::uint64_t word = record.text[i].load( std::memory_order_relaxed );
+                std::memcpy( line + i * sizeof(std::uint64_t), &word, sizeof(word) );
+            }
+            
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if( sequence != 2 * position + 2 ||
+               record.sequence.load( std::memory_order_relaxed ) != sequence ||
+               length > max_line_length )
+            {
+                num_dropped.fetch_add( 1, std::memory_order_relaxed );
+                continue;
+            }
+            
+            // The record is copied, so the slot can be reused.
+            ring.tail.store( position + 1, std::memory_order_release );
+            
+            line[length] = '\0';
+            io::log( sink, line );
+            emitted++;
+        }
+        
+        ring.tail.store( position, std::memory_order_release );
+    }
+    
+    return emitted;
+}
+
+/** \} */
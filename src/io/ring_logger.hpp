@@ -0,0 +1,168 @@
+/** \ingroup io
+ * \{
+ *
+ * \file io/ring_logger.hpp
+ * \brief This file declares the \a ring_logger class,
+ *        that records log lines in per-processor ring
+ *        buffers and emits them later.
+ */
+
+#ifndef H_io_ring_logger
+#define H_io_ring_logger
+
+#include "logger.hpp"
+
+#include "target/target.hpp"
+#include "target/memory.hpp"
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace UtopiaOS
+{
+    namespace io
+    {
+        namespace detail
+        {
+            /** \brief The number of words of text of a log record */
+            static constexpr std::size_t log_record_words = 14;
+            
+            /** \struct log_record
+             * \brief A slot of a ring buffer holding one log line.
+             *
+             * The slot is protected by a sequence lock. The
+             * sequence of the record written at position \a n is
+             * odd, namely 2n + 1, while it is being written and
+             * 2n + 2 once it is complete.
+             */
+            struct log_record
+            {
+                std::atomic<std::uint64_t> sequence;
+                std::atomic<std::uint32_t> length;
+                std::array<std::atomic<std::uint64_t>, log_record_words> text;
+            };
+            
+            /** \struct log_ring
+             * \brief The ring buffer of one processor.
+             */
+            struct log_ring
+            {
+                /** \brief The position of the next record to write */
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) std::atomic<std::uint64_t> head;
+                /** \brief The position of the next record to emit */
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) std::atomic<std::uint64_t> tail;
+                log_record *records;
+            };
+        }
+        
+        /** \enum overflow_policy
+         * \brief Specifies what a \a ring_logger does
+         *        if a ring buffer is full.
+         */
+        enum class overflow_policy
+        {
+            drop_oldest, /**< Overwrite the oldest record */
+            count_drops  /**< Discard the new record */
+        };
+        
+        /** \class ring_logger
+         * \brief A thread-safe logger that defers
+         *        the output of the log lines.
+         *
+         * Every processor appends its log lines to its own
+         * ring buffer without locking, so that logging never
+         * blocks and can be used from interrupt handlers and
+         * allocators. The strings of a call to \a log are
+         * concatenated into a single record, which is truncated
+         * to \a max_line_length characters. The records are only
+         * passed on to another logger by \a drain, which a
+         * consumer should call periodically.
+         *
+         * Records are emitted in the order they were logged on
+         * every processor, but not in a global order.
+         */
+        class ring_logger : public logger
+        {
+        public:
+            /** \brief The maximum length of a log line */
+            static constexpr std::size_t max_line_length =
+                detail::log_record_words * sizeof(std::uint64_t);
+        private:
+            std::array<detail::log_ring, UTOPIAOS_KERNEL_MAX_CPUS> rings;
+            std::size_t capacity;
+            overflow_policy policy;
+            
+            /** \brief The number of records that were lost */
+            std::atomic<std::uint64_t> num_dropped;
+            
+            /** \brief Reserves the position of a new record.
+             * \param[in] ring The ring buffer
+             * \param[out] position The reserved position
+             * \returns \a false if the record has to be discarded.
+             */
+            bool reserve( detail::log_ring &ring, std::uint64_t &position ) noexcept;
+        public:
+            /** \brief Returns a memory_request that when fulfilled
+             *         will suffice to construct a \a ring_logger.
+             * \param[in] records_per_cpu The number of records
+             *            of every ring buffer
+             * \returns The memory_request
+             */
+            static target::memory_request<alignof(detail::log_record)>
+            requirement( std::size_t records_per_cpu )
+            {
+                return { UTOPIAOS_KERNEL_MAX_CPUS * records_per_cpu *
+                    sizeof(detail::log_record) };
+            }
+            
+            /** \brief Constructs a \a ring_logger object
+             * \param[in] storage The memory for the ring buffers,
+             *            which has to fulfil what is returned by
+             *            \a requirement and outlive the object.
+             * \param[in] records_per_cpu The number of records
+             *            of every ring buffer
+             * \param[in] overflow The overflow policy
+             *
+             * \throws std::invalid_argument if \a records_per_cpu
+             *         is not a power of two.
+             */
+            ring_logger( void *storage, std::size_t records_per_cpu,
+                        overflow_policy overflow );
+            
+            /** \brief A ring_logger is not copyable. */
+            ring_logger( const ring_logger & ) = delete;
+            
+            /** \brief A ring_logger is not movable. */
+            ring_logger( ring_logger && ) = delete;
+            
+            /** \brief Records several ordered const_stringrefs.
+             *
+             * The strings are copied, so they need not outlive
+             * the call.
+             */
+            virtual void log( unsigned number_of_strings, ... ) override;
+            
+            /** \brief Passes the recorded log lines on.
+             * \param[in] sink The logger to pass the log lines to
+             * \returns The number of log lines passed on.
+             *
+             * \note Only one thread may call this function
+             *       at a time.
+             */
+            std::size_t drain( logger *sink );
+            
+            /** \brief Returns the number of lost records.
+             * \returns The number of records that were discarded
+             *          or overwritten before they were drained.
+             */
+            std::uint64_t dropped( void ) const
+            { return num_dropped.load( std::memory_order_relaxed ); }
+        };
+    }
+}
+
+#endif
+
+/** \} */
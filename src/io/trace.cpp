@@ -0,0 +1,230 @@
+/** \ingroup io
+ * \{
+ *
+ * \file io/trace.cpp
+ * \brief This file implements the recording and
+ *        decoding of binary trace records.
+ */
+
+#include "trace.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#if UTOPIAOS_HOSTED
+#include <unordered_map>
+#include <string>
+#include <cstdio>
+#include <cinttypes>
+#endif
+
+using namespace UtopiaOS;
+using namespace io;
+
+using detail::trace_header;
+using detail::trace_record;
+
+trace_buffer::trace_buffer( void *storage, std::size_t size )
+{
+    if( size < sizeof(trace_header) )
+        throw std::invalid_argument( "The trace buffer is too small." );
+
+    header = new (storage) trace_header;
+    header->magic = detail::trace_buffer_magic;
+    header->version = detail::trace_buffer_version;
+    header->capacity = (size - sizeof(trace_header)) & ~(sizeof(std::uint64_t) - 1);
+    header->head.store( 0, std::memory_order_relaxed );
+    header->dropped.store( 0, std::memory_order_relaxed );
+
+    records = reinterpret_cast<unsigned char *>( header + 1 );
+}
+
+trace_record *trace_buffer::reserve( std::size_t size ) noexcept
+{
+    std::uint64_t position = header->head.load( std::memory_order_relaxed );
+    do
+    {
+        if( header->capacity - position < size )
+        {
+            header->dropped.fetch_add( 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+    } while( header->head.compare_exchange_weak( position, position + size,
+                                                std::memory_order_relaxed ) == false );
+
+    return new (records + position) trace_record{ { 0 }, 0, 0 };
+}
+
+void trace_buffer::write( std::uint32_t id, const std::uint64_t *args,
+                         std::size_t num_args ) noexcept
+{
+    trace_record *record = reserve( sizeof(trace_record) + num_args * sizeof(std::uint64_t) );
+    if( record == nullptr )
+        return;
+
+    record->num_args = static_cast<std::uint16_t>( num_args );
+    record->cpu = static_cast<std::uint16_t>( UTOPIAOS_CURRENT_CPU() );
+    std::memcpy( static_cast<void *>( record + 1 ), args, num_args * sizeof(std::uint64_t) );
+    record->id.store( id, std::memory_order_release );
+}
+
+#if UTOPIAOS_HOSTED
+namespace
+{
+    /** \struct decoded_format
+     * \brief A format entry found in a binary.
+     */
+    struct decoded_format
+    {
+        std::string types;
+        std::string text;
+    };
+
+    /** \brief Finds the format entries in a binary.
+     * \param[in] image The memory of the binary
+     * \param[in] size The size of \a image
+     * \returns The formats by their IDs
+     *
+     * A candidate is only accepted if its ID matches its
+     * contents, which rules out accidental occurrences
+     * of the magic number.
+     */
+    std::unordered_map<std::uint32_t, decoded_format>
+    find_formats( const unsigned char *image, std::size_t size )
+    {
+        constexpr std::size_t fixed = sizeof(detail::trace_format_magic) +
+            sizeof(std::uint32_t) + 2 * sizeof(std::uint16_t);
+
+        std::unordered_map<std::uint32_t, decoded_format> formats;
+        for( std::size_t offset = 0; offset + fixed <= size; ++offset )
+        {
+            const unsigned char *entry = image + offset;
+            if( std::memcmp( entry, detail::trace_format_magic,
+                            sizeof(detail::trace_format_magic) ) != 0 )
+                continue;
+
+            std::uint32_t id;
+            std::uint16_t num_args, length;
+            std::memcpy( &id, entry + 8, sizeof(id) );
+            std::memcpy( &num_args, entry + 12, sizeof(num_args) );
+            std::memcpy( &length, entry + 14, sizeof(length) );
+
+            std::size_t data_size = std::size_t( num_args ) + length + 1;
+            if( size - offset - fixed < data_size )
+                continue;
+
+            auto data = reinterpret_cast<const char *>( entry + fixed );
+            std::uint32_t hash = detail::fnv1a( data, data_size );
+            if( (hash == 0 ? 1 : hash) != id || data[data_size - 1] != '\0' )
+                continue;
+
+            formats[id] = { std::string( data, num_args ),
+                            std::string( data + num_args, length ) };
+        }
+
+        return formats;
+    }
+
+    /** \brief Appends an argument to a line.
+     * \param[in,out] line The line
+     * \param[in] type The type code of the argument
+     * \param[in] value The argument
+     */
+    void append_argument( std::string &line, char type, std::uint64_t value )
+    {
+        char buffer[24];
+        switch( type )
+        {
+            case 'b':
+                line += (value != 0 ? "true" : "false");
+                return;
+            case 'p':
+                std::snprintf( buffer, sizeof(buffer), "0x%" PRIx64, value );
+                break;
+            case 'i':
+                std::snprintf( buffer, sizeof(buffer), "%" PRId64,
+                              static_cast<std::int64_t>( value ) );
+                break;
+            default:
+                std::snprintf( buffer, sizeof(buffer), "%" PRIu64, value );
+                break;
+        }
+        line += buffer;
+    }
+}
+
+std::size_t io::decode_trace( const void *trace,
+                             const void *image, std::size_t image_size,
+                             logger *sink )
+{
+    auto header = reinterpret_cast<const trace_header *>( trace );
+    if( header->magic != detail::trace_buffer_magic ||
+       header->version != detail::trace_buffer_version )
+        throw std::invalid_argument( "The memory does not contain a trace buffer." );
+
+    auto formats = find_formats( reinterpret_cast<const unsigned char *>( image ),
+                                image_size );
+
+    auto records = reinterpret_cast<const unsigned char *>( header + 1 );
+    std::uint64_t end = std::min<std::uint64_t>( header->head.load( std::memory_order_acquire ),
+                                                 header->capacity );
+
+    std::size_t decoded = 0;
+    for( std::uint64_t position = 0; end - position >= sizeof(trace_record); )
+    {
+        auto record = reinterpret_cast<const trace_record *>( records + position );
+        std::uint32_t id = record->id.load( std::memory_order_acquire );
+
+        // The record is incomplete, so the
+        // following ones cannot be located.
+        if( id == 0 )
+            break;
+
+        auto args = reinterpret_cast<const std::uint64_t *>( record + 1 );
+        std::size_t num_args = record->num_args;
+        position += sizeof(trace_record) + num_args * sizeof(std::uint64_t);
+        if( position > end )
+            break;
+
+        std::string line = "[" + std::to_string( record->cpu ) + "] ";
+        auto format = formats.find( id );
+        if( format == formats.end() || format->second.types.size() != num_args )
+        {
+            char buffer[48];
+            std::snprintf( buffer, sizeof(buffer), "<unknown trace format 0x%08" PRIx32 ">", id );
+            line += buffer;
+            for( std::size_t i = 0; i != num_args; ++i )
+            {
+                line += ' ';
+                append_argument( line, 'u', args[i] );
+            }
+        }
+        else
+        {
+            const decoded_format &f = format->second;
+            std::size_t next = 0;
+            for( std::size_t i = 0; i != f.text.size(); ++i )
+            {
+                if( f.text[i] == '{' && i + 1 != f.text.size() &&
+                   f.text[i + 1] == '}' && next != num_args )
+                {
+                    append_argument( line, f.types[next], args[next] );
+                    ++next;
+                    ++i;
+                }
+                else
+                    line += f.text[i];
+            }
+        }
+
+        io::log( sink, line.c_str() );
+        decoded++;
+    }
+
+    return decoded;
+}
+#endif
+
+/** \} */
@@ -0,0 +1,294 @@
+/** \ingroup io
+ * \{
+ *
+ * \file io/trace.hpp
+ * \brief This file contains a binary tracing system
+ *        whose format strings are interned at compile
+ *        time.
+ */
+
+#ifndef H_io_trace
+#define H_io_trace
+
+#include "logger.hpp"
+
+#include "target/target.hpp"
+
+#include <type_traits>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include <boost/hana.hpp>
+
+namespace UtopiaOS
+{
+    namespace io
+    {
+        namespace detail
+        {
+            /** \brief The magic number every trace format entry starts with */
+            static constexpr char trace_format_magic[8] = { 'U', 'T', 'r', 'a', 'c', 'e', 'F', '1' };
+            
+            /** \brief The magic number of a trace buffer */
+            static constexpr std::uint32_t trace_buffer_magic = 0x42725455; // "UTrB"
+            
+            /** \brief The version of the trace buffer layout */
+            static constexpr std::uint32_t trace_buffer_version = 1;
+            
+            /** \brief Computes the 32-bit FNV-1a hash of some bytes.
+             * \param[in] bytes The bytes to hash
+             * \param[in] size The number of bytes
+             * \param[in] hash The hash of preceding bytes
+             * \returns The hash of \a bytes
+             */
+            constexpr std::uint32_t fnv1a( const char *bytes, std::size_t size,
+                                          std::uint32_t hash = 2166136261u )
+            {
+                for( std::size_t i = 0; i != size; ++i )
+                    hash = (hash ^ static_cast<unsigned char>( bytes[i] )) * 16777619u;
+                
+                return hash;
+            }
+            
+            /** \brief Returns the code under which an argument
+             *         of a trace record is stored.
+             * \tparam T The type of the argument
+             * \returns 'b' for booleans, 'p' for pointers, 'i' for
+             *          signed and 'u' for unsigned integers.
+             */
+            template<class T>
+            constexpr char trace_type_code( void )
+            {
+                static_assert( std::is_integral<T>::value || std::is_enum<T>::value ||
+                              std::is_pointer<T>::value,
+                              "Only integers, enumerations and pointers can be traced." );
+                
+                if constexpr( std::is_same<T, bool>::value )
+                    return 'b';
+                else if constexpr( std::is_pointer<T>::value )
+                    return 'p';
+                else if constexpr( std::is_enum<T>::value )
+                    return trace_type_code<std::underlying_type_t<T>>();
+                else
+                    return (std::is_signed<T>::value ? 'i' : 'u');
+            }
+            
+            /** \brief Converts an argument of a trace record
+             *         to the word it is stored as.
+             */
+            template<class T>
+            std::uint64_t trace_word( T value )
+            {
+                if constexpr( std::is_pointer<T>::value )
+                    return reinterpret_cast<std::uintptr_t>( value );
+                else if constexpr( std::is_enum<T>::value )
+                    return trace_word( static_cast<std::underlying_type_t<T>>( value ) );
+                else if constexpr( std::is_signed<T>::value )
+                    return static_cast<std::uint64_t>( static_cast<std::int64_t>( value ) );
+                else
+                    return static_cast<std::uint64_t>( value );
+            }
+            
+            /** \struct trace_format_entry
+             * \brief Describes the format of the trace records
+             *        with one ID.
+             *
+             * The entries are emitted into the binary, where a
+             * decoder finds them by their magic number. \a data
+             * holds the type codes of the arguments followed by
+             * the null-terminated format string.
+             */
+            template<std::size_t NumArgs, std::size_t Length>
+            struct trace_format_entry
+            {
+                char magic[8];
+                std::uint32_t id;
+                std::uint16_t num_args;
+                std::uint16_t length;
+                char data[NumArgs + Length + 1];
+            };
+            
+            /** \class trace_format
+             * \brief The compile-time description of a format.
+             * \tparam String The boost::hana string type of the format
+             * \tparam Args The argument types
+             */
+            template<class String, class ...Args>
+            struct trace_format;
+            
+            template<char ...Chars, class ...Args>
+            struct trace_format<boost::hana::string<Chars...>, Args...>
+            {
+                static constexpr char data[] = { trace_type_code<Args>()..., Chars..., '\0' };
+                
+                /** \brief The ID, which is never zero */
+                static constexpr std::uint32_t id = (fnv1a( data, sizeof(data) ) == 0 ?
+                                                     1 : fnv1a( data, sizeof(data) ));
+                
+                static_assert( sizeof...(Args) <= 0xFFFF && sizeof...(Chars) <= 0xFFFF,
+                              "The format is too long." );
+                
+                using entry_type = trace_format_entry<sizeof...(Args), sizeof...(Chars)>;
+                
+                /** \brief Returns the entry of the format.
+                 * \tparam Indices The indices of the magic number
+                 */
+                template<std::size_t ...Indices>
+                static constexpr entry_type make_entry( std::index_sequence<Indices...> )
+                {
+                    return { { trace_format_magic[Indices]... }, id,
+                             std::uint16_t( sizeof...(Args) ), std::uint16_t( sizeof...(Chars) ),
+                             { trace_type_code<Args>()..., Chars..., '\0' } };
+                }
+                
+                /** \brief Emits the entry of the format.
+                 * \returns The ID of the format
+                 */
+                static std::uint32_t intern( void )
+                {
+                    UTOPIAOS_RETAIN static const entry_type entry =
+                        make_entry( std::make_index_sequence<sizeof(trace_format_magic)>() );
+                    
+                    return entry.id;
+                }
+            };
+            
+            /** \struct trace_header
+             * \brief The header of a trace buffer, that is
+             *        followed by the trace records.
+             *
+             * The records are stored one after another, each of
+             * them a \a trace_record followed by its arguments as
+             * 64-bit words.
+             */
+            struct trace_header
+            {
+                std::uint32_t magic;
+                std::uint32_t version;
+                std::uint64_t capacity; /**< The number of bytes of records */
+                std::atomic<std::uint64_t> head; /**< The number of bytes written */
+                std::atomic<std::uint64_t> dropped; /**< The number of lost records */
+            };
+            
+            /** \struct trace_record
+             * \brief The fixed part of a trace record.
+             *
+             * The ID is written last, so a record whose ID
+             * is zero is incomplete.
+             */
+            struct trace_record
+            {
+                std::atomic<std::uint32_t> id;
+                std::uint16_t num_args;
+                std::uint16_t cpu;
+            };
+            
+            static_assert( sizeof(trace_record) == sizeof(std::uint64_t),
+                          "The arguments of a record have to stay aligned." );
+        }
+        
+        /** \class trace_buffer
+         * \brief A buffer of binary trace records, that can
+         *        be mapped and decoded by another program.
+         *
+         * Every record only consists of the ID of its format and
+         * its arguments, so recording costs about as much as
+         * storing the arguments. Records are appended without
+         * locking until the buffer is full, from then on they are
+         * counted as dropped.
+         *
+         * \note The buffer is laid out in host byte order and
+         *       does not contain any pointers.
+         */
+        class trace_buffer
+        {
+        private:
+            detail::trace_header *header;
+            unsigned char *records;
+            
+            /** \brief Reserves the space for a record.
+             * \param[in] size The size of the record
+             * \returns The record or \a nullptr if the
+             *          buffer is full.
+             */
+            detail::trace_record *reserve( std::size_t size ) noexcept;
+        public:
+            /** \brief Constructs a \a trace_buffer object
+             * \param[in] storage The memory for the buffer, which
+             *            has to be aligned to 8 bytes and outlive
+             *            the object.
+             * \param[in] size The size of the memory
+             *
+             * \throws std::invalid_argument if \a size is smaller
+             *         than the header of the buffer.
+             */
+            trace_buffer( void *storage, std::size_t size );
+            
+            /** \brief Appends a record.
+             * \param[in] id The ID of the format
+             * \param[in] args The arguments
+             * \param[in] num_args The number of arguments
+             */
+            void write( std::uint32_t id, const std::uint64_t *args,
+                       std::size_t num_args ) noexcept;
+            
+            /** \brief Returns the number of lost records.
+             * \returns The number of records that did not
+             *          fit into the buffer.
+             */
+            std::uint64_t dropped( void ) const
+            { return header->dropped.load( std::memory_order_relaxed ); }
+        };
+        
+        /** \brief Records a trace event.
+         * \tparam Chars The characters of the format
+         * \tparam Args The argument types
+         * \param[in] buffer The trace buffer
+         * \param[in] format The format, usually created by
+         *            BOOST_HANA_STRING, in which every "{}"
+         *            is replaced by the next argument.
+         * \param[in] args The arguments, which have to be
+         *            integers, enumerations or pointers.
+         *
+         * The format is interned at compile time, so only its ID
+         * and the arguments are recorded. A nullptr valued buffer
+         * is silently ignored.
+         */
+        template<char ...Chars, class ...Args>
+        void trace( trace_buffer *buffer, boost::hana::string<Chars...>, Args ...args ) noexcept
+        {
+            using format = detail::trace_format<boost::hana::string<Chars...>, Args...>;
+            
+            if( buffer != nullptr )
+            {
+                const std::uint64_t words[sizeof...(Args) + 1] = { detail::trace_word( args )..., 0 };
+                buffer->write( format::intern(), words, sizeof...(Args) );
+            }
+        }
+
+#if UTOPIAOS_HOSTED
+        /** \brief Rebuilds the text of trace records.
+         * \param[in] trace The trace buffer as written by
+         *            a \a trace_buffer object
+         * \param[in] image The memory of a binary that recorded
+         *            the trace, e.g. a copy of its file, which
+         *            contains the format entries.
+         * \param[in] image_size The size of \a image
+         * \param[in] sink The logger that receives one
+         *            line per record
+         * \returns The number of records that were decoded.
+         * \throws std::invalid_argument if \a trace is
+         *         not a trace buffer.
+         */
+        std::size_t decode_trace( const void *trace,
+                                 const void *image, std::size_t image_size,
+                                 logger *sink );
+#endif
+    }
+}
+
+#endif
+
+/** \} */
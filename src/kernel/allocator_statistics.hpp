@@ -0,0 +1,260 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/allocator_statistics.hpp
+ * \brief This file contains the counters of the
+ *        memory resources and the snapshots they
+ *        are reported in.
+ */
+
+#ifndef H_kernel_allocator_statistics
+#define H_kernel_allocator_statistics
+
+#include "target/config.hpp"
+#include "target/memory.hpp"
+
+#include <atomic>
+#include <limits>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        /** \class statistic_counter
+         * \brief A counter that can be read while
+         *        it is being updated.
+         *
+         * The updates of a counter have to be serialized, e.g.
+         * by the lock of the resource it belongs to, so that
+         * they do not need atomic read-modify-write operations.
+         * Reading is possible at any time.
+         */
+        class statistic_counter
+        {
+        private:
+            std::atomic<std::size_t> value;
+        public:
+            statistic_counter( void ) : value( 0 ) {}
+            
+            statistic_counter( const statistic_counter &other )
+            : value( other.load() ) {}
+            
+            statistic_counter &operator=( const statistic_counter &other )
+            {
+                value.store( other.load(), std::memory_order_relaxed );
+                return *this;
+            }
+            
+            /** \brief Adds to the counter.
+             * \param[in] n The number to add
+             */
+            void add( std::size_t n = 1 ) noexcept
+            { value.store( value.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed ); }
+            
+            /** \brief Returns the value of the counter. */
+            std::size_t load( void ) const noexcept
+            { return value.load( std::memory_order_relaxed ); }
+        };
+        
+        namespace detail
+        {
+            /** \class statistics_storage
+             * \brief Holds the counters of a memory resource
+             *        if allocator statistics are enabled.
+             * \tparam Counters The type of the counters
+             * \tparam Enabled Whether the counters are kept
+             *
+             * Memory resources derive from this class, so that it
+             * takes no space and all counting compiles to nothing
+             * if allocator statistics are disabled.
+             */
+            template<class Counters, bool Enabled = (UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS != 0)>
+            class statistics_storage
+            {
+            private:
+                Counters counters;
+            protected:
+                /** \brief Updates the counters.
+                 * \tparam Function The function object type
+                 * \param[in] f A function that is called with
+                 *            a reference to the counters.
+                 */
+                template<class Function>
+                void record( Function f ) noexcept
+                { f( counters ); }
+                
+                /** \brief Returns the counters or \a nullptr
+                 *         if they are not kept.
+                 */
+                const Counters *recorded( void ) const noexcept
+                { return &counters; }
+            };
+            
+            template<class Counters>
+            class statistics_storage<Counters, false>
+            {
+            protected:
+                template<class Function>
+                void record( Function ) noexcept
+                {}
+                
+                const Counters *recorded( void ) const noexcept
+                { return nullptr; }
+            };
+        }
+        
+        /** \struct block_size_statistics
+         * \brief The figures of the blocks of one size
+         *        of a \a buddy_resource.
+         */
+        struct block_size_statistics
+        {
+            std::size_t allocations; /**< Blocks handed out */
+            std::size_t deallocations; /**< Blocks given back */
+            std::size_t splits; /**< Blocks split into two */
+            std::size_t merges; /**< Pairs of buddies combined into a block */
+            std::size_t free_blocks; /**< Blocks currently on the free list */
+        };
+        
+        /** \struct buddy_statistics
+         * \brief A snapshot of one or several \a buddy_resource
+         *        objects.
+         *
+         * The number of free blocks is derived from the free lists
+         * and is always available. All other figures are counted
+         * and remain zero unless UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS
+         * is set.
+         */
+        struct buddy_statistics
+        {
+            /** \brief The figures by block size, where entry \a n
+             *         describes the blocks of size \a 2^n.
+             */
+            std::array<block_size_statistics, std::numeric_limits<std::size_t>::digits> sizes;
+            
+            /** \brief The number of top-level blocks obtained
+             *         from the upstream resources.
+             */
+            std::size_t upstream_allocations;
+            /** \brief The number of top-level blocks returned
+             *         to the upstream resources.
+             */
+            std::size_t upstream_deallocations;
+            
+            std::size_t bytes_held; /**< Bytes obtained from the upstream resources */
+            std::size_t free_bytes; /**< Bytes in free blocks */
+            std::size_t largest_free_block; /**< The size of the largest free block */
+            
+            /** \brief Returns the number of bytes in blocks
+             *         that are handed out.
+             */
+            std::size_t bytes_in_use( void ) const
+            { return (bytes_held > free_bytes ? bytes_held - free_bytes : 0); }
+            
+            /** \brief Returns the external fragmentation.
+             * \returns The share of the free bytes in parts per
+             *          thousand that lies outside of the largest
+             *          free block, i.e. \a 0 if all free memory is
+             *          in a single block.
+             */
+            std::size_t fragmentation( void ) const
+            {
+                if( free_bytes == 0 )
+                    return 0;
+                
+                std::size_t share = (free_bytes < 1000 ?
+                                     largest_free_block * 1000 / free_bytes :
+                                     largest_free_block / (free_bytes / 1000));
+                return (share >= 1000 ? 0 : 1000 - share);
+            }
+            
+            /** \brief Adds the figures of another snapshot.
+             *
+             * The largest free block of the sum is the larger
+             * one of both.
+             */
+            buddy_statistics &operator+=( const buddy_statistics &other )
+            {
+                for( std::size_t n = 0; n != sizes.size(); ++n )
+                {
+                    sizes[n].allocations += other.sizes[n].allocations;
+                    sizes[n].deallocations += other.sizes[n].deallocations;
+                    sizes[n].splits += other.sizes[n].splits;
+                    sizes[n].merges += other.sizes[n].merges;
+                    sizes[n].free_blocks += other.sizes[n].free_blocks;
+                }
+                
+                upstream_allocations += other.upstream_allocations;
+                upstream_deallocations += other.upstream_deallocations;
+                bytes_held += other.bytes_held;
+                free_bytes += other.free_bytes;
+                largest_free_block = (largest_free_block > other.largest_free_block ?
+                                      largest_free_block : other.largest_free_block);
+                return *this;
+            }
+        };
+        
+        /** \struct cache_statistics
+         * \brief A snapshot of one or several
+         *        \a cached_buddy_resource objects.
+         *
+         * All figures remain zero unless
+         * UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS is set.
+         */
+        struct cache_statistics
+        {
+            std::size_t hits; /**< Allocations served from a magazine */
+            std::size_t misses; /**< Allocations that had to refill a magazine */
+            std::size_t bypasses; /**< Allocations forwarded to the backend */
+            std::size_t refilled_blocks; /**< Blocks moved into the magazines */
+            std::size_t drained_blocks; /**< Blocks returned to the backend */
+            
+            /** \brief Adds the figures of another snapshot. */
+            cache_statistics &operator+=( const cache_statistics &other )
+            {
+                hits += other.hits;
+                misses += other.misses;
+                bypasses += other.bypasses;
+                refilled_blocks += other.refilled_blocks;
+                drained_blocks += other.drained_blocks;
+                return *this;
+            }
+        };
+        
+        /** \struct upstream_statistics
+         * \brief A snapshot of one upstream resource of
+         *        a \a distributed_resource.
+         *
+         * The counts remain zero unless
+         * UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS is set.
+         */
+        struct upstream_statistics
+        {
+            target::memory_region region; /**< The region of the upstream resource */
+            std::size_t attempts; /**< Requests forwarded to the upstream resource */
+            std::size_t hits; /**< Requests it satisfied */
+        };
+        
+        /** \struct memory_statistics
+         * \brief A snapshot of the general purpose memory
+         *        resources of the memory manager.
+         */
+        struct memory_statistics
+        {
+            buddy_statistics shards; /**< The sum over the buddies of all shards */
+            cache_statistics caches; /**< The sum over the caches of all shards */
+            
+            /** \brief The sum over the upstream resources of
+             *         the page resources of all nodes.
+             */
+            std::size_t page_attempts, page_hits;
+        };
+    }
+}
+
+#endif
+
+/** \} */
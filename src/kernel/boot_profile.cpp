@@ -0,0 +1,137 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/boot_profile.cpp
+ * \brief This file contains the definitions for
+ *        the boot profile.
+ */
+
+#include "boot_profile.hpp"
+
+#include "target/target.hpp"
+
+#include <array>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+namespace
+{
+    /** \brief The recorded phases */
+    std::array<boot_phase_record, max_boot_phases> phases;
+    
+    /** \brief The number of recorded phases */
+    std::size_t recorded_phases = 0;
+    
+    /** \brief The number of phases that did not fit */
+    std::size_t dropped_phases = 0;
+    
+    /** \brief The number of running phases */
+    std::uint32_t current_depth = 0;
+    
+    /** \brief The length of a line of the profile */
+    static constexpr std::size_t max_line_length = 96;
+    
+    /** \brief Writes a number in decimal notation.
+     * \param[in] value The number
+     * \param[out] out The buffer, which has to hold
+     *             at least 20 characters
+     * \returns The end of the written characters
+     */
+    char *write_decimal( std::uint64_t value, char *out )
+    {
+        char digits[20];
+        std::size_t count = 0;
+        do
+        {
+            digits[count++] = static_cast<char>( '0' + value % 10 );
+            value /= 10;
+        } while( value != 0 );
+        
+        while( count != 0 )
+            *out++ = digits[--count];
+        return out;
+    }
+}
+
+boot_phase::boot_phase( const char *name ) noexcept
+: record( nullptr )
+{
+    if( recorded_phases == phases.size() )
+        ++dropped_phases;
+    else
+    {
+        record = &phases[recorded_phases++];
+        record->name = name;
+        record->end = 0;
+        record->depth = current_depth;
+    }
+    
+    ++current_depth;
+    if( record != nullptr )
+        record->begin = UTOPIAOS_TIMESTAMP();
+}
+
+boot_phase::~boot_phase( void )
+{
+    unsigned int aux;
+    std::uint64_t end = UTOPIAOS_TIMESTAMP_ORDERED( aux );
+    
+    --current_depth;
+    if( record != nullptr )
+        record->end = end;
+}
+
+const boot_phase_record *kernel::boot_profile( std::size_t &number_of_phases ) noexcept
+{
+    number_of_phases = recorded_phases;
+    return phases.data();
+}
+
+std::size_t kernel::dropped_boot_phases( void ) noexcept
+{
+    return dropped_phases;
+}
+
+void kernel::reset_boot_profile( void ) noexcept
+{
+    recorded_phases = 0;
+    dropped_phases = 0;
+}
+
+void kernel::log_boot_profile( io::logger *sink )
+{
+    for( std::size_t i = 0; i != recorded_phases; ++i )
+    {
+        const boot_phase_record &record = phases[i];
+        
+        // Leave room for the separator and the cycles
+        char line[max_line_length];
+        char *out = line;
+        const char *end = line + max_line_length - 23;
+        for( std::uint32_t depth = 0; depth != record.depth && out + 2 <= end; ++depth )
+        {
+            *out++ = ' ';
+            *out++ = ' ';
+        }
+        for( const char *c = record.name; *c != '\0' && out != end; ++c )
+            *out++ = *c;
+        *out++ = ':';
+        *out++ = ' ';
+        if( record.end != 0 )
+            *write_decimal( record.end - record.begin, out ) = '\0';
+        else
+            *out = '\0';
+        
+        io::log( sink, "boot: ", line, (record.end != 0 ? " cycles" : "still running") );
+    }
+    
+    if( dropped_phases != 0 )
+    {
+        char count[21];
+        *write_decimal( dropped_phases, count ) = '\0';
+        io::log( sink, "boot: ", count, " phases dropped" );
+    }
+}
+
+/** \} */
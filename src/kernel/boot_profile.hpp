@@ -0,0 +1,115 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/boot_profile.hpp
+ * \brief This file contains a lightweight profiler
+ *        that times the phases of the boot.
+ */
+
+#ifndef H_kernel_boot_profile
+#define H_kernel_boot_profile
+
+#include "io/logger.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        /** \brief The number of phases the boot profile holds */
+        static constexpr std::size_t max_boot_phases = 64;
+        
+        /** \struct boot_phase_record
+         * \brief The timing of one phase of the boot.
+         *
+         * The timestamps are values of \a UTOPIAOS_TIMESTAMP(),
+         * i.e. processor cycles at a constant rate.
+         */
+        struct boot_phase_record
+        {
+            const char *name; /**< A string with static storage duration */
+            std::uint64_t begin;
+            std::uint64_t end; /**< \a 0 as long as the phase has not ended */
+            std::uint32_t depth; /**< The number of enclosing phases */
+        };
+        
+        /** \class boot_phase
+         * \brief Times a phase of the boot from its
+         *        construction to its destruction.
+         *
+         * The phase is appended to a static buffer of
+         * \a max_boot_phases records, so that profiling works
+         * before there is any memory management. Phases that do
+         * not fit anymore are counted as dropped. Phases that
+         * are started while another one is running are nested
+         * into it.
+         *
+         * \note The boot is assumed to run on a single processor,
+         *       the profile is not synchronized.
+         */
+        class boot_phase
+        {
+        private:
+            boot_phase_record *record;
+        public:
+            /** \brief Starts a phase.
+             * \param[in] name The name of the phase, which
+             *            has to outlive the profile.
+             */
+            explicit boot_phase( const char *name ) noexcept;
+            
+            /** \brief Ends the phase */
+            ~boot_phase( void );
+            
+            boot_phase( const boot_phase & ) = delete;
+            boot_phase &operator=( const boot_phase & ) = delete;
+        };
+        
+        /** \brief Times a function as a phase of the boot.
+         * \tparam Function The function object type
+         * \param[in] name The name of the phase
+         * \param[in] f The function to run
+         * \returns What \a f returns.
+         *
+         * This is meant for member initializers, which
+         * cannot hold a \a boot_phase object themselves.
+         */
+        template<class Function>
+        auto profile_boot_phase( const char *name, Function f ) -> decltype( f() )
+        {
+            boot_phase phase( name );
+            return f();
+        }
+        
+        /** \brief Returns the recorded phases in the order
+         *         they were started.
+         * \param[out] number_of_phases The number of records
+         */
+        const boot_phase_record *boot_profile( std::size_t &number_of_phases ) noexcept;
+        
+        /** \brief Returns the number of phases that did not
+         *         fit into the profile.
+         */
+        std::size_t dropped_boot_phases( void ) noexcept;
+        
+        /** \brief Discards all recorded phases.
+         *
+         * \note No phase may be running.
+         */
+        void reset_boot_profile( void ) noexcept;
+        
+        /** \brief Writes one line per recorded phase into a log.
+         * \param[in] sink The logger, may be \a nullptr
+         *
+         * Every line holds the number of cycles the phase
+         * took and its name, indented by its depth.
+         */
+        void log_boot_profile( io::logger *sink );
+    }
+}
+
+#endif
+
+/** \} */
@@ -22,28 +22,39 @@
 #include <limits>
 #include <algorithm>
 #include <exception>
+#include <stdexcept>
+#include <cstring>
 
 using namespace UtopiaOS;
 using namespace kernel;
 
-using detail::max_align;
 using detail::memory_block_info;
 using detail::block_size_at_level;
 using detail::padding;
+using detail::buddy_counters;
 
-std::size_t buddy_resource::level_for_allocation_request( std::size_t bytes, std::size_t ) const
+std::size_t buddy_resource::level_for_allocation_request( std::size_t bytes,
+                                                         std::size_t alignment ) const
 {
-    auto required_size = bytes + padding + sizeof(memory_block_info);
-    auto msb = utils::msb( required_size );
-    std::size_t level = msb - min_msb;
+    // Blocks are aligned to the smaller of their size and
+    // the top-level block alignment. Since the data offset is
+    // a multiple of the alignment, every block that is large
+    // enough is also suitably aligned.
+    if( alignment > top_level_block_alignment )
+        return num_block_levels;
     
-    if( ((required_size - 1) & required_size) != 0 )
-        level++;
+    auto offset = memory_block_info::data_offset( alignment );
+    if( bytes > std::numeric_limits<std::size_t>::max() - offset )
+        return num_block_levels;
     
-    return level;
+    auto required_size = bytes + offset;
+    if( required_size <= min_block_size )
+        return 0;
+    
+    return (utils::msb( required_size - 1 ) + 1 - min_msb);
 }
 
-void *buddy_resource::do_allocate( std::size_t bytes, std::size_t alignment )
+void *buddy_resource::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
 {
     if( bytes == 0 )
         return nullptr;
@@ -51,79 +62,47 @@ void *buddy_resource::do_allocate( std::size_t bytes, std::size_t alignment )
     auto level = level_for_allocation_request( bytes, alignment );
     
     if( level > max_block_level )
-        throw std::bad_alloc();
+        return nullptr;
     
     auto block_info = allocate_block( level );
-    return block_info->data();
-}
-
-memory_block_info *
-buddy_resource::allocate_block( std::size_t block_level )
-{
-    utils::debug_assert( block_level <= max_block_level,
-                        "Block level is larger than maximum block level." );
-    
-    memory_block_info *current = free_block_lists[block_level];
-    if( current != nullptr )
-    {
-        free_block_lists[block_level] = current->next;
-        free_block_lists[block_level]->previous = nullptr;
-        
-        current->set_occupied();
-        return current;
-    }
-    
-    if( block_level != max_block_level )
-    {
-        auto buddies = split_block( allocate_block( block_level + 1 ),
-                                   block_level + 1 );
-        free_block_lists[block_level] = buddies.first;
-        buddies.first->previous = buddies.first->next = nullptr;
-        buddies.first->set_free();
-        
-        return buddies.second;
-    }
-    
-    void *memory = upstream->allocate( detail::block_size_at_level( max_block_level, min_msb ),
-                                      top_level_block_alignment );
-    
-    if( (target::ptr_to_uintptr( memory ) % top_level_block_alignment) != 0 )
-    {
-        upstream->deallocate( memory,
-                             block_size_at_level( max_block_level, min_msb ),
-                             top_level_block_alignment );
-        throw std::bad_alloc();
-    }
-    
-    memory_block_info *info = reinterpret_cast<memory_block_info *>( memory );
-    info->set_occupied();
+    if( block_info == nullptr )
+        return nullptr;
     
-    return info;
+    record( [level] ( buddy_counters &c ) { c.levels[level].allocations.add(); } );
+    return block_info->data( alignment );
 }
 
-std::pair<
-    memory_block_info *,
-    memory_block_info *
->
-buddy_resource::split_block( memory_block_info *block, std::size_t block_level )
+void buddy_resource::split_block_completely( memory_block_info *block,
+                                            std::size_t block_level,
+                                            std::size_t child_level,
+                                            std::size_t alignment, void **out )
 {
-    utils::debug_assert( block_level != 0,
-                        "Cannot split 0-level block." );
-    utils::debug_assert( block_level <= max_block_level,
-                        "Block level is larger than maximum block level." );
+    utils::debug_assert( child_level <= block_level,
+                        "Cannot split into blocks of a higher level." );
     
-    std::size_t block_size = (1U << (block_level + min_msb - 1));
+    std::size_t num_children = (std::size_t(1U) << (block_level - child_level));
+    std::size_t child_size = block_size_at_level( child_level, min_msb );
     std::uintptr_t info_address = target::ptr_to_uintptr( block );
     
-    memory_block_info *first = block;
-    memory_block_info *second = reinterpret_cast<memory_block_info *>(
-                target::uintptr_to_ptr<void>( info_address + (block_size >> 1) ) );
+    // Child i is the first half at level child_level + k
+    // if and only if bit k of i is clear.
+    std::size_t level_mask = (((std::size_t(1U) << (block_level - child_level)) - 1) <<
+                              child_level);
+    std::size_t inherited_flags = (block->block_flags & ~level_mask);
     
-    *second = *first;
-    first->set_first( block_level - 1 );
-    second->set_second( block_level - 1 );
+    for( std::size_t i = 0; i != num_children; ++i )
+    {
+        memory_block_info *child = target::uintptr_to_ptr<memory_block_info>(
+                                                        info_address + i * child_size );
+        child->block_flags = (inherited_flags | ((~i << child_level) & level_mask));
+        out[i] = child->data( alignment );
+    }
     
-    return std::make_pair( first, second );
+    record( [=] ( buddy_counters &c ) {
+        for( std::size_t level = child_level + 1; level <= block_level; ++level )
+            c.levels[level].splits.add( std::size_t(1U) << (block_level - level) );
+        c.levels[child_level].allocations.add( num_children );
+    } );
 }
 
 void buddy_resource::do_deallocate( void* p, std::size_t bytes, std::size_t alignment )
@@ -131,67 +110,26 @@ void buddy_resource::do_deallocate( void* p, std::size_t bytes, std::size_t alig
     if( bytes == 0 )
         return;
     
-    std::uintptr_t info_address = (target::ptr_to_uintptr( p ) -
-                                   (padding + sizeof(memory_block_info)));
-    deallocate_block( target::uintptr_to_ptr<memory_block_info>( info_address ),
+    deallocate_block( block_for_data( p, alignment ),
                      level_for_allocation_request( bytes, alignment ) );
 }
 
-void buddy_resource::deallocate_block( memory_block_info *block, std::size_t block_level )
+memory_block_info *buddy_resource::block_for_data( void *p, std::size_t alignment )
 {
-    utils::debug_assert( block_level <= max_block_level,
-                        "Block level is larger than maximum block level." );
-    
-    do
-    {
-        memory_block_info *buddy = block->buddy( block_level, min_msb );
-        
-        if( block_level == max_block_level || buddy->is_free() == false )
-        {
-            block->next = free_block_lists[block_level];
-            block->previous = nullptr;
-            free_block_lists[block_level] = block;
-            
-            if( block->next != nullptr )
-                block->next->previous = block;
-            
-            block->set_free();
-            return;
-        }
-        
-        if( buddy->previous == nullptr )
-        {
-            free_block_lists[block_level] = buddy->next;
-            if( free_block_lists[block_level] != nullptr )
-                free_block_lists[block_level]->previous = nullptr;
-        } else
-        {
-            buddy->previous->next = buddy->next;
-            if( buddy->next != nullptr )
-                buddy->next->previous = buddy->previous;
-        }
-        
-        buddy->set_occupied();
-        block = combine_buddies( block, buddy, block_level++ );
-    } while( true );
+    std::uintptr_t info_address = (target::ptr_to_uintptr( p ) -
+                                   memory_block_info::data_offset( alignment ));
+    return target::uintptr_to_ptr<memory_block_info>( info_address );
 }
 
-memory_block_info *
-buddy_resource::combine_buddies( memory_block_info *first,
-                                memory_block_info *second,
-                                std::size_t block_level )
+void buddy_resource::deallocate_block( memory_block_info *block, std::size_t block_level )
 {
-    utils::debug_assert( block_level < max_block_level,
-                        "The block level must be smaller than \
-                        the maximum block level." );
+    core::deallocate_block( block, block_level );
     
-    if( first->is_second( block_level ) )
-        return second;
-    
-    return first;
+    if( num_free_top_level_blocks > trim_high_watermark )
+        trim();
 }
 
-bool buddy_resource::do_is_equal( const std::pmr::memory_resource& other ) const
+bool buddy_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
 {
     return (std::addressof( other ) == this);
 }
@@ -200,20 +138,18 @@ buddy_resource::buddy_resource( std::size_t min_bs,
                                std::size_t max_bs,
                                std::size_t tlp_alignment,
                                std::pmr::memory_resource *upstream_resource )
-: min_block_size( min_bs ), max_block_size( max_bs ),
-top_level_block_alignment( std::max( tlp_alignment, max_align ) ),
-upstream( upstream_resource )
+: core( detail::buddy_geometry( min_bs, max_bs, tlp_alignment ), upstream_resource )
 {
     if( min_block_size > max_block_size )
         throw std::invalid_argument( "The minimum block size has to be less than \
 or equal to the maximum block size." );
-    if( ((min_block_size - 1) & min_block_size) != 0 )
+    if( utils::popcount( min_block_size ) != 1 )
         throw std::invalid_argument( "The minimum block size has to be a \
 power of two." );
-    if( ((max_block_size - 1) & max_block_size) != 0 )
+    if( utils::popcount( max_block_size ) != 1 )
         throw std::invalid_argument( "The maximum block size has to be a \
 power of two." );
-    
+
     if( min_block_size <= sizeof(memory_block_info) + padding )
         throw std::invalid_argument( "The minimum block size has to be larger \
 than the per-block bookkeeping information." );
@@ -249,19 +185,188 @@ buddy_resource::~buddy_resource( void )
     std::memcpy( old_free_block_lists, free_block_lists, block_lists_size );
     std::swap( free_block_lists, old_free_block_lists );
     
-    deallocate( free_block_lists, block_lists_size, alignof(memory_block_info *) );
+    deallocate( old_free_block_lists, block_lists_size, alignof(memory_block_info *) );
+    
+    // Every block that is not in use has been merged upon
+    // deallocation already, so only top-level blocks remain.
+    trim( 0 );
+}
+
+void buddy_resource::set_trim_watermarks( std::size_t low, std::size_t high )
+{
+    if( low > high )
+        throw std::invalid_argument( "The low watermark must not exceed \
+the high watermark." );
+
+    trim_low_watermark = low;
+    trim_high_watermark = high;
+    
+    if( num_free_top_level_blocks > trim_high_watermark )
+        trim();
+}
+
+bool buddy_resource::try_expand( void *p, std::size_t old_bytes,
+                                std::size_t new_bytes, std::size_t alignment )
+{
+    if( old_bytes == 0 )
+        return false;
+    
+    auto level = level_for_allocation_request( old_bytes, alignment );
+    auto new_level = level_for_allocation_request( new_bytes, alignment );
+    
+    // Shrinking is left to shrink_in_place, which returns
+    // the unused halves to the free lists.
+    if( new_level < level )
+        return false;
+    if( new_level == level )
+        return true;
+    if( new_level > max_block_level )
+        return false;
+    
+    memory_block_info *block = block_for_data( p, alignment );
+    
+    // Check all buddies first, so that nothing has to be
+    // undone if one of them is in use.
+    for( std::size_t current_level = level; current_level != new_level; ++current_level )
+    {
+        if( block->is_second( current_level ) )
+            return false;
+        if( block->buddy( current_level, min_msb )->is_free_at( current_level ) == false )
+            return false;
+    }
+    
+    // Since the block is the first half at every level,
+    // absorbing the buddies leaves its address unchanged.
+    for( std::size_t current_level = level; current_level != new_level; ++current_level )
+        remove_free_block( block->buddy( current_level, min_msb ), current_level );
+    
+    record( [=] ( buddy_counters &c ) {
+        for( std::size_t current_level = level; current_level != new_level; ++current_level )
+            c.levels[current_level + 1].merges.add();
+        c.levels[level].deallocations.add();
+        c.levels[new_level].allocations.add();
+    } );
+    
+    return true;
+}
+
+void buddy_resource::shrink_in_place( void *p, std::size_t old_bytes,
+                                     std::size_t new_bytes, std::size_t alignment )
+{
+    utils::debug_assert( new_bytes != 0 && new_bytes <= old_bytes,
+                        "Cannot shrink to the requested size." );
+    
+    auto level = level_for_allocation_request( old_bytes, alignment );
+    auto new_level = level_for_allocation_request( new_bytes, alignment );
+    
+    memory_block_info *block = block_for_data( p, alignment );
+    
+    if( level != new_level )
+        record( [=] ( buddy_counters &c ) {
+            c.levels[level].deallocations.add();
+            c.levels[new_level].allocations.add();
+        } );
+    
+    // The buddies of the second halves stay occupied,
+    // so there is nothing to merge.
+    while( level != new_level )
+    {
+        auto buddies = split_block( block, level-- );
+        push_free_block( buddies.second, level );
+    }
+}
+
+void *buddy_resource::reallocate( void *p, std::size_t old_bytes,
+                                 std::size_t new_bytes, std::size_t alignment )
+{
+    if( old_bytes == 0 )
+        return allocate( new_bytes, alignment );
+    
+    if( new_bytes == 0 )
+    {
+        deallocate( p, old_bytes, alignment );
+        return nullptr;
+    }
+    
+    if( new_bytes <= old_bytes )
+    {
+        shrink_in_place( p, old_bytes, new_bytes, alignment );
+        return p;
+    }
+    
+    if( try_expand( p, old_bytes, new_bytes, alignment ) )
+        return p;
+    
+    void *new_p = allocate( new_bytes, alignment );
+    std::memcpy( new_p, p, old_bytes );
+    deallocate( p, old_bytes, alignment );
+    
+    return new_p;
+}
+
+std::size_t buddy_resource::try_allocate_bulk( std::size_t count, std::size_t bytes,
+                                              std::size_t alignment, void **out ) noexcept
+{
+    if( bytes == 0 )
+    {
+        std::fill( out, out + count, nullptr );
+        return count;
+    }
+    
+    auto level = level_for_allocation_request( bytes, alignment );
+    
+    if( level > max_block_level )
+        return 0;
+    
+    std::size_t done = 0;
+    
+    while( done != count )
+    {
+        std::size_t carve_level = std::min( level + utils::msb( count - done ) - 1,
+                                           max_block_level );
+        
+        memory_block_info *block = allocate_block( carve_level );
+        if( block == nullptr )
+        {
+            // Smaller free blocks may still hold some
+            // of the allocations.
+            std::size_t smaller = ((non_empty_levels &
+                                    ((std::size_t(1U) << carve_level) - 1)) >> level) << level;
+            if( smaller == 0 )
+                break;
+            
+            carve_level = utils::msb( smaller ) - 1;
+            block = allocate_block( carve_level );
+        }
+            
+        split_block_completely( block, carve_level, level, alignment, out + done );
+        done += (std::size_t(1U) << (carve_level - level));
+    }
     
-    for( std::size_t level = 0; level != max_block_level; level++ )
+    return done;
+}
+
+void buddy_resource::allocate_bulk( std::size_t count, std::size_t bytes,
+                                   std::size_t alignment, void **out )
+{
+    std::size_t done = try_allocate_bulk( count, bytes, alignment, out );
+    if( done != count )
     {
-        for( auto current = free_block_lists[level]; current != nullptr;
-            current = free_block_lists[level] )
-            deallocate_block( current, level );
+        deallocate_bulk( done, bytes, alignment, out );
+        throw std::bad_alloc();
     }
+}
+
+void buddy_resource::deallocate_bulk( std::size_t count, std::size_t bytes,
+                                     std::size_t alignment, void * const *ptrs )
+{
+    if( bytes == 0 )
+        return;
+    
+    auto level = level_for_allocation_request( bytes, alignment );
     
-    for( auto current = free_block_lists[max_block_level]; current != nullptr;
-        current = current->next )
-        upstream->deallocate( current, 1U << (max_block_level + min_msb - 1),
-                             alignof(memory_block_info) );
+    for( std::size_t i = 0; i != count; ++i )
+        deallocate_block( block_for_data( ptrs[i], alignment ), level );
 }
 
 /** \} */
@@ -10,10 +10,17 @@
 #ifndef H_kernel_buddy_resource
 #define H_kernel_buddy_resource
 
+#include "fallible_resource.hpp"
+#include "allocator_statistics.hpp"
+
 #include "utils/bitwise.hpp"
+#include "utils/debug.hpp"
 #include "target/memory.hpp"
 
 #include <memory_resource>
+#include <utility>
+#include <limits>
+#include <array>
 
 namespace UtopiaOS
 {
@@ -32,6 +39,7 @@ namespace UtopiaOS
             struct memory_block_info
             {
                 std::size_t block_flags;
+                std::size_t free_level;
                 memory_block_info *previous, *next;
                 
             private:
@@ -39,8 +47,11 @@ namespace UtopiaOS
                                     std::numeric_limits<std::size_t>::max() );
                 
             public:
-                void set_free( void )
-                { block_flags |= (std::size_t(1U) << (msb - 1)); }
+                void set_free( std::size_t level )
+                {
+                    block_flags |= (std::size_t(1U) << (msb - 1));
+                    free_level = level;
+                }
                 void set_occupied( void )
                 { block_flags &= ~(std::size_t(1U) << (msb - 1)); }
                 
@@ -50,6 +61,20 @@ namespace UtopiaOS
                 bool is_occupied( void ) const
                 { return !is_free(); }
                 
+                /** \brief Checks whether the block is a free
+                 *         block of exactly the given level.
+                 * \param[in] level The level
+                 * \returns \a true if the block is free and
+                 *          of level \a level.
+                 *
+                 * The first half of a split block starts at the
+                 * same address as the block itself, so a free
+                 * block at a given address need not be of the
+                 * level in question.
+                 */
+                bool is_free_at( std::size_t level ) const
+                { return (is_free() && free_level == level); }
+                
                 void set_first( std::size_t level )
                 { block_flags |= (std::size_t(1U) << level); }
                 
@@ -69,17 +94,33 @@ namespace UtopiaOS
                     
                     if( is_first( level ) )
                         return target::uintptr_to_ptr<memory_block_info>(
-                                                    info_address + (block_size >> 1) );
+                                                    info_address + block_size );
                     
                     return target::uintptr_to_ptr<memory_block_info>(
-                                                 info_address - (block_size >> 1) );
+                                                 info_address - block_size );
                 }
                 
-                void *data() const
+                /** \brief Returns the offset of the data from the
+                 *         start of a block for a given alignment.
+                 * \param[in] alignment The alignment of the data,
+                 *            which has to be a power of two.
+                 * \returns The smallest multiple of \a alignment
+                 *          (or of \a max_align if that is larger)
+                 *          that leaves room for the block info.
+                 */
+                static constexpr std::size_t data_offset( std::size_t alignment )
+                {
+                    std::size_t data_alignment = (alignment > max_align ?
+                                                  alignment : max_align);
+                    return (((sizeof(memory_block_info) + data_alignment - 1) /
+                             data_alignment) * data_alignment);
+                }
+                
+                void *data( std::size_t alignment = max_align ) const
                 {
                     std::uintptr_t info_address = target::ptr_to_uintptr( this );
                     return target::uintptr_to_ptr<void>(
-                        target::align<max_align>( info_address + sizeof(memory_block_info) ) );
+                                    info_address + data_offset( alignment ) );
                 }
             };
             
@@ -87,82 +128,463 @@ namespace UtopiaOS
                 (sizeof(memory_block_info) % max_align);
             static constexpr std::size_t padding =
                 ((max_align - inverse_padding) % max_align);
+            
+            /** \struct buddy_level_counters
+             * \brief The counters of one block level.
+             */
+            struct buddy_level_counters
+            {
+                statistic_counter allocations, deallocations, splits, merges;
+            };
+            
+            /** \struct buddy_counters
+             * \brief The counters of a \a buddy_resource.
+             */
+            struct buddy_counters
+            {
+                std::array<buddy_level_counters,
+                    utils::msb( std::numeric_limits<std::size_t>::max() ) - 1> levels;
+                statistic_counter upstream_allocations, upstream_deallocations;
+            };
+            
+            /** \struct buddy_geometry
+             * \brief The block sizes of a \a buddy_resource,
+             *        which are set at run time.
+             */
+            struct buddy_geometry
+            {
+                std::size_t min_block_size;
+                std::size_t max_block_size;
+                
+                std::size_t max_msb = utils::msb( max_block_size );
+                std::size_t min_msb = utils::msb( min_block_size );
+                std::size_t max_block_level = max_msb - min_msb;
+                std::size_t num_block_levels = max_block_level + 1;
+                
+                std::size_t top_level_block_alignment;
+                
+                buddy_geometry( std::size_t min_bs, std::size_t max_bs,
+                               std::size_t tlp_alignment )
+                : min_block_size( min_bs ), max_block_size( max_bs ),
+                top_level_block_alignment( tlp_alignment > max_align ?
+                                          tlp_alignment : max_align )
+                {}
+            };
+            
+            /** \class buddy_core
+             * \brief The free lists of the buddy method together
+             *        with splitting and merging their blocks.
+             * \tparam Geometry The type that supplies the members
+             *         \a min_block_size, \a max_block_size,
+             *         \a min_msb, \a max_block_level,
+             *         \a num_block_levels and
+             *         \a top_level_block_alignment, either as
+             *         fields or as constants.
+             * \tparam FreeLists The storage of the free lists,
+             *         which is indexed by the block level.
+             *
+             * \a buddy_resource and \a static_buddy_resource only
+             * differ in their geometry and in the storage of their
+             * free lists, so they share this implementation. With
+             * constant geometry all block sizes fold to constants.
+             */
+            template<class Geometry, class FreeLists>
+            class buddy_core : protected Geometry,
+                               protected statistics_storage<buddy_counters>
+            {
+            protected:
+                std::pmr::memory_resource *upstream;
+                
+                FreeLists free_block_lists;
+                
+                /** \brief Bit \a n is set if and only if
+                 *         \a free_block_lists[n] is not empty.
+                 */
+                std::size_t non_empty_levels = 0;
+                
+                /** \brief The number of blocks in
+                 *         \a free_block_lists[max_block_level].
+                 */
+                std::size_t num_free_top_level_blocks = 0;
+                
+                buddy_core( const Geometry &geometry,
+                           std::pmr::memory_resource *upstream_resource )
+                : Geometry( geometry ), upstream( upstream_resource ),
+                free_block_lists()
+                {}
+                
+                /** \brief Returns the size of the blocks of a level. */
+                std::size_t block_size( std::size_t level ) const noexcept
+                { return (this->min_block_size << level); }
+                
+                /** \brief Pushes a block onto the free list of a level
+                 *         and marks it as free.
+                 * \param[inout] block The block
+                 * \param[in] block_level The level of the block
+                 */
+                void push_free_block( memory_block_info *block,
+                                     std::size_t block_level ) noexcept
+                {
+                    block->next = free_block_lists[block_level];
+                    block->previous = nullptr;
+                    free_block_lists[block_level] = block;
+                    
+                    if( block->next != nullptr )
+                        block->next->previous = block;
+                    
+                    block->set_free( block_level );
+                    non_empty_levels |= (std::size_t(1U) << block_level);
+                    
+                    if( block_level == this->max_block_level )
+                        num_free_top_level_blocks++;
+                }
+                
+                /** \brief Removes a block from the free list of a level
+                 *         and marks it as occupied.
+                 * \param[inout] block The block
+                 * \param[in] block_level The level of the block
+                 * \note \a block has to be on the free list of
+                 *       \a block_level otherwise the behaviour is
+                 *       undefined.
+                 */
+                void remove_free_block( memory_block_info *block,
+                                       std::size_t block_level ) noexcept
+                {
+                    if( block->previous == nullptr )
+                    {
+                        free_block_lists[block_level] = block->next;
+                        if( block->next == nullptr )
+                            non_empty_levels &= ~(std::size_t(1U) << block_level);
+                    } else
+                        block->previous->next = block->next;
+                    
+                    if( block->next != nullptr )
+                        block->next->previous = block->previous;
+                    
+                    block->set_occupied();
+                    
+                    if( block_level == this->max_block_level )
+                        num_free_top_level_blocks--;
+                }
+                
+                /** \brief Obtains a top-level block from the
+                 *         upstream resource.
+                 * \returns The occupied block or \a nullptr if the
+                 *          upstream resource cannot provide a
+                 *          suitably aligned one.
+                 */
+                memory_block_info *allocate_top_level_block( void ) noexcept
+                {
+                    void *memory = kernel::try_allocate( upstream, this->max_block_size,
+                                                        this->top_level_block_alignment );
+                    if( memory == nullptr )
+                        return nullptr;
+                    
+                    if( (target::ptr_to_uintptr( memory ) % this->top_level_block_alignment) != 0 )
+                    {
+                        upstream->deallocate( memory, this->max_block_size,
+                                             this->top_level_block_alignment );
+                        return nullptr;
+                    }
+                    
+                    auto block = reinterpret_cast<memory_block_info *>( memory );
+                    block->block_flags = 0;
+                    block->set_occupied();
+                    
+                    this->record( [] ( buddy_counters &c ) { c.upstream_allocations.add(); } );
+                    return block;
+                }
+                
+                /** \brief Splits a given memory block into two buddies.
+                 * \param[inout] block The given memory block
+                 * \param[in] block_level The level of the given block
+                 * \returns Two buddies corresponding to memory blocks
+                 *          of one level less than \a block_level that
+                 *          are both occupied.
+                 * \note \a block has to be occupied otherwise the
+                 *       behaviour is undefined.
+                 * \note \a block_level has to correspond to the actual
+                 *       level of the block and be larger than zero
+                 *       otherwise the behaviour is undefined.
+                 */
+                std::pair<memory_block_info *, memory_block_info *>
+                split_block( memory_block_info *block, std::size_t block_level ) noexcept
+                {
+                    utils::debug_assert( block_level != 0,
+                                        "Cannot split 0-level block." );
+                    utils::debug_assert( block_level <= this->max_block_level,
+                                        "Block level is larger than maximum block level." );
+                    
+                    memory_block_info *first = block;
+                    memory_block_info *second = target::uintptr_to_ptr<memory_block_info>(
+                        target::ptr_to_uintptr( block ) + block_size( block_level - 1 ) );
+                    
+                    *second = *first;
+                    first->set_first( block_level - 1 );
+                    second->set_second( block_level - 1 );
+                    
+                    this->record( [block_level] ( buddy_counters &c ) {
+                        c.levels[block_level].splits.add();
+                    } );
+                    return std::make_pair( first, second );
+                }
+                
+                /** \brief Allocates a block of the specified level
+                 * \param[in] block_level The level of the block to be allocated.
+                 * \returns A memory block of the given level or \a nullptr
+                 *          if the upstream resource cannot provide a
+                 *          suitable top-level block.
+                 *
+                 * \note The returned memory block will always be occupied.
+                 */
+                memory_block_info *allocate_block( std::size_t block_level ) noexcept
+                {
+                    utils::debug_assert( block_level <= this->max_block_level,
+                                        "Block level is larger than maximum block level." );
+                    
+                    memory_block_info *block;
+                    std::size_t current_level;
+                    
+                    // Jump straight to the lowest non-empty level that can
+                    // satisfy the request.
+                    std::size_t candidates = ((non_empty_levels >> block_level) << block_level);
+                    if( candidates != 0 )
+                    {
+                        current_level = utils::ctz( candidates );
+                        block = free_block_lists[current_level];
+                        remove_free_block( block, current_level );
+                    } else
+                    {
+                        block = allocate_top_level_block();
+                        if( block == nullptr )
+                            return nullptr;
+                        
+                        current_level = this->max_block_level;
+                    }
+                    
+                    while( current_level != block_level )
+                    {
+                        auto buddies = split_block( block, current_level-- );
+                        push_free_block( buddies.first, current_level );
+                        block = buddies.second;
+                    }
+                    
+                    return block;
+                }
+                
+                /** \brief Returns a block to the free lists and merges
+                 *         it with its free buddies.
+                 * \param[inout] block The block to be deallocated.
+                 * \param[in] block_level The level of the block to be deallocated.
+                 *
+                 * \note \a block has to be occupied otherwise the
+                 *       behaviour is undefined.
+                 * \note \a block_level has to correspond to the actual
+                 *       level of the block otherwise the behaviour is
+                 *       undefined.
+                 */
+                void deallocate_block( memory_block_info *block,
+                                      std::size_t block_level ) noexcept
+                {
+                    utils::debug_assert( block_level <= this->max_block_level,
+                                        "Block level is larger than maximum block level." );
+                    
+                    this->record( [block_level] ( buddy_counters &c ) {
+                        c.levels[block_level].deallocations.add();
+                    } );
+                    
+                    while( block_level != this->max_block_level )
+                    {
+                        memory_block_info *buddy = block->buddy( block_level, this->min_msb );
+                        
+                        if( buddy->is_free_at( block_level ) == false )
+                            break;
+                        
+                        remove_free_block( buddy, block_level );
+                        if( block->is_second( block_level ) )
+                            block = buddy;
+                        
+                        ++block_level;
+                        this->record( [block_level] ( buddy_counters &c ) {
+                            c.levels[block_level].merges.add();
+                        } );
+                    }
+                    
+                    push_free_block( block, block_level );
+                }
+            public:
+                /** \brief Returns free top-level blocks to the
+                 *         upstream resource until at most
+                 *         \a low_watermark of them are left.
+                 * \param[in] low_watermark The number of free
+                 *            top-level blocks to keep.
+                 * \returns The number of bytes returned to the
+                 *          upstream resource.
+                 */
+                std::size_t trim( std::size_t low_watermark )
+                {
+                    std::size_t released = 0;
+                    
+                    while( num_free_top_level_blocks > low_watermark )
+                    {
+                        memory_block_info *block = free_block_lists[this->max_block_level];
+                        remove_free_block( block, this->max_block_level );
+                        
+                        upstream->deallocate( block, this->max_block_size,
+                                             this->top_level_block_alignment );
+                        released += this->max_block_size;
+                        
+                        this->record( [] ( buddy_counters &c ) { c.upstream_deallocations.add(); } );
+                    }
+                    
+                    return released;
+                }
+                
+                /** \brief Adds the figures of this resource
+                 *         to a snapshot.
+                 * \param[inout] sum The snapshot, so that several
+                 *               resources can be summed up.
+                 */
+                void accumulate_statistics( buddy_statistics &sum ) const
+                {
+                    const buddy_counters *counters = this->recorded();
+                    
+                    for( std::size_t level = 0; level != this->num_block_levels; ++level )
+                    {
+                        block_size_statistics &figures = sum.sizes[level + this->min_msb - 1];
+                        
+                        std::size_t free_blocks = 0;
+                        for( const memory_block_info *block = free_block_lists[level];
+                            block != nullptr; block = block->next )
+                            free_blocks++;
+                        
+                        figures.free_blocks += free_blocks;
+                        sum.free_bytes += free_blocks * block_size( level );
+                        if( free_blocks != 0 && block_size( level ) > sum.largest_free_block )
+                            sum.largest_free_block = block_size( level );
+                        
+                        if( counters != nullptr )
+                        {
+                            figures.allocations += counters->levels[level].allocations.load();
+                            figures.deallocations += counters->levels[level].deallocations.load();
+                            figures.splits += counters->levels[level].splits.load();
+                            figures.merges += counters->levels[level].merges.load();
+                        }
+                    }
+                    
+                    if( counters != nullptr )
+                    {
+                        std::size_t allocations = counters->upstream_allocations.load();
+                        std::size_t deallocations = counters->upstream_deallocations.load();
+                        
+                        sum.upstream_allocations += allocations;
+                        sum.upstream_deallocations += deallocations;
+                        sum.bytes_held += (allocations - deallocations) * this->max_block_size;
+                    }
+                }
+            };
         }
+        
+        class cached_buddy_resource;
     
         /** \class buddy_resource
          * \brief A conforming subclass of \a std::pmr::memory_resource that
          *        implements the 'buddy method'.
          */
-        class buddy_resource : public std::pmr::memory_resource
+        class buddy_resource : public fallible_resource,
+                               private detail::buddy_core<detail::buddy_geometry,
+                                                          detail::memory_block_info **>
         {
+            friend class cached_buddy_resource;
+            
+            using core = detail::buddy_core<detail::buddy_geometry,
+                                            detail::memory_block_info **>;
         public:
             static constexpr std::size_t min_allowed_block_size =
                 2 * (sizeof(detail::memory_block_info) + detail::padding);
             static constexpr std::size_t max_num_allowed_block_levels =
                 utils::msb( std::numeric_limits<std::size_t>::max() ) - 1;
         private:
-            std::size_t min_block_size;
-            std::size_t max_block_size;
-            
-            std::size_t max_msb = utils::msb( max_block_size );
-            std::size_t min_msb = utils::msb( min_block_size );
-            std::size_t max_block_level = max_msb - min_msb;
-            std::size_t num_block_levels = max_block_level + 1;
-            
-            std::size_t top_level_block_alignment;
-            
-            std::pmr::memory_resource *upstream;
-            
             std::size_t block_lists_size;
-            detail::memory_block_info **free_block_lists;
             
-            /** \brief As specified by the c++ standard
-             * \warning Alignment will always be to \a alignof(std::max_align_t).
+            /** \name Trimming policy
+             * \brief Once there are more than \a trim_high_watermark
+             *        free top-level blocks, all but
+             *        \a trim_low_watermark of them are returned
+             *        to the upstream resource.
+             * \{ */
+            std::size_t trim_low_watermark = std::numeric_limits<std::size_t>::max();
+            std::size_t trim_high_watermark = std::numeric_limits<std::size_t>::max();
+            /** \} */
+            
+            /** \brief As specified by \a fallible_resource
+             *
+             * Alignments up to \a alignof(std::max_align_t) come
+             * for free. Larger alignments are met by placing the
+             * data at the corresponding offset within a block,
+             * since blocks are naturally aligned to their size.
+             *
+             * \note Fails if \a alignment exceeds the alignment
+             *       of the top-level blocks.
              */
-            virtual void* do_allocate( std::size_t bytes, std::size_t alignment );
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
             
             /** \brief Returns the block level necessary to satisfy
              *         a given allocation request.
              * \param[in] bytes The number of bytes requested
              * \param[in] alignment The requested alignment
              * \returns The block level necessary to satisfy
-             *         a given allocation request.
-             * \warning Alignment will always be to \a alignof(std::max_align_t).
+             *         a given allocation request or a level
+             *         larger than \a max_block_level if the
+             *         request cannot be satisfied.
              */
             std::size_t level_for_allocation_request( std::size_t bytes,
                                             std::size_t alignment ) const;
             
-            /** \brief Allocates a block of the specified level
-             * \param[in] block_level The level of the block to be allocated.
-             * \returns A memory block of the given level.
-             *
-             * \note The returned memory block will always be occupied.
+            /** \brief Returns the memory block whose data
+             *         is located at a given address.
+             * \param[in] p The address of the data
+             * \param[in] alignment The alignment the data
+             *            was allocated with.
+             * \returns The memory block whose data is \a p.
+             * \note \a p has to be obtained from
+             *       \a memory_block_info::data() with the
+             *       same alignment otherwise the behaviour
+             *       is undefined.
              */
-            detail::memory_block_info *allocate_block( std::size_t block_level );
+            static detail::memory_block_info *block_for_data( void *p,
+                                        std::size_t alignment = detail::max_align );
             
-            /** \brief Splits a given memory block into two buddies.
+            /** \brief Splits a given memory block into all of its
+             *         descendants of a given level at once.
              * \param[inout] block The given memory block
              * \param[in] block_level The level of the given block
-             * \returns Two buddies corresponding to memory blocks
-             *          of one level less than \a block_level that
-             *          are both occupied.
+             * \param[in] child_level The level of the descendants,
+             *            which must not exceed \a block_level.
+             * \param[in] alignment The alignment of the data
+             * \param[out] out An array that receives the data of the
+             *             \a 2^(block_level - child_level)
+             *             occupied descendants in address order.
              * \note \a block has to be occupied otherwise the
              *       behaviour is undefined.
-             * \note \a block_level has to correspond to the actual
-             *       level of the block and be larger than zero
-             *       otherwise the behaviour is undefined.
              */
-            std::pair<detail::memory_block_info *, detail::memory_block_info *>
-            split_block( detail::memory_block_info *block, std::size_t block_level );
+            void split_block_completely( detail::memory_block_info *block,
+                                        std::size_t block_level,
+                                        std::size_t child_level,
+                                        std::size_t alignment, void **out );
             
             /** \brief As specified in the c++ standard.
-             * \note This function never returns memory to
-             *       its upstreams resource.
+             * \note This function only returns memory to
+             *       its upstream resource as specified by
+             *       the trimming policy.
              */
             virtual void do_deallocate( void* p, std::size_t bytes,
                                        std::size_t alignment );
             
             /** \brief Deallocates a block of the specified level
+             *         and trims as specified by the trimming
+             *         policy.
              * \param[inout] block The block to be deallocated.
              * \param[in] block_level The level of the block to be deallocated.
              *
@@ -175,24 +597,7 @@ namespace UtopiaOS
             void deallocate_block( detail::memory_block_info *block,
                                   std::size_t block_level );
             
-            /** \brief Combines two given buddies of a specified level
-             *         into one block of a higher level.
-             * \param[inout] first A memory block.
-             * \param[inout] second The buddy of \a first.
-             * \returns An occupied memory block corresponding to the
-             *          union of both given blocks with one level higher.
-             * \note If the blocks are not buddies the behaviour is
-             *       undefined.
-             * \note \a block_level has to correspond to the actual
-             *       level of the blocks otherwise the behaviour is
-             *       undefined.
-             */
-            detail::memory_block_info *combine_buddies(
-                detail::memory_block_info *first,
-                detail::memory_block_info *second,
-                std::size_t block_level );
-            
-            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const;
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
         public:
             /** \brief Constructs a \a buddy_resource object
              * \param[in] min_bs The minimum block size.
@@ -219,6 +624,151 @@ namespace UtopiaOS
             buddy_resource( buddy_resource && ) = delete;
             
             virtual ~buddy_resource( void );
+            
+            /** \brief Sets the trimming policy.
+             * \param[in] low The number of free top-level blocks
+             *                that are kept when trimming.
+             * \param[in] high The number of free top-level blocks
+             *                 above which trimming happens
+             *                 automatically upon deallocation.
+             *
+             * By default, free top-level blocks are never
+             * returned to the upstream resource.
+             *
+             * \throws std::invalid_argument if \a low is
+             *         larger than \a high.
+             */
+            void set_trim_watermarks( std::size_t low, std::size_t high );
+            
+            using core::trim;
+            
+            /** \brief Returns free top-level blocks to the
+             *         upstream resource as specified by the
+             *         low watermark of the trimming policy.
+             * \returns The number of bytes returned to the
+             *          upstream resource.
+             */
+            std::size_t trim( void )
+            { return trim( trim_low_watermark ); }
+            
+            /** \brief Checks whether an allocation request fits
+             *         into a block of this resource at all.
+             * \param[in] bytes The number of bytes requested
+             * \param[in] alignment The requested alignment
+             * \returns \a true if the request fits into a
+             *          top-level block, that is if it can be
+             *          satisfied given enough upstream memory.
+             */
+            bool can_satisfy( std::size_t bytes,
+                             std::size_t alignment = detail::max_align ) const
+            { return (level_for_allocation_request( bytes, alignment ) <= max_block_level); }
+            
+            /** \brief Tries to grow an allocation in place.
+             * \param[in] p The address of the allocation
+             * \param[in] old_bytes The size \a p was allocated with
+             * \param[in] new_bytes The requested size
+             * \param[in] alignment The alignment \a p was allocated with
+             * \returns \a true if the allocation now holds
+             *          \a new_bytes bytes, \a false if it is
+             *          left untouched. Requests that need a
+             *          smaller block always fail, use
+             *          \a shrink_in_place for these.
+             *
+             * The block absorbs its buddies as long as it is the
+             * first half at every level up to the required one
+             * and all of these buddies are free.
+             *
+             * \note Upon success \a p has to be deallocated with
+             *       \a new_bytes.
+             */
+            bool try_expand( void *p, std::size_t old_bytes,
+                            std::size_t new_bytes,
+                            std::size_t alignment = detail::max_align );
+            
+            /** \brief Shrinks an allocation in place.
+             * \param[in] p The address of the allocation
+             * \param[in] old_bytes The size \a p was allocated with
+             * \param[in] new_bytes The requested size, which must
+             *            not exceed \a old_bytes and has to be
+             *            non-zero.
+             * \param[in] alignment The alignment \a p was allocated with
+             *
+             * The unused second halves of the block are returned
+             * to the free lists. This always succeeds.
+             *
+             * \note Afterwards \a p has to be deallocated with
+             *       \a new_bytes.
+             */
+            void shrink_in_place( void *p, std::size_t old_bytes,
+                                 std::size_t new_bytes,
+                                 std::size_t alignment = detail::max_align );
+            
+            /** \brief Resizes an allocation.
+             * \param[in] p The address of the allocation
+             * \param[in] old_bytes The size \a p was allocated with
+             * \param[in] new_bytes The requested size
+             * \param[in] alignment The alignment \a p was allocated with
+             * \returns The address of the resized allocation, which
+             *          differs from \a p only if the allocation could
+             *          not be resized in place. In that case the first
+             *          \a min(old_bytes, new_bytes) bytes are copied.
+             *
+             * \throws std::bad_alloc if the allocation could neither
+             *         be grown in place nor moved. \a p is still
+             *         valid in that case.
+             */
+            void *reallocate( void *p, std::size_t old_bytes,
+                             std::size_t new_bytes,
+                             std::size_t alignment = detail::max_align );
+            
+            /** \brief Allocates several blocks of the same size.
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[out] out An array of \a count pointers that
+             *             receives the allocations.
+             *
+             * The allocations are carved from as few large blocks as
+             * possible. Every large block is obtained with a single
+             * split cascade and then cut into its children at once,
+             * without passing them through the free lists.
+             *
+             * \throws std::bad_alloc if not all of the allocations
+             *         could be satisfied. Nothing is allocated in
+             *         that case.
+             * \note Every allocation can be deallocated individually
+             *       or with \a deallocate_bulk.
+             */
+            void allocate_bulk( std::size_t count, std::size_t bytes,
+                               std::size_t alignment, void **out );
+            
+            /** \brief Allocates as many blocks of the same size as
+             *         the resource can satisfy.
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[out] out An array of \a count pointers, the
+             *             first ones of which receive the allocations.
+             * \returns The number of allocations that were made.
+             *
+             * The allocations are carved like the ones of
+             * \a allocate_bulk, but the ones that were made are
+             * kept if the resource runs out of memory.
+             */
+            std::size_t try_allocate_bulk( std::size_t count, std::size_t bytes,
+                                          std::size_t alignment, void **out ) noexcept;
+            
+            /** \brief Deallocates several allocations of the same size.
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[in] ptrs An array of \a count pointers to the
+             *            allocations.
+             */
+            void deallocate_bulk( std::size_t count, std::size_t bytes,
+                                 std::size_t alignment, void * const *ptrs );
+            
+            using core::accumulate_statistics;
         };
     }
 }
@@ -0,0 +1,202 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/cached_buddy_resource.cpp
+ * \brief This file implements the \a cached_buddy_resource
+ *        class, that keeps recently freed blocks of a
+ *        \a buddy_resource around for fast reuse.
+ */
+
+#include "cached_buddy_resource.hpp"
+
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <stdexcept>
+#include <new>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::cached_block;
+using detail::magazine;
+using detail::memory_block_info;
+using detail::cache_counters;
+using detail::buddy_counters;
+
+void *cached_buddy_resource::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    if( bytes == 0 )
+        return nullptr;
+    
+    // Cached blocks carry their data at the default offset,
+    // so over-aligned requests bypass the magazines.
+    auto level = backend->level_for_allocation_request( bytes, alignment );
+    if( level >= num_cached_levels || alignment > detail::max_align )
+    {
+        record( [] ( cache_counters &c ) { c.bypasses.add(); } );
+        
+        utils::spinlock_guard guard( backend_lock );
+        return backend->try_allocate( bytes, alignment );
+    }
+    
+    magazine &mag = magazines[level];
+    if( mag.top != nullptr )
+        record( [] ( cache_counters &c ) { c.hits.add(); } );
+    else
+    {
+        record( [] ( cache_counters &c ) { c.misses.add(); } );
+        
+        if( refill( level ) == false )
+            return nullptr;
+    }
+    
+    cached_block *block = mag.top;
+    mag.top = block->next;
+    mag.count--;
+    
+    return block;
+}
+
+void cached_buddy_resource::do_deallocate( void* p, std::size_t bytes,
+                                          std::size_t alignment )
+{
+    if( bytes == 0 )
+        return;
+    
+    auto level = backend->level_for_allocation_request( bytes, alignment );
+    if( level >= num_cached_levels || alignment > detail::max_align )
+    {
+        utils::spinlock_guard guard( backend_lock );
+        backend->deallocate( p, bytes, alignment );
+        return;
+    }
+    
+    magazine &mag = magazines[level];
+    if( mag.count == magazine_capacity )
+        drain( level, batch_size );
+    
+    cached_block *block = reinterpret_cast<cached_block *>( p );
+    block->next = mag.top;
+    mag.top = block;
+    mag.count++;
+}
+
+bool cached_buddy_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+bool cached_buddy_resource::refill( std::size_t level ) noexcept
+{
+    utils::debug_assert( level < num_cached_levels,
+                        "Level is not cached." );
+    
+    magazine &mag = magazines[level];
+    utils::spinlock_guard guard( backend_lock );
+    
+    std::size_t obtained = 0;
+    for( ; obtained != batch_size; ++obtained )
+    {
+        memory_block_info *info = backend->allocate_block( level );
+        
+        if( info == nullptr )
+            break;
+        
+        cached_block *block = reinterpret_cast<cached_block *>( info->data() );
+        block->next = mag.top;
+        mag.top = block;
+        mag.count++;
+    }
+    
+    record( [obtained] ( cache_counters &c ) { c.refilled_blocks.add( obtained ); } );
+    backend->record( [level, obtained] ( buddy_counters &c ) {
+        c.levels[level].allocations.add( obtained );
+    } );
+    
+    return (mag.top != nullptr);
+}
+
+void cached_buddy_resource::drain( std::size_t level, std::size_t count )
+{
+    utils::debug_assert( level < num_cached_levels,
+                        "Level is not cached." );
+    
+    magazine &mag = magazines[level];
+    utils::spinlock_guard guard( backend_lock );
+    
+    while( count != 0 && mag.top != nullptr )
+    {
+        cached_block *block = mag.top;
+        mag.top = block->next;
+        mag.count--;
+        count--;
+        
+        backend->deallocate_block( buddy_resource::block_for_data( block ), level );
+        record( [] ( cache_counters &c ) { c.drained_blocks.add(); } );
+    }
+}
+
+void cached_buddy_resource::flush( void )
+{
+    for( std::size_t level = 0; level != num_cached_levels; ++level )
+        drain( level, magazines[level].count );
+}
+
+cached_buddy_resource::cached_buddy_resource( buddy_resource *buddy,
+                                             std::size_t max_cached_block_size,
+                                             std::size_t capacity,
+                                             utils::spinlock *lock )
+: backend( buddy ), backend_lock( lock ), num_cached_levels( 0 ),
+magazine_capacity( capacity ), batch_size( capacity / 2 ),
+magazines( nullptr )
+{
+    if( capacity < 2 )
+        throw std::invalid_argument( "The magazine capacity has to be \
+at least two." );
+
+    if( max_cached_block_size >= backend->min_block_size )
+    {
+        std::size_t max_cached_level = (utils::msb( max_cached_block_size ) -
+                                        backend->min_msb);
+        num_cached_levels = std::min( max_cached_level + 1,
+                                     backend->num_block_levels );
+    }
+    
+    if( num_cached_levels == 0 )
+        return;
+    
+    utils::spinlock_guard guard( backend_lock );
+    magazines = reinterpret_cast<magazine *>(
+                    backend->allocate( num_cached_levels * sizeof(magazine),
+                                      alignof(magazine) ) );
+    for( std::size_t level = 0; level != num_cached_levels; ++level )
+        magazines[level] = magazine{ nullptr, 0 };
+}
+
+void cached_buddy_resource::accumulate_statistics( cache_statistics &sum ) const
+{
+    if( const cache_counters *counters = recorded() )
+    {
+        sum.hits += counters->hits.load();
+        sum.misses += counters->misses.load();
+        sum.bypasses += counters->bypasses.load();
+        sum.refilled_blocks += counters->refilled_blocks.load();
+        sum.drained_blocks += counters->drained_blocks.load();
+    }
+}
+
+cached_buddy_resource::~cached_buddy_resource( void )
+{
+    if( num_cached_levels == 0 )
+        return;
+    
+    flush();
+    
+    utils::spinlock_guard guard( backend_lock );
+    backend->deallocate( magazines, num_cached_levels * sizeof(magazine),
+                        alignof(magazine) );
+}
+
+/** \} */
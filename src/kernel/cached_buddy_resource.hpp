@@ -0,0 +1,161 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/cached_buddy_resource.hpp
+ * \brief This file declares the \a cached_buddy_resource
+ *        class, that keeps recently freed blocks of a
+ *        \a buddy_resource around for fast reuse.
+ */
+
+#ifndef H_kernel_cached_buddy_resource
+#define H_kernel_cached_buddy_resource
+
+#include "buddy_resource.hpp"
+
+#include "utils/spinlock.hpp"
+
+#include <memory_resource>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct cached_block
+             * \brief The link that is stored in the data
+             *        of a block while it resides in a magazine.
+             */
+            struct cached_block
+            {
+                cached_block *next;
+            };
+            
+            /** \struct magazine
+             * \brief A bounded stack of cached blocks of one level.
+             */
+            struct magazine
+            {
+                cached_block *top;
+                std::size_t count;
+            };
+            
+            /** \struct cache_counters
+             * \brief The counters of a \a cached_buddy_resource.
+             */
+            struct cache_counters
+            {
+                statistic_counter hits, misses, bypasses;
+                statistic_counter refilled_blocks, drained_blocks;
+            };
+        }
+        
+        /** \class cached_buddy_resource
+         * \brief A conforming subclass of \a std::pmr::memory_resource
+         *        that caches freed blocks of a \a buddy_resource
+         *        in bounded per-level magazines.
+         *
+         * Allocations and deallocations of cached levels are
+         * served in O(1) from the magazines. Empty magazines are
+         * refilled from the backend in batches and magazines
+         * that are full are drained to the backend in batches,
+         * so that the splitting and merging costs of the backend
+         * are amortized.
+         *
+         * \note This class is not synchronized. It is meant to
+         *       be instantiated once per CPU in front of a shared
+         *       backend, such that no two CPUs touch the same
+         *       magazines. If a backend lock is given, every access
+         *       to the backend is made while holding it.
+         */
+        class cached_buddy_resource : public fallible_resource,
+                                      private detail::statistics_storage<detail::cache_counters>
+        {
+        public:
+            /** \brief The default number of blocks a magazine can hold */
+            static constexpr std::size_t default_magazine_capacity = 32;
+        private:
+            buddy_resource *backend;
+            utils::spinlock *backend_lock;
+            
+            std::size_t num_cached_levels;
+            std::size_t magazine_capacity;
+            std::size_t batch_size;
+            
+            detail::magazine *magazines;
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            
+            /** \brief Refills the magazine of a given level
+             *         with up to \a batch_size blocks from
+             *         the backend.
+             * \param[in] level The level of the magazine
+             * \returns \a false if not a single block
+             *          could be obtained.
+             */
+            bool refill( std::size_t level ) noexcept;
+            
+            /** \brief Returns up to \a count blocks from the
+             *         magazine of a given level to the backend.
+             * \param[in] level The level of the magazine
+             * \param[in] count The number of blocks to return
+             */
+            void drain( std::size_t level, std::size_t count );
+        public:
+            /** \brief Constructs a \a cached_buddy_resource object
+             * \param[in] buddy The backend resource.
+             * \param[in] max_cached_block_size Blocks larger than this
+             *            are never cached, but always forwarded
+             *            to the backend.
+             * \param[in] capacity The number of blocks per magazine.
+             * \param[in] lock The lock that protects the backend
+             *            or \a nullptr if it is not shared.
+             *
+             * \throws std::invalid_argument if \a capacity is
+             *         less than two.
+             * \note The magazines are allocated from \a buddy.
+             */
+            cached_buddy_resource( buddy_resource *buddy,
+                                  std::size_t max_cached_block_size,
+                                  std::size_t capacity = default_magazine_capacity,
+                                  utils::spinlock *lock = nullptr );
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            cached_buddy_resource( const cached_buddy_resource & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            cached_buddy_resource( cached_buddy_resource && ) = delete;
+            
+            /** \brief Returns all cached blocks to the backend. */
+            void flush( void );
+            
+            /** \brief Adds the figures of this resource
+             *         to a snapshot.
+             * \param[inout] sum The snapshot, so that several
+             *               resources can be summed up.
+             *
+             * \note This function may be called from any
+             *       processor.
+             */
+            void accumulate_statistics( cache_statistics &sum ) const;
+            
+            virtual ~cached_buddy_resource( void );
+        };
+    }
+}
+
+#endif
+
+/** \} */
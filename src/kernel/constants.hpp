@@ -25,6 +25,29 @@ namespace UtopiaOS
          */
         static constexpr std::size_t pagesize = UTOPIAOS_KERNEL_PAGESIZE;
         
+        /* \brief The sizes of the large pages the
+         *        kernel can map, which have to be
+         *        powers of two and multiples of
+         *        \a pagesize!
+         */
+        static constexpr std::size_t large_pagesize = UTOPIAOS_KERNEL_LARGE_PAGESIZE;
+        static constexpr std::size_t huge_pagesize = UTOPIAOS_KERNEL_HUGE_PAGESIZE;
+        
+        /* \brief The percentage of the large-page aligned
+         *        part of every available memory region that
+         *        is reserved for the large-page allocator.
+         */
+        static constexpr std::size_t large_page_reservation =
+            UTOPIAOS_LARGE_PAGE_RESERVATION;
+        
+        static_assert( large_page_reservation <= 100,
+            "The large-page reservation has to be a percentage." );
+        
+        /* \brief Reservations of fewer large pages
+         *        are left to the small pages.
+         */
+        static constexpr std::size_t min_large_page_reservation = 2;
+        
         namespace detail
         {
             static constexpr std::size_t pagesize_msb = utils::msb( pagesize );
@@ -51,9 +74,43 @@ namespace UtopiaOS
         static constexpr std::size_t smallest_memory_chunk =
             (pagesize >> detail::mem_chunk_levels);
         
+        /* \brief The size of the arenas a processor
+         *        obtains at once for its small allocations.
+         *        It has to be a power of two!
+         */
+        static constexpr std::size_t processor_arena_size = (pagesize << 4);
+        
+        /* \brief The smallest block of the arenas a
+         *        processor keeps for power-of-two
+         *        allocations of whole pages, which carry
+         *        no header. Zero serves them from the
+         *        other arenas instead.
+         */
+        static constexpr std::size_t processor_page_block_size = pagesize;
+        
+        /* \brief The maximum number of cleared pages
+         *        the kernel keeps for zeroed allocations.
+         */
+        static constexpr std::size_t zeroed_pool_capacity = 1024;
+        
+        /* \brief Every proximity domain sets up at least this
+         *        many bytes of its available memory, or the
+         *        \a eager_memory_fraction th part of it if that
+         *        is more, while the memory manager is built.
+         *        The rest is set up later and in parallel.
+         */
+        static constexpr std::size_t min_eager_memory = (std::size_t( 1 ) << 26);
+        static constexpr std::size_t eager_memory_fraction = 256;
+        
         static_assert( pagesize != 0, "pagesize must not be zero" );
         static_assert( ((pagesize - 1) & pagesize) == 0,
                       "pagesize must be a power of two" );
+        static_assert( ((large_pagesize - 1) & large_pagesize) == 0 &&
+                      large_pagesize % pagesize == 0,
+                      "large_pagesize must be a power of two multiple of pagesize" );
+        static_assert( ((huge_pagesize - 1) & huge_pagesize) == 0 &&
+                      huge_pagesize % large_pagesize == 0,
+                      "huge_pagesize must be a power of two multiple of large_pagesize" );
     }
 }
 
@@ -14,10 +14,21 @@
 #include <initializer_list>
 #include <memory_resource>
 #include <stdexcept>
+#include <algorithm>
 #include <memory>
 #include <limits>
+#include <array>
+
+#include <boost/iterator/counting_iterator.hpp>
+
+#include "fallible_resource.hpp"
+#include "buddy_resource.hpp"
+#include "allocator_statistics.hpp"
 
 #include "utils/dynarray.hpp"
+#include "utils/bitwise.hpp"
+#include "utils/ranges.hpp"
+#include "utils/debug.hpp"
 #include "target/memory.hpp"
 
 namespace UtopiaOS
@@ -30,27 +41,315 @@ namespace UtopiaOS
          *        deallocation request to one
          *        of its possibly several upstream
          *        memory resources.
+         *
+         * Every upstream resource serves memory from a
+         * memory region that is known upon construction.
+         * The regions are kept in a table sorted by address,
+         * so that deallocation requests can be routed to
+         * the owning upstream resource by their address
+         * alone, without any per-allocation bookkeeping.
+         *
+         * For every upstream resource an upper bound of the largest
+         * request it can still satisfy is tracked. The upstream
+         * resources are kept in buckets by the magnitude of this
+         * bound, so that allocation requests are only forwarded to
+         * upstream resources that may be able to satisfy them,
+         * smallest capacity first. The bound is only lowered by
+         * failed requests and raised by deallocations, so that it
+         * never drops below the truth. Thus exhausted upstream
+         * resources are never consulted until something is
+         * deallocated to them or they are replenished.
          */
-        class distributed_resource : public std::pmr::memory_resource
+        namespace detail
+        {
+            /** \struct route_counters
+             * \brief The counters of an upstream resource
+             *        of a \a distributed_resource.
+             */
+            struct route_counters
+            {
+                statistic_counter attempts, hits;
+            };
+        }
+        
+        class distributed_resource : public fallible_resource
         {
         private:
-            using resource_ptr_allocator =
-                std::pmr::polymorphic_allocator<std::pmr::memory_resource *>;
-            using resource_container = utils::dynarray<std::pmr::memory_resource *,
-                resource_ptr_allocator
-            >;
+            static constexpr std::size_t no_route =
+                std::numeric_limits<std::size_t>::max();
+            static constexpr std::size_t num_buckets =
+                std::numeric_limits<std::size_t>::digits;
+            
+            /** \struct route
+             * \brief An upstream resource together with
+             *        the memory region it serves.
+             */
+            struct route : public detail::statistics_storage<detail::route_counters>
+            {
+                target::memory_region region;
+                std::pmr::memory_resource *resource;
+            
+                /** \brief An upper bound of the largest request
+                 *         the upstream resource can satisfy.
+                 */
+                std::size_t capacity;
+                /** \brief The links of the bucket list */
+                std::size_t previous, next;
+                
+                bool operator<( const route &other ) const
+                { return region < other.region; }
+                
+                /** \brief Counts a request forwarded to
+                 *         the upstream resource.
+                 * \param[in] hit Whether it was satisfied
+                 */
+                void count_request( bool hit ) noexcept
+                { count_requests( 1, hit ? 1 : 0 ); }
+                
+                /** \brief Counts several requests forwarded to
+                 *         the upstream resource.
+                 * \param[in] attempts The number of requests
+                 * \param[in] hits How many of them were satisfied
+                 */
+                void count_requests( std::size_t attempts, std::size_t hits ) noexcept
+                {
+                    record( [=] ( detail::route_counters &c ) {
+                        c.attempts.add( attempts );
+                        c.hits.add( hits );
+                    } );
+                }
+                
+                /** \brief Returns a snapshot of the route. */
+                upstream_statistics statistics( void ) const noexcept
+                {
+                    const detail::route_counters *counters = recorded();
+                    return { region, (counters != nullptr ? counters->attempts.load() : 0),
+                             (counters != nullptr ? counters->hits.load() : 0) };
+                }
+            };
+            
+            using route_allocator = std::pmr::polymorphic_allocator<route>;
+            using route_container = utils::dynarray<route, route_allocator>;
+            
+            route_container routes; /**< The upstream resources sorted by address */
+            
+            /** \brief The first route of every bucket. Bucket \a n
+             *         holds the routes whose capacity has its most
+             *         significant bit at position \a n + 1. Routes
+             *         of capacity zero are not in any bucket.
+             */
+            std::array<std::size_t, num_buckets> buckets;
+            
+            /** \brief Bit \a n is set if and only if
+             *         \a buckets[n] is not empty.
+             */
+            std::size_t non_empty_buckets = 0;
+            
+            /** \brief The size every run of memory the upstream
+             *         resources hand out is a multiple of and
+             *         is aligned to, which is a power of two.
+             */
+            std::size_t granule;
+            
+            /** \brief Inserts a route into the bucket
+             *         that matches its capacity.
+             * \param[in] index The index of the route
+             */
+            void link_route( std::size_t index ) noexcept
+            {
+                route &r = routes[index];
+                r.previous = no_route;
+                r.next = no_route;
+                
+                if( r.capacity == 0 )
+                    return;
+                
+                std::size_t bucket = utils::msb( r.capacity ) - 1;
+                r.next = buckets[bucket];
+                if( r.next != no_route )
+                    routes[r.next].previous = index;
+                
+                buckets[bucket] = index;
+                non_empty_buckets |= (std::size_t(1U) << bucket);
+            }
+            
+            /** \brief Removes a route from its bucket.
+             * \param[in] index The index of the route
+             */
+            void unlink_route( std::size_t index ) noexcept
+            {
+                route &r = routes[index];
+                
+                if( r.capacity == 0 )
+                    return;
+                
+                std::size_t bucket = utils::msb( r.capacity ) - 1;
+                if( r.previous == no_route )
+                {
+                    buckets[bucket] = r.next;
+                    if( r.next == no_route )
+                        non_empty_buckets &= ~(std::size_t(1U) << bucket);
+                } else
+                    routes[r.previous].next = r.next;
+                
+                if( r.next != no_route )
+                    routes[r.next].previous = r.previous;
+            }
+            
+            /** \brief Updates the capacity of a route.
+             * \param[in] index The index of the route
+             * \param[in] capacity The new capacity
+             */
+            void set_capacity( std::size_t index, std::size_t capacity ) noexcept
+            {
+                unlink_route( index );
+                routes[index].capacity = capacity;
+                link_route( index );
+            }
             
-            resource_container resources; /**< The upstream resources */
+            /** \brief Forwards an allocation request to an
+             *         upstream resource and updates its capacity.
+             * \param[in] index The index of the route
+             * \param[in] bytes The number of bytes requested
+             * \param[in] alignment The requested alignment
+             * \returns The allocated memory or \a nullptr
+             */
+            void *try_route( std::size_t index, std::size_t bytes,
+                            std::size_t alignment ) noexcept
+            {
+                route &r = routes[index];
+                void *memory = kernel::try_allocate( r.resource, bytes, alignment );
+                r.count_request( memory != nullptr );
+                
+                // A successful request may have been served from any
+                // free run, so it leaves the bound of the largest one.
+                if( memory == nullptr )
+                    lower_capacity( index, bytes, alignment );
+                
+                return memory;
+            }
+            
+            /** \brief Forwards as many allocations of a batch as
+             *         it can satisfy to an upstream resource and
+             *         updates its capacity.
+             * \param[in] index The index of the route
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[out] out An array of \a count pointers, the
+             *             first ones of which receive the allocations.
+             * \returns The number of allocations that were made.
+             *
+             * A \a buddy_resource is handed the whole batch at once,
+             * every other upstream resource gets one request after
+             * the other until it fails.
+             */
+            std::size_t try_route_bulk( std::size_t index, std::size_t count,
+                                       std::size_t bytes, std::size_t alignment,
+                                       void **out ) noexcept
+            {
+                route &r = routes[index];
+                std::size_t done = 0;
+                
+                if( auto buddy = dynamic_cast<buddy_resource *>( r.resource ) )
+                    done = buddy->try_allocate_bulk( count, bytes, alignment, out );
+                else if( auto fallible = dynamic_cast<fallible_resource *>( r.resource ) )
+                {
+                    while( done != count &&
+                          (out[done] = fallible->try_allocate( bytes, alignment )) != nullptr )
+                        ++done;
+                } else
+                {
+                    while( done != count &&
+                          (out[done] = kernel::try_allocate( r.resource, bytes, alignment )) != nullptr )
+                        ++done;
+                }
+                
+                r.count_requests( done + (done != count), done );
+                if( done != count )
+                    lower_capacity( index, bytes, alignment );
+                
+                return done;
+            }
+            
+            /** \brief Lowers the capacity of a route after it
+             *         failed an allocation request.
+             * \param[in] index The index of the route
+             * \param[in] bytes The number of bytes requested
+             * \param[in] alignment The requested alignment
+             */
+            void lower_capacity( std::size_t index, std::size_t bytes,
+                                std::size_t alignment ) noexcept
+            {
+                // Empty requests tell nothing.
+                if( bytes == 0 )
+                    return;
+                
+                // Had there been room for the request plus
+                // the largest possible alignment padding
+                // it would have succeeded. Both are counted
+                // in whole granules.
+                std::size_t padding = std::max( alignment, granule ) - granule;
+                std::size_t limit = std::numeric_limits<std::size_t>::max() - padding;
+                std::size_t granules = bytes / granule + (bytes % granule != 0);
+                std::size_t bound = (granules > limit / granule ?
+                                     std::numeric_limits<std::size_t>::max() :
+                                     (granules - 1) * granule + padding);
+                set_capacity( index, std::min( routes[index].capacity, bound ) );
+            }
+            
+            /** \brief Visits the routes that may satisfy a request.
+             * \tparam Function The function object type
+             * \param[in] bytes The number of bytes requested
+             * \param[in] function The function to apply to the index
+             *            of every candidate route, which returns
+             *            \a true to end the visit.
+             * \returns \a true if \a function ended the visit.
+             *
+             * The buckets that may hold a suitable upstream resource
+             * are visited in ascending order. Routes whose capacity
+             * changes during the visit are not visited again.
+             */
+            template<class Function>
+            bool visit_candidates( std::size_t bytes, Function function )
+            {
+                std::size_t required = std::max( bytes, std::size_t( 1U ) );
+                std::size_t first_bucket = utils::msb( required ) - 1;
+                std::size_t candidates = ((non_empty_buckets >> first_bucket) << first_bucket);
+                
+                while( candidates != 0 )
+                {
+                    std::size_t bucket = utils::ctz( candidates );
+                    candidates &= (candidates - 1);
+                    
+                    for( std::size_t index = buckets[bucket]; index != no_route; )
+                    {
+                        std::size_t next = routes[index].next;
+                        
+                        if( routes[index].capacity >= required && function( index ) )
+                            return true;
+                        
+                        index = next;
+                    }
+                }
+                
+                return false;
+            }
             
             /** \brief Stores a range of memory resource
-             *         pointers in a \a resource_container.
-             * \tparam RandomAccessIterator The iterator type
+             *         pointers together with the memory
+             *         regions they serve in a
+             *         \a route_container.
+             * \tparam ResourceIterator The resource iterator type
+             * \tparam RegionIterator The region iterator type
              * \param[in] resource_begin The begin of the
              *                           resource range.
              * \param[in] resource_end The end of the
              *                         resource range.
-             * \returns A \a resource_container object
-             *          containing the pointers to the
+             * \param[in] region_begin The begin of the
+             *                         region range.
+             * \returns A \a route_container object
+             *          containing the routes to the
              *          memory resource objects in the
              *          given range.
              * \throws std::bad_alloc if the range could
@@ -59,20 +358,29 @@ namespace UtopiaOS
              *       this function attempts to allocate
              *       some memory from the given resources.
              */
-            template<class RandomAccessIterator>
-            static auto
-            store_resources( RandomAccessIterator resource_begin,
-                            RandomAccessIterator resource_end )
+            template<class ResourceIterator, class RegionIterator>
+            static route_container
+            store_routes( ResourceIterator resource_begin,
+                         ResourceIterator resource_end,
+                         RegionIterator region_begin )
             {
+                std::size_t num_routes = (resource_end - resource_begin);
+                auto route_constructor = [&] ( route *r, std::size_t index ) {
+                    const target::memory_region &region = region_begin[index];
+                    new (r) route{ {}, region, resource_begin[index],
+                                   region.size, no_route, no_route };
+                };
+                
                 for( auto it = resource_begin; it != resource_end; ++it )
                 {
-                    resource_ptr_allocator allocator( *it );
+                    route_allocator allocator( *it );
                     
                     try
                     {
-                        return resource_container( resource_begin,
-                                                  resource_end,
-                                                  std::move( allocator ) );
+                        return route_container( boost::make_counting_iterator( std::size_t( 0 ) ),
+                                               boost::make_counting_iterator( num_routes ),
+                                               std::move( allocator ),
+                                               route_constructor );
                     } catch( const std::bad_alloc & )
                     {}
                 }
@@ -80,90 +388,68 @@ namespace UtopiaOS
                 throw std::bad_alloc();
             }
             
-            /** \brief Calculate the padding required
-             *         for internal bookkeeping purposes
-             * \param[in] bytes The number of bytes in
-             *            the allocation request.
-             * \param[in] alignment The required alignment
-             *            in the allocation request.
-             * \returns The padding that is necessary for
-             *          internal bookkeeping purposes.
+            /** \brief Returns the route of the upstream
+             *         resource an allocation belongs to.
+             * \param[in] p The address of the allocation
+             * \returns The route whose region contains \a p.
+             *
+             * The search does not branch on the data, so
+             * that its cost only depends on the number of
+             * upstream resources.
+             *
+             * \note \a p has to be contained in one of the
+             *       regions otherwise the behaviour is
+             *       undefined.
              */
-            std::size_t required_padding( std::size_t bytes, std::size_t alignment )
+            const route &route_for( void *p ) const
             {
-                std::size_t end_alignment_offset = ((alignment % alignof(std::size_t)) +
-                                                    (bytes % alignof(std::size_t)));
-                std::size_t padding;
-                
-                if( end_alignment_offset != 0 )
-                {
-                    padding = alignof(std::size_t) - end_alignment_offset;
-                    if( std::numeric_limits<std::size_t>::max() - padding < bytes )
-                        throw std::overflow_error( "" );
-                } else
-                    padding = 0;
-                
-                if( std::numeric_limits<std::size_t>::max() - sizeof(std::size_t) <
-                   bytes + padding )
-                    throw std::overflow_error( "" );
+                std::uintptr_t address = target::ptr_to_uintptr( p );
+                const route *first = utils::last_not_greater( routes.cbegin(),
+                                                             routes.cend(),
+                                                             address,
+                                                             [] ( const route &r ) {
+                                                                 return r.region.base();
+                                                             } );
                 
-                return padding;
+                utils::debug_assert( address >= first->region.base() &&
+                                    address < first->region.top(),
+                                    "The address does not belong to any upstream resource." );
+                return *first;
             }
             
-            virtual void* do_allocate( std::size_t bytes, std::size_t alignment )
+            /** \brief As specified by \a fallible_resource
+             *
+             * The candidate routes are asked one after the other.
+             * Every upstream resource that fails lowers its bound
+             * below the request, so a failing request only visits
+             * the upstream resources that changed since the last
+             * failure of its size.
+             */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept
             {
-                std::size_t padding;
-                try
-                {
-                    padding = required_padding( bytes, alignment );
-                } catch( const std::overflow_error & )
-                {
-                    throw std::bad_alloc();
-                }
-                
-                std::size_t actual_size = bytes + padding + sizeof(std::size_t);
+                void *memory = nullptr;
+                visit_candidates( bytes, [&] ( std::size_t index ) {
+                    memory = try_route( index, bytes, alignment );
+                    return (memory != nullptr);
+                } );
                 
-                for( std::size_t index = 0; index != resources.size(); index++ )
-                {
-                    void *memory = nullptr;
-                    
-                    try
-                    {
-                         memory = resources[index]->allocate( actual_size, alignment );
-                    } catch( const std::bad_alloc & )
-                    {}
-                    
-                    if( memory != nullptr )
-                    {
-                        static_assert( std::numeric_limits<std::uintptr_t>::max() >=
-                                      std::numeric_limits<std::size_t>::max(),
-                                      "This implementation cannot guarantee to work." );
-                        
-                        std::uintptr_t index_address = (target::ptr_to_uintptr( memory ) +
-                                                        bytes + padding);
-                        *target::uintptr_to_ptr<std::size_t>( index_address ) = index;
-                        return memory;
-                    }
-                }
-                
-                throw std::bad_alloc();
+                return memory;
             }
             
             virtual void do_deallocate( void* p, std::size_t bytes, std::size_t alignment )
             {
-                std::size_t padding = required_padding( bytes, alignment );
+                const route &r = route_for( p );
+                std::size_t index = (&r - routes.data());
                 
-                static_assert( std::numeric_limits<std::uintptr_t>::max() >=
-                              std::numeric_limits<std::size_t>::max(),
-                              "This implementation cannot guarantee to work." );
+                r.resource->deallocate( p, bytes, alignment );
                 
-                std::uintptr_t index_address = (target::ptr_to_uintptr( p ) +
-                                                bytes + padding);
-                std::size_t index = *target::uintptr_to_ptr<std::size_t>( index_address );
-                resources[index]->deallocate( p, bytes, alignment );
+                // The freed memory may join the free runs around it,
+                // of which only the largest one is bounded.
+                set_capacity( index, r.region.size );
             }
             
-            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept
             {
                 const distributed_resource *dr_other;
                 try
@@ -178,18 +464,53 @@ namespace UtopiaOS
         public:
             /** \brief Construct a \a distributed_resource
              *         object from a range of upstream
-             *         memory resource objects
-             * \tparam RandomAccessIterator The iterator type
+             *         memory resource objects and the
+             *         memory regions they serve.
+             * \tparam ResourceIterator The resource iterator type
+             * \tparam RegionIterator The region iterator type
              * \param[in] resource_begin The begin of the
              *                           resource range.
              * \param[in] resource_end The end of the
              *                         resource range.
+             * \param[in] region_begin The begin of the region
+             *                         range, which has to be
+             *                         as long as the resource
+             *                         range.
+             * \param[in] granularity The size every run of memory
+             *            the upstream resources hand out is a
+             *            multiple of and is aligned to, e.g. the
+             *            page size of page frame allocators. It
+             *            has to be a power of two and only serves
+             *            to tighten the tracked capacities.
+             *
+             * \note Every allocation obtained from an upstream
+             *       resource has to lie within the corresponding
+             *       region, and the regions have to be disjoint,
+             *       otherwise the behaviour is undefined.
              */
-            template<class RandomAccessIterator>
-            distributed_resource( RandomAccessIterator begin,
-                                 RandomAccessIterator end )
-            : resources( store_resources( begin, end ) )
-            {}
+            template<class ResourceIterator, class RegionIterator>
+            distributed_resource( ResourceIterator resource_begin,
+                                 ResourceIterator resource_end,
+                                 RegionIterator region_begin,
+                                 std::size_t granularity = 1 )
+            : routes( store_routes( resource_begin, resource_end, region_begin ) ),
+            granule( granularity )
+            {
+                utils::debug_assert( utils::popcount( granule ) == 1,
+                                    "The granularity has to be a power of two." );
+                
+                std::sort( routes.begin(), routes.end() );
+                
+                utils::debug_assert( std::adjacent_find( routes.begin(), routes.end(),
+                                        [] ( const route &lower, const route &upper ) {
+                                            return (lower.region.top() > upper.region.base());
+                                        } ) == routes.end(),
+                                    "The upstream regions have to be disjoint." );
+                
+                buckets.fill( no_route );
+                for( std::size_t index = 0; index != routes.size(); ++index )
+                    link_route( index );
+            }
             
             /** \brief A std::pmr::memory_resource should not be
              *         copyable.
@@ -200,6 +521,120 @@ namespace UtopiaOS
              *         movable.
              */
             distributed_resource( distributed_resource && ) = delete;
+            
+            /** \brief Allocates several blocks of the same size.
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[out] out An array of \a count pointers that
+             *             receives the allocations.
+             *
+             * The candidate routes are visited like for a single
+             * request. Every one of them is handed all remaining
+             * allocations at once, so that the next one is only
+             * asked for the ones it could not satisfy.
+             *
+             * \throws std::bad_alloc if not all of the allocations
+             *         could be satisfied. Nothing is allocated in
+             *         that case.
+             */
+            void allocate_bulk( std::size_t count, std::size_t bytes,
+                               std::size_t alignment, void **out )
+            {
+                if( count == 0 )
+                    return;
+                
+                if( bytes == 0 )
+                {
+                    std::fill( out, out + count, nullptr );
+                    return;
+                }
+                
+                std::size_t done = 0;
+                bool complete = visit_candidates( bytes, [&] ( std::size_t index ) {
+                    done += try_route_bulk( index, count - done, bytes, alignment, out + done );
+                    return (done == count);
+                } );
+                
+                if( complete == false )
+                {
+                    deallocate_bulk( done, bytes, alignment, out );
+                    throw std::bad_alloc();
+                }
+            }
+            
+            /** \brief Deallocates several allocations of the same size.
+             * \param[in] count The number of allocations
+             * \param[in] bytes The size of every allocation
+             * \param[in] alignment The alignment of every allocation
+             * \param[in] ptrs An array of \a count pointers to the
+             *            allocations.
+             *
+             * Consecutive allocations from the same upstream resource
+             * are routed together, which is how \a allocate_bulk
+             * hands them out.
+             */
+            void deallocate_bulk( std::size_t count, std::size_t bytes,
+                                 std::size_t alignment, void * const *ptrs )
+            {
+                for( std::size_t first = 0; first != count; )
+                {
+                    const route &r = route_for( ptrs[first] );
+                    std::size_t index = (&r - routes.data());
+                    
+                    std::size_t last = first + 1;
+                    while( last != count &&
+                          target::ptr_to_uintptr( ptrs[last] ) - r.region.base() < r.region.size )
+                        ++last;
+                    
+                    if( auto buddy = dynamic_cast<buddy_resource *>( r.resource ) )
+                        buddy->deallocate_bulk( last - first, bytes, alignment, ptrs + first );
+                    else
+                    {
+                        for( std::size_t i = first; i != last; ++i )
+                            r.resource->deallocate( ptrs[i], bytes, alignment );
+                    }
+                    
+                    set_capacity( index, r.region.size );
+                    first = last;
+                }
+            }
+            
+            /** \brief Notifies the resource that an upstream resource
+             *         gained memory other than by a deallocation
+             *         through this resource.
+             * \param[in] p An address within the region of the
+             *            upstream resource
+             *
+             * Otherwise, an upstream resource that failed a request
+             * would not be consulted again for requests of that
+             * size, e.g. after reserved memory has been released.
+             *
+             * \note \a p has to be contained in one of the
+             *       regions otherwise the behaviour is
+             *       undefined.
+             */
+            void replenish( void *p ) noexcept
+            {
+                const route &r = route_for( p );
+                set_capacity( static_cast<std::size_t>( &r - routes.data() ), r.region.size );
+            }
+            
+            /** \brief Returns the number of upstream resources. */
+            std::size_t number_of_upstreams( void ) const
+            { return routes.size(); }
+            
+            /** \brief Returns a snapshot of an upstream resource.
+             * \param[in] index The index of the upstream resource,
+             *            which has to be less than
+             *            \a number_of_upstreams(). The upstream
+             *            resources are ordered by the address
+             *            of their regions.
+             * \returns The requests forwarded to the upstream
+             *          resource and how many of them it satisfied.
+             */
+            upstream_statistics statistics( std::size_t index ) const
+            { return routes[index].statistics(); }
         };
     }
 }
@@ -0,0 +1,102 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/fallible_resource.hpp
+ * \brief This file declares the \a fallible_resource
+ *        class, that is a memory resource which can
+ *        report allocation failure without throwing.
+ */
+
+#ifndef H_kernel_fallible_resource
+#define H_kernel_fallible_resource
+
+#include <memory_resource>
+#include <memory>
+#include <new>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        /** \class fallible_resource
+         * \brief A subclass of \a std::pmr::memory_resource
+         *        that can signal allocation failure by
+         *        returning \a nullptr instead of throwing.
+         *
+         * Subclasses implement \a do_try_allocate. The throwing
+         * interface of \a std::pmr::memory_resource is provided
+         * on top of it, so that both interfaces behave the same
+         * except for the way failure is reported.
+         */
+        class fallible_resource : public std::pmr::memory_resource
+        {
+        public:
+            /** \brief Allocates memory without throwing.
+             * \param[in] bytes The number of bytes to allocate
+             * \param[in] alignment The alignment of the allocation
+             * \returns The allocated memory or \a nullptr if the
+             *          request cannot be satisfied.
+             * \note Zero-sized requests may return \a nullptr
+             *       as well. Such a result need not be deallocated.
+             */
+            void *try_allocate( std::size_t bytes,
+                               std::size_t alignment = alignof(std::max_align_t) ) noexcept
+            { return do_try_allocate( bytes, alignment ); }
+        private:
+            /** \brief Allocates memory without throwing.
+             * \param[in] bytes The number of bytes to allocate
+             * \param[in] alignment The alignment of the allocation
+             * \returns The allocated memory or \a nullptr if the
+             *          request cannot be satisfied.
+             */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept = 0;
+            
+            /** \brief As specified by the c++ standard
+             * \throws std::bad_alloc if \a do_try_allocate fails.
+             */
+            virtual void* do_allocate( std::size_t bytes, std::size_t alignment )
+            {
+                void *memory = do_try_allocate( bytes, alignment );
+                
+                if( memory == nullptr && bytes != 0 )
+                    throw std::bad_alloc();
+                
+                return memory;
+            }
+        };
+        
+        /** \brief Allocates memory from an arbitrary memory
+         *         resource without throwing.
+         * \param[in] resource The memory resource
+         * \param[in] bytes The number of bytes to allocate
+         * \param[in] alignment The alignment of the allocation
+         * \returns The allocated memory or \a nullptr if the
+         *          request cannot be satisfied.
+         *
+         * Subclasses of \a fallible_resource are asked directly,
+         * for all other resources a \a std::bad_alloc exception
+         * is translated into \a nullptr.
+         */
+        inline void *try_allocate( std::pmr::memory_resource *resource,
+                                  std::size_t bytes,
+                                  std::size_t alignment = alignof(std::max_align_t) ) noexcept
+        {
+            auto fallible = dynamic_cast<fallible_resource *>( resource );
+            if( fallible != nullptr )
+                return fallible->try_allocate( bytes, alignment );
+            
+            try
+            {
+                return resource->allocate( bytes, alignment );
+            } catch( const std::bad_alloc & )
+            {
+                return nullptr;
+            }
+        }
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,291 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/headerless_buddy_resource.cpp
+ * \brief This file implements the \a headerless_buddy_resource
+ *        class, that implements memory allocation through
+ *        the buddy method without per-block headers.
+ */
+
+#include "headerless_buddy_resource.hpp"
+
+#include "target/target.hpp"
+#include "target/memory.hpp"
+
+#ifdef UTOPIAOS_ALLOCA_WITH_ALIGN_HEADER
+#include UTOPIAOS_ALLOCA_WITH_ALIGN_HEADER
+#endif
+
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <new>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::free_block;
+using detail::arena_header;
+
+std::size_t headerless_buddy_resource::level_for_allocation_request( std::size_t bytes,
+                                                                   std::size_t alignment ) const
+{
+    auto required_size = std::max( bytes, alignment );
+    if( required_size <= min_block_size )
+        return 0;
+    
+    return (utils::msb( required_size - 1 ) + 1 - min_msb);
+}
+
+std::size_t headerless_buddy_resource::metadata_size( void ) const
+{
+    std::size_t num_nodes = (std::size_t(1U) << num_block_levels) - 1;
+    std::size_t num_words = (num_nodes + bits_per_word - 1) / bits_per_word;
+    
+    return (sizeof(arena_header) + num_words * sizeof(std::size_t));
+}
+
+bool headerless_buddy_resource::is_free( std::uintptr_t block, std::size_t level ) const
+{
+    std::size_t node = node_index( block, level );
+    const std::size_t *bitmap = arena_of( block )->free_bitmap();
+    
+    return ((bitmap[node / bits_per_word] & (std::size_t(1U) << (node % bits_per_word))) != 0);
+}
+
+void headerless_buddy_resource::set_free( std::uintptr_t block, std::size_t level )
+{
+    std::size_t node = node_index( block, level );
+    std::size_t *bitmap = arena_of( block )->free_bitmap();
+    
+    bitmap[node / bits_per_word] |= (std::size_t(1U) << (node % bits_per_word));
+}
+
+void headerless_buddy_resource::set_occupied( std::uintptr_t block, std::size_t level )
+{
+    std::size_t node = node_index( block, level );
+    std::size_t *bitmap = arena_of( block )->free_bitmap();
+    
+    bitmap[node / bits_per_word] &= ~(std::size_t(1U) << (node % bits_per_word));
+}
+
+void headerless_buddy_resource::push_free_block( std::uintptr_t block, std::size_t level )
+{
+    free_block *current = target::uintptr_to_ptr<free_block>( block );
+    
+    current->next = free_block_lists[level];
+    current->previous = nullptr;
+    free_block_lists[level] = current;
+    
+    if( current->next != nullptr )
+        current->next->previous = current;
+    
+    set_free( block, level );
+    non_empty_levels |= (std::size_t(1U) << level);
+}
+
+void headerless_buddy_resource::remove_free_block( std::uintptr_t block, std::size_t level )
+{
+    free_block *current = target::uintptr_to_ptr<free_block>( block );
+    
+    if( current->previous == nullptr )
+    {
+        free_block_lists[level] = current->next;
+        if( current->next == nullptr )
+            non_empty_levels &= ~(std::size_t(1U) << level);
+    } else
+        current->previous->next = current->next;
+    
+    if( current->next != nullptr )
+        current->next->previous = current->previous;
+    
+    set_occupied( block, level );
+}
+
+bool headerless_buddy_resource::add_arena( void ) noexcept
+{
+    void *memory = kernel::try_allocate( upstream, max_block_size, max_block_size );
+    std::uintptr_t base = target::ptr_to_uintptr( memory );
+    
+    if( memory == nullptr )
+        return false;
+    
+    if( (base % max_block_size) != 0 )
+    {
+        upstream->deallocate( memory, max_block_size, max_block_size );
+        return false;
+    }
+    
+    arena_header *arena = target::uintptr_to_ptr<arena_header>( base );
+    arena->next = arenas;
+    arenas = arena;
+    std::memset( arena->free_bitmap(), 0, metadata_size() - sizeof(arena_header) );
+    
+    // Split the top-level block along the leftmost path. The
+    // leftmost block of the metadata level holds the metadata
+    // and every right buddy on the way becomes free.
+    for( std::size_t level = max_block_level; level != metadata_level; --level )
+        push_free_block( base + block_size( level - 1 ), level - 1 );
+    
+    return true;
+}
+
+void *headerless_buddy_resource::do_try_allocate( std::size_t bytes,
+                                                  std::size_t alignment ) noexcept
+{
+    if( bytes == 0 )
+        return nullptr;
+    
+    auto level = level_for_allocation_request( bytes, alignment );
+    
+    if( level >= max_block_level )
+        return nullptr;
+    
+    std::size_t candidates = ((non_empty_levels >> level) << level);
+    if( candidates == 0 )
+    {
+        if( add_arena() == false )
+            return nullptr;
+        
+        candidates = ((non_empty_levels >> level) << level);
+        if( candidates == 0 )
+            return nullptr;
+    }
+    
+    std::size_t current_level = utils::ctz( candidates );
+    std::uintptr_t block = target::ptr_to_uintptr( free_block_lists[current_level] );
+    remove_free_block( block, current_level );
+    
+    while( current_level != level )
+    {
+        --current_level;
+        push_free_block( block + block_size( current_level ), current_level );
+    }
+    
+    return target::uintptr_to_ptr<void>( block );
+}
+
+void headerless_buddy_resource::do_deallocate( void* p, std::size_t bytes,
+                                              std::size_t alignment )
+{
+    if( bytes == 0 )
+        return;
+    
+    auto level = level_for_allocation_request( bytes, alignment );
+    std::uintptr_t block = target::ptr_to_uintptr( p );
+    
+    utils::debug_assert( level < max_block_level,
+                        "Block level is larger than maximum allocatable level." );
+    
+    // The metadata block is never free, so merging stops
+    // below the top level at the latest.
+    while( true )
+    {
+        std::uintptr_t buddy = (block ^ block_size( level ));
+        
+        if( is_free( buddy, level ) == false )
+            break;
+        
+        remove_free_block( buddy, level );
+        block = std::min( block, buddy );
+        level++;
+    }
+    
+    push_free_block( block, level );
+}
+
+void headerless_buddy_resource::accumulate_statistics( buddy_statistics &sum ) const
+{
+    for( std::size_t level = 0; level != num_block_levels; ++level )
+    {
+        std::size_t free_blocks = 0;
+        for( const free_block *block = free_block_lists[level];
+            block != nullptr; block = block->next )
+            free_blocks++;
+        
+        sum.sizes[level + min_msb - 1].free_blocks += free_blocks;
+        sum.free_bytes += free_blocks * block_size( level );
+        if( free_blocks != 0 )
+            sum.largest_free_block = std::max( sum.largest_free_block, block_size( level ) );
+    }
+    
+    for( const arena_header *arena = arenas; arena != nullptr; arena = arena->next )
+    {
+        sum.upstream_allocations++;
+        sum.bytes_held += max_block_size;
+    }
+}
+
+bool headerless_buddy_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+headerless_buddy_resource::headerless_buddy_resource( std::size_t min_bs,
+                                                     std::size_t max_bs,
+                                                     std::pmr::memory_resource *upstream_resource )
+: min_block_size( min_bs ), max_block_size( max_bs ),
+upstream( upstream_resource )
+{
+    if( min_block_size >= max_block_size )
+        throw std::invalid_argument( "The minimum block size has to be less than \
+the maximum block size." );
+    if( utils::popcount( min_block_size ) != 1 )
+        throw std::invalid_argument( "The minimum block size has to be a \
+power of two." );
+    if( utils::popcount( max_block_size ) != 1 )
+        throw std::invalid_argument( "The maximum block size has to be a \
+power of two." );
+
+    if( min_block_size < min_allowed_block_size )
+        throw std::invalid_argument( "The minimum block size has to be large \
+enough to hold the free list links." );
+    if( num_block_levels > max_num_allowed_block_levels )
+        throw std::invalid_argument( "Too many block levels." );
+    
+    metadata_level = level_for_allocation_request( metadata_size(), alignof(arena_header) );
+    if( metadata_level >= max_block_level )
+        throw std::invalid_argument( "The metadata does not fit \
+into a top-level block." );
+
+    block_lists_size = num_block_levels * sizeof(free_block *);
+    
+    /** \todo Some runtime size check */
+    
+    free_block_lists = reinterpret_cast<free_block **>(
+                        UTOPIAOS_ALLOCA_WITH_ALIGN( block_lists_size,
+                                                   alignof(free_block *) ) );
+    for( std::size_t level = 0; level < num_block_levels; level++ )
+        free_block_lists[level] = nullptr;
+    
+    void *block_lists_memory = allocate( block_lists_size,
+                                        alignof(free_block *) );
+    
+    std::memcpy( block_lists_memory, free_block_lists, block_lists_size );
+    free_block_lists = reinterpret_cast<free_block **>( block_lists_memory );
+}
+
+headerless_buddy_resource::~headerless_buddy_resource( void )
+{
+    /** \todo Some runtime size check */
+    
+    auto old_free_block_lists = reinterpret_cast<free_block **>(
+                        UTOPIAOS_ALLOCA_WITH_ALIGN( block_lists_size,
+                                                   alignof(free_block *) ) );
+    std::memcpy( old_free_block_lists, free_block_lists, block_lists_size );
+    std::swap( free_block_lists, old_free_block_lists );
+    
+    deallocate( old_free_block_lists, block_lists_size, alignof(free_block *) );
+    
+    for( auto current = arenas; current != nullptr; )
+    {
+        auto next = current->next;
+        upstream->deallocate( current, max_block_size, max_block_size );
+        current = next;
+    }
+}
+
+/** \} */
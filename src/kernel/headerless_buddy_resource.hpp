@@ -0,0 +1,229 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/headerless_buddy_resource.hpp
+ * \brief This file declares the \a headerless_buddy_resource
+ *        class, that implements memory allocation through
+ *        the buddy method without per-block headers.
+ */
+
+#ifndef H_kernel_headerless_buddy_resource
+#define H_kernel_headerless_buddy_resource
+
+#include "fallible_resource.hpp"
+#include "allocator_statistics.hpp"
+
+#include "utils/bitwise.hpp"
+#include "target/memory.hpp"
+
+#include <memory_resource>
+#include <limits>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct free_block
+             * \brief The list links that are stored inside
+             *        of a block while it is free.
+             */
+            struct free_block
+            {
+                free_block *previous, *next;
+            };
+            
+            /** \struct arena_header
+             * \brief The bookkeeping information at the start
+             *        of every top-level block. It is followed
+             *        by the free bitmap of the block tree.
+             */
+            struct arena_header
+            {
+                arena_header *next;
+                
+                std::size_t *free_bitmap( void )
+                { return reinterpret_cast<std::size_t *>( this + 1 ); }
+            };
+        }
+        
+        /** \class headerless_buddy_resource
+         * \brief A conforming subclass of \a std::pmr::memory_resource that
+         *        implements the 'buddy method' with out-of-band metadata.
+         *
+         * In contrast to \a buddy_resource no block carries a header.
+         * The state of every block is kept in a bitmap tree with one
+         * bit per block, that tells whether the block is on a free
+         * list. The free lists themselves live inside the free blocks.
+         * Hence allocations are exactly block-sized and every block
+         * is naturally aligned to its size.
+         *
+         * The bitmap of a top-level block is stored at its beginning
+         * and occupies the smallest block that can hold it. Thus the
+         * largest possible allocation is half the maximum block size.
+         */
+        class headerless_buddy_resource : public fallible_resource
+        {
+        public:
+            static constexpr std::size_t min_allowed_block_size =
+                sizeof(detail::free_block);
+            static constexpr std::size_t max_num_allowed_block_levels =
+                utils::msb( std::numeric_limits<std::size_t>::max() ) - 1;
+        private:
+            static constexpr std::size_t bits_per_word =
+                std::numeric_limits<std::size_t>::digits;
+            
+            std::size_t min_block_size;
+            std::size_t max_block_size;
+            
+            std::size_t max_msb = utils::msb( max_block_size );
+            std::size_t min_msb = utils::msb( min_block_size );
+            std::size_t max_block_level = max_msb - min_msb;
+            std::size_t num_block_levels = max_block_level + 1;
+            
+            std::size_t metadata_level;
+            
+            std::pmr::memory_resource *upstream;
+            
+            detail::arena_header *arenas = nullptr;
+            
+            std::size_t block_lists_size;
+            detail::free_block **free_block_lists;
+            
+            /** \brief Bit \a n is set if and only if
+             *         \a free_block_lists[n] is not empty.
+             */
+            std::size_t non_empty_levels = 0;
+            
+            /** \brief As specified by \a fallible_resource
+             * \note The returned memory is aligned to the
+             *       size of the block it occupies.
+             */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified in the c++ standard.
+             * \note This function never returns memory to
+             *       its upstreams resource.
+             */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            
+            /** \brief Returns the block level necessary to satisfy
+             *         a given allocation request.
+             * \param[in] bytes The number of bytes requested
+             * \param[in] alignment The requested alignment
+             * \returns The block level necessary to satisfy
+             *         a given allocation request.
+             */
+            std::size_t level_for_allocation_request( std::size_t bytes,
+                                                     std::size_t alignment ) const;
+            
+            /** \brief Returns the size of a block of a given level.
+             * \param[in] level The level of the block
+             * \returns The size of the block
+             */
+            std::size_t block_size( std::size_t level ) const
+            { return (std::size_t(1U) << (level + min_msb - 1)); }
+            
+            /** \brief Returns the top-level block a block belongs to.
+             * \param[in] block The address of the block
+             * \returns The arena header of the top-level block
+             */
+            detail::arena_header *arena_of( std::uintptr_t block ) const
+            { return target::uintptr_to_ptr<detail::arena_header>(
+                                            block & ~(max_block_size - 1) ); }
+            
+            /** \brief Returns the index of a block in the bitmap tree.
+             * \param[in] block The address of the block
+             * \param[in] level The level of the block
+             * \returns The index of the bit describing the block
+             */
+            std::size_t node_index( std::uintptr_t block, std::size_t level ) const
+            {
+                std::size_t depth = max_block_level - level;
+                std::size_t offset = block & (max_block_size - 1);
+                return ((std::size_t(1U) << depth) - 1 +
+                        (offset >> (level + min_msb - 1)));
+            }
+            
+            /** \brief Returns the number of bytes of metadata
+             *         every top-level block carries.
+             * \returns The number of bytes of metadata
+             */
+            std::size_t metadata_size( void ) const;
+            
+            /** \name Bitmap tree access
+             * \{ */
+            bool is_free( std::uintptr_t block, std::size_t level ) const;
+            void set_free( std::uintptr_t block, std::size_t level );
+            void set_occupied( std::uintptr_t block, std::size_t level );
+            /** \} */
+            
+            /** \brief Pushes a block onto the free list of a level
+             *         and marks it as free in the bitmap tree.
+             * \param[in] block The address of the block
+             * \param[in] level The level of the block
+             */
+            void push_free_block( std::uintptr_t block, std::size_t level );
+            
+            /** \brief Removes a block from the free list of a level
+             *         and marks it as occupied in the bitmap tree.
+             * \param[in] block The address of the block
+             * \param[in] level The level of the block
+             * \note The block has to be on the free list of
+             *       \a level otherwise the behaviour is undefined.
+             */
+            void remove_free_block( std::uintptr_t block, std::size_t level );
+            
+            /** \brief Obtains a new top-level block from upstream,
+             *         sets up its metadata and puts the remaining
+             *         space onto the free lists.
+             * \returns \a false if the upstream resource
+             *          cannot provide a suitable block.
+             */
+            bool add_arena( void ) noexcept;
+        public:
+            /** \brief Constructs a \a headerless_buddy_resource object
+             * \param[in] min_bs The minimum block size.
+             * \param[in] max_bs The maximum block size, which is
+             *            also the alignment of the top-level blocks.
+             * \param[in] upstream_resource The upstream resource.
+             *
+             * \throws std::invalid_argument if the parameters
+             *         unsupported.
+             */
+            headerless_buddy_resource( std::size_t min_bs, std::size_t max_bs,
+                                      std::pmr::memory_resource *upstream_resource );
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            headerless_buddy_resource( const headerless_buddy_resource & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            headerless_buddy_resource( headerless_buddy_resource && ) = delete;
+            
+            virtual ~headerless_buddy_resource( void );
+            
+            /** \brief Adds the figures of this resource to
+             *         a snapshot.
+             * \param[inout] sum The snapshot
+             *
+             * Only the free blocks and the top-level blocks are
+             * reported, since this resource keeps no counters.
+             * The metadata blocks count as held but not free.
+             */
+            void accumulate_statistics( buddy_statistics &sum ) const;
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -21,6 +21,9 @@
 #include <boost/range/join.hpp>
 
 #include "memory_manager.hpp"
+#include "boot_profile.hpp"
+#include "scheduler.hpp"
+#include "io/ring_logger.hpp"
 
 using namespace UtopiaOS;
 
@@ -32,6 +35,26 @@ namespace
     /** \brief This is the default OS X stack size (more or less arbitrary) */
     static constexpr unsigned min_kernel_stack_size = (1 << 23);
     
+    /** \brief The number of kernel tasks every processor
+     *         can have spawned at a time
+     */
+    static constexpr std::size_t kernel_tasks_per_processor = 256;
+    
+    /** \brief The number of pages a single kernel task
+     *         scrubs or reclaims
+     */
+    static constexpr std::size_t pages_per_kernel_task = 64;
+    
+    /** \brief The number of bitmap chunks a single kernel
+     *         task sets up of the deferred memory
+     */
+    static constexpr std::size_t chunks_per_kernel_task = 16;
+    
+    /** \brief The number of records every processor can
+     *         append to the kernel log before it is drained
+     */
+    static constexpr std::size_t kernel_log_records_per_processor = 2 * max_boot_phases;
+    
     /** \brief Create a simple memory manager from the memory data.
      * \param[in] env The environment provided by the bootloader
      */
@@ -41,6 +64,15 @@ namespace
      * \param[in] mm The current memory manager whose memory should be used
      */
     [[noreturn]] void morph_into_scheduler_outsource_memory( memory_manager &&mm );
+    
+    /** \brief Run kernel tasks on the current processor forever.
+     * \param[in] mm The memory manager
+     * \param[in] kernel_tasks The scheduler of the kernel tasks
+     *
+     * Idle processors scrub the pages freed to the zeroed
+     * page resource.
+     */
+    [[noreturn]] void run_kernel_tasks( memory_manager &mm, scheduler &kernel_tasks );
 }
 
 [[noreturn]] void kernel::kernel_main( const environment *env )
@@ -58,7 +90,10 @@ namespace
      * - memory stuff (new, delete, default_resource, ...)
      */
     
-    auto memory_manager = setup_memory_manager( environment );
+    auto memory_manager = profile_boot_phase( "setup_memory_manager", [&] {
+        return setup_memory_manager( environment );
+    } );
+    
     morph_into_scheduler_outsource_memory( std::move( memory_manager ) );
 }
 
@@ -79,14 +114,9 @@ namespace
         auto &UEFI_memmap = env->memmap;
         
         /** \todo Perform some runtime size check */
-        
-        auto memmap_memory_requirement = kernel_memory_map::maximum_conversion_requirement( UEFI_memmap );
-        void *memmap_memory = UTOPIAOS_ALLOCA_WITH_ALIGN( memmap_memory_requirement.size,
-                                                         memmap_memory_requirement.alignment );
-        std::pmr::monotonic_buffer_resource memmap_memory_resource( memmap_memory,
-                                                                   memmap_memory_requirement.size );
-        
-        kernel_memory_map memmap( UEFI_memmap, &memmap_memory_resource );
+        /** \todo Pass the memory affinity structures of the ACPI SRAT
+         *        to the memory map once the environment provides them.
+         */
         
         auto environment_omd = env->occupied_memory();
         std::array<target::memory_region, 2> kernel_omd = { {
@@ -95,12 +125,81 @@ namespace
         } };
         
         auto omd_view = boost::join( environment_omd, kernel_omd );
-        std::sort( boost::begin( omd_view ), boost::end( omd_view ) );
+        profile_boot_phase( "omd sorting", [&] {
+            std::sort( boost::begin( omd_view ), boost::end( omd_view ) );
+        } );
+        
+        // Most firmware hands out a sorted memory map, which
+        // the memory manager can read without a copy.
+        if( memory_map_view::is_usable( UEFI_memmap ) )
+            return memory_manager( memory_map_view( UEFI_memmap ),
+                                  boost::begin( omd_view ),
+                                  boost::end( omd_view ) );
+        
+        auto memmap_memory_requirement = kernel_memory_map::maximum_conversion_requirement( UEFI_memmap );
+        void *memmap_memory = UTOPIAOS_ALLOCA_WITH_ALIGN( memmap_memory_requirement.size,
+                                                         memmap_memory_requirement.alignment );
+        std::pmr::monotonic_buffer_resource memmap_memory_resource( memmap_memory,
+                                                                   memmap_memory_requirement.size );
+        
+        auto memmap = profile_boot_phase( "memory map conversion", [&] {
+            return kernel_memory_map( UEFI_memmap, &memmap_memory_resource );
+        } );
         
         return memory_manager( memmap,
                               boost::begin( omd_view ),
                               boost::end( omd_view ) );
     }
+    
+    [[noreturn]] void morph_into_scheduler_outsource_memory( memory_manager &&mm )
+    {
+        // kernel_main never returns, so the memory manager, the
+        // kernel log and the scheduler live as long as the kernel.
+        auto log_requirement = io::ring_logger::requirement( kernel_log_records_per_processor );
+        io::ring_logger kernel_log( mm.synchronized_resource()->allocate( log_requirement.size,
+                                                                         log_requirement.alignment ),
+                                   kernel_log_records_per_processor,
+                                   io::overflow_policy::count_drops );
+        log_boot_profile( &kernel_log );
+        
+        scheduler kernel_tasks( mm.synchronized_resource(),
+                               scheduler::max_processors,
+                               kernel_tasks_per_processor );
+        
+        // The contents of the boot services and loader memory are not
+        // needed anymore, except for what the environment occupies.
+        // The ACPI tables still have to be parsed.
+        for( memory_type type : { memory_type::boot_services, memory_type::loader } )
+            kernel_tasks.spawn_repeatedly( [&mm, type] ( void ) {
+                return mm.reclaim( type, pages_per_kernel_task );
+            } );
+        
+        // One chain per processor, so that every processor that
+        // joins steals a share of the memory to set up.
+        for( std::size_t processor = 0; processor != scheduler::max_processors; ++processor )
+            kernel_tasks.spawn_repeatedly( [&mm] ( void ) {
+                return mm.initialize_deferred_memory( chunks_per_kernel_task );
+            } );
+        
+        /** \todo Start the application processors, which
+         *        call run_kernel_tasks() as well.
+         */
+        /** \todo Spawn a task that drains the kernel log
+         *        once there is a console to drain it to.
+         */
+        run_kernel_tasks( mm, kernel_tasks );
+    }
+    
+    [[noreturn]] void run_kernel_tasks( memory_manager &mm, scheduler &kernel_tasks )
+    {
+        kernel_tasks.run( [&mm] ( void ) {
+            if( mm.scrub_pages( pages_per_kernel_task ) == 0 )
+                UTOPIAOS_CPU_RELAX();
+        } );
+        
+        // Nothing ever stops the kernel tasks
+        utils::trap();
+    }
 }
 
 /** \} */
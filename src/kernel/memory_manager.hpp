@@ -10,11 +10,17 @@
 
 #include "memory_map.hpp"
 #include "distributed_resource.hpp"
+#include "page_frame_region.hpp"
+#include "numa_resource.hpp"
 #include "buddy_resource.hpp"
+#include "zeroed_page_pool.hpp"
+#include "boot_profile.hpp"
+#include "constants.hpp"
 
 #include "target/config.hpp"
 #include "utils/debug.hpp"
 #include "utils/destruct_deleter.hpp"
+#include "utils/spinlock.hpp"
 #include "utils/ranges.hpp"
 
 #ifdef UTOPIAOS_ALLOCA_WITH_ALIGN_HEADER
@@ -27,6 +33,8 @@
 #include <functional>
 #include <array>
 #include <iterator>
+#include <stdexcept>
+#include <atomic>
 
 #include <boost/hana.hpp>
 #include <boost/hana/ext/std/integer_sequence.hpp>
@@ -47,20 +55,27 @@ namespace UtopiaOS
              * \brief These type tags represent the different
              *        categories in which the memory manager
              *        divides the total memory it manages.
+             *        Their names label the boot profile.
              * \{
              */
-            class memmap_memory_tag {};
-            class omd_memory_tag {};
-            class avm_memory_tag {};
+            struct memmap_memory_tag { static constexpr const char *name = "memmap requirement"; };
+            struct omd_memory_tag { static constexpr const char *name = "omd requirement"; };
+            struct avr_memory_tag { static constexpr const char *name = "avr requirement"; };
+            struct avm_memory_tag { static constexpr const char *name = "avm requirement"; };
+            struct lpr_memory_tag { static constexpr const char *name = "lpr requirement"; };
+            struct lpm_memory_tag { static constexpr const char *name = "lpm requirement"; };
             /** \} */
-            
+
             /** \brief A tuple containing the <em> Memory Tags </em>
              * The mr_memory_tag has to be the last one (compile-time enforced).
              */
             static constexpr auto memory_tags = boost::hana::tuple_t<memmap_memory_tag,
                                                        omd_memory_tag,
-                                                       avm_memory_tag>;
-            
+                                                       avr_memory_tag,
+                                                       avm_memory_tag,
+                                                       lpr_memory_tag,
+                                                       lpm_memory_tag>;
+
             /** \brief A map specifying the order of the <em> Memory Tags </em>
              *         in the \a memory_tags tuple
              */
@@ -70,12 +85,12 @@ namespace UtopiaOS
                   boost::hana::to_tuple( std::make_index_sequence<boost::hana::length( memory_tags )>() )
                                       ),
                 boost::hana::make_map );
-            
+
             /** \brief The number of memory request that will be made upon construction
                        of the \a unsynchronized_memory_manager
              */
             static constexpr auto number_of_memory_requests = boost::hana::length( memory_tags ) + 1u;
-            
+
             /** \name Internal memory resources
              *  \brief The memory resource types used internally by the \a memory_manager
              *  \{
@@ -88,12 +103,12 @@ namespace UtopiaOS
             >;
             std::array<iresource_ptr, number_of_iresources> iresources;
             /** \} */
-            
+
             /** \brief The memory map */
             memory_map<
                 std::pmr::polymorphic_allocator<memory_descriptor>
             > memmap;
-            
+
             /** \brief The occupied memory description.
              * An array specifying which memory regions are occupied.
              * Occupied regions are specified upon construction of
@@ -105,28 +120,160 @@ namespace UtopiaOS
                 target::memory_region,
                 std::pmr::polymorphic_allocator<target::memory_region>
             > omd;
-            
+
+            /** \brief The available memory regions.
+             * An array of the memory regions that are described
+             * by the memory map, considered usable and not
+             * occupied in the sense described by the \a omd.
+             */
+            utils::dynarray<
+                target::memory_region,
+                std::pmr::polymorphic_allocator<target::memory_region>
+            > available_regions;
+
             /** \brief The available memory.
-             * An array of allocators that can be used to manage
+             * An array of page frame allocators that manage
              * the available memory. Available memory is memory
              * described by the memory map that is considered
              * usable (See \a enumerate_available_memory) and
              * that is not occupied in the sense described by
-             * the \a omd.
+             * the \a omd. The n-th allocator manages the n-th
+             * region of \a available_regions.
              */
             utils::dynarray<
-                std::pmr::monotonic_buffer_resource,
-                std::pmr::polymorphic_allocator<std::pmr::monotonic_buffer_resource>
+                page_frame_region,
+                std::pmr::polymorphic_allocator<page_frame_region>
             > available_memory;
-            
+
+            /** \brief The large-page memory regions.
+             * An array of the large-page aligned memory regions
+             * that were split off the available memory regions
+             * by \a split_large_pages.
+             */
+            utils::dynarray<
+                target::memory_region,
+                std::pmr::polymorphic_allocator<target::memory_region>
+            > large_page_regions;
+
+            /** \brief The large-page memory.
+             * An array of page frame allocators with pages of
+             * size \a large_pagesize. The n-th allocator manages
+             * the n-th region of \a large_page_regions.
+             */
+            utils::dynarray<
+                page_frame_region,
+                std::pmr::polymorphic_allocator<page_frame_region>
+            > large_page_memory;
+
             /** \brief A memory resource that can be used to
-             *         allocate memory managed by the memory manager.
+             *         allocate pages managed by the memory manager.
              */
             std::unique_ptr<
                 distributed_resource,
                 utils::destruct_deleter<distributed_resource>
             > avm_resource;
-            
+
+            /** \brief A memory resource that can be used to allocate
+             *         large pages managed by the memory manager or
+             *         \a nullptr if there is no large-page memory.
+             */
+            std::unique_ptr<
+                distributed_resource,
+                utils::destruct_deleter<distributed_resource>
+            > lpm_resource;
+
+            /** \brief A monotonic memory resource on top of
+             *         \a avm_resource for small allocations.
+             */
+            std::unique_ptr<
+                std::pmr::monotonic_buffer_resource,
+                utils::destruct_deleter<std::pmr::monotonic_buffer_resource>
+            > monotonic_avm_resource;
+
+            /** \brief A thread-safe memory resource with one
+             *         allocator hierarchy per proximity domain.
+             */
+            std::unique_ptr<
+                numa_resource,
+                utils::destruct_deleter<numa_resource>
+            > numa_avm_resource;
+
+            /** \brief A thread-safe memory resource on top of
+             *         \a numa_avm_resource for zeroed pages.
+             */
+            std::unique_ptr<
+                zeroed_page_pool,
+                utils::destruct_deleter<zeroed_page_pool>
+            > zeroed_resource;
+
+            /** \struct deferred_progress
+             * \brief The progress of setting up the available
+             *        memory that was deferred upon construction.
+             */
+            struct deferred_progress
+            {
+                /** \brief No region below this index has chunks left */
+                std::atomic<std::size_t> next_region;
+
+                /** \brief The deferred regions that are not published yet */
+                std::atomic<std::size_t> pending_regions;
+            };
+
+            /** \brief Shared by all processors, which keeps the
+             *         memory manager movable.
+             */
+            std::unique_ptr<
+                deferred_progress,
+                utils::destruct_deleter<deferred_progress>
+            > deferred;
+
+            /** \struct reclaim_progress
+             * \brief The progress of reclaiming the memory
+             *        of every memory type.
+             */
+            struct reclaim_progress
+            {
+                /** \brief No region below this index has reserved
+                 *         pages of the memory type it is indexed by.
+                 */
+                std::array<
+                    std::atomic<std::size_t>,
+                    static_cast<std::size_t>( memory_type::invalid )
+                > next_region;
+            };
+
+            /** \brief Shared by all processors, which keeps the
+             *         memory manager movable.
+             */
+            std::unique_ptr<
+                reclaim_progress,
+                utils::destruct_deleter<reclaim_progress>
+            > reclaiming;
+
+            /** \brief Serializes the processors that replenish
+             *         \a avm_resource concurrently.
+             */
+            std::unique_ptr<
+                utils::spinlock,
+                utils::destruct_deleter<utils::spinlock>
+            > page_resource_lock;
+
+            /** \brief Lets the page resources find the pages an
+             *         available region gained, which they would
+             *         otherwise not consult again once it failed.
+             * \param[in] index The index of the region
+             * \param[in] pages The page resource of the proximity
+             *            domain of the region, whose lock is held.
+             */
+            void replenish( std::size_t index, distributed_resource &pages )
+            {
+                void *p = target::uintptr_to_ptr<void>( available_regions[index].base() );
+                pages.replenish( p );
+
+                utils::spinlock_guard guard( page_resource_lock.get() );
+                avm_resource->replenish( p );
+            }
+
             /** \class memory_requirement
              * \brief A Function object returning the memory
              *        requirement specified by a given
@@ -151,11 +298,11 @@ namespace UtopiaOS
                                    RandomAccessIterator ob,
                                    RandomAccessIterator oe )
                 : memmap( mm ), omd_begin( ob ), omd_end( oe ) {}
-                
+
                 /** \brief Overload for \a memmap_memory_tag */
                 auto operator()( boost::hana::basic_type<memmap_memory_tag> )
                 { return memmap.maximum_copy_requirement(); }
-                
+
                 /** \brief Overload for \a omd_memory_tag */
                 target::memory_request<
                     alignof(std::allocator_traits<
@@ -166,28 +313,101 @@ namespace UtopiaOS
                     std::size_t number_of_new_omds = number_of_memory_requests;
                     auto min_omds = omd_end - omd_begin;
                     auto max_omds = min_omds + number_of_new_omds;
-                    
+
                     return {sizeof(typename decltype(omd)::value_type) * max_omds};
                 }
-                
-                /** \brief Overload for \a avm_memory_tag */
+
+                /** \brief Overload for \a avr_memory_tag */
+                target::memory_request<
+                    alignof(std::allocator_traits<
+                                typename decltype(available_regions)::allocator_type
+                            >::value_type)
+                > operator()( boost::hana::basic_type<avr_memory_tag> )
+                {
+                    // Every new request splits at most one region and
+                    // every region yields at most two available regions.
+                    auto max_new_avm_regions = 2 * number_of_memory_requests;
+                    auto min_avm_regions = number_of_avm_regions( memmap,
+                                                                 omd_begin,
+                                                                 omd_end );
+                    auto max_regions = max_new_avm_regions + min_avm_regions;
+
+                    return { max_regions *
+                        sizeof(typename decltype(available_regions)::value_type) };
+                }
+
+                /** \brief Overload for \a avm_memory_tag
+                 *
+                 * The bitmaps of the allocators of reclaimable
+                 * memory are stored alongside of them.
+                 */
                 target::memory_request<
                     alignof(std::allocator_traits<
                                 typename decltype(available_memory)::allocator_type
                             >::value_type)
                 > operator()( boost::hana::basic_type<avm_memory_tag> )
                 {
-                    auto max_new_avm_regions = number_of_memory_requests;
+                    static_assert( alignof(page_frame_region) >= alignof(std::size_t) &&
+                                  sizeof(page_frame_region) % alignof(std::size_t) == 0,
+                                  "The bitmaps cannot be packed with the allocators." );
+
+                    auto max_new_avm_regions = 2 * number_of_memory_requests;
                     auto min_avm_regions = number_of_avm_regions( memmap,
                                                                  omd_begin,
                                                                  omd_end );
                     auto max_regions = max_new_avm_regions + min_avm_regions;
-                    
+
+                    // The requests are only met from general purpose
+                    // memory, so they do not change these bitmaps.
+                    auto words = number_of_reclaim_bitmap_words( memmap,
+                                                                omd_begin,
+                                                                omd_end );
+
                     return { max_regions *
-                        sizeof(typename decltype(available_memory)::value_type) };
+                        sizeof(typename decltype(available_memory)::value_type) +
+                        words * sizeof(std::size_t) };
+                }
+
+                /** \brief Overload for \a lpr_memory_tag */
+                target::memory_request<
+                    alignof(std::allocator_traits<
+                                typename decltype(large_page_regions)::allocator_type
+                            >::value_type)
+                > operator()( boost::hana::basic_type<lpr_memory_tag> )
+                {
+                    auto max_regions = number_of_memory_requests +
+                        number_of_lpm_regions( memmap, omd_begin, omd_end );
+
+                    return { max_regions *
+                        sizeof(typename decltype(large_page_regions)::value_type) };
+                }
+
+                /** \brief Overload for \a lpm_memory_tag
+                 *
+                 * The bitmaps of the allocators are
+                 * stored alongside of them.
+                 */
+                target::memory_request<
+                    alignof(std::allocator_traits<
+                                typename decltype(large_page_memory)::allocator_type
+                            >::value_type)
+                > operator()( boost::hana::basic_type<lpm_memory_tag> )
+                {
+                    static_assert( alignof(page_frame_region) >= alignof(std::size_t) &&
+                                  sizeof(page_frame_region) % alignof(std::size_t) == 0,
+                                  "The bitmaps cannot be packed with the allocators." );
+
+                    // Every additional region needs at most one more word.
+                    auto max_regions = number_of_memory_requests +
+                        number_of_lpm_regions( memmap, omd_begin, omd_end );
+                    auto max_words = number_of_memory_requests +
+                        number_of_lpm_bitmap_words( memmap, omd_begin, omd_end );
+
+                    return { max_regions * sizeof(page_frame_region) +
+                        max_words * sizeof(std::size_t) };
                 }
             };
-            
+
             /** \brief Helper function that constructs a
              *         memory_requirement object.
              * \tparam MemMap The memory map type (usually inferred)
@@ -204,7 +424,7 @@ namespace UtopiaOS
             { return memory_requirement<MemMap, RandomAccessIterator>( memmap,
                                                                       omd_begin,
                                                                       omd_end ); }
-            
+
             /** \brief Builds the memory manager step by step.
              * \tparam MemMap A kernel-usable memory map type
              * \tparam RandomAccessIterator An iterator type
@@ -225,152 +445,168 @@ namespace UtopiaOS
             {
                 utils::debug_assert( std::is_sorted( omd_begin, omd_end ),
                              "The omd has to be sorted!" );
-                
+
                 namespace hana = boost::hana;
-                
+
+                boot_phase phase( "build_memory_manager" );
+
                 auto omd_view = boost::make_iterator_range( omd_begin, omd_end );
-                
+
                 // Sanity check: Is all occupied memory contained in the memory map?
-                std::for_each( boost::begin( omd_view ),
-                              boost::end( omd_view ),
-                              [&memmap] ( const target::memory_region &region ) {
-                    auto it = std::find_if( memmap.cbegin(), memmap.cend(),
-                                std::bind( std::mem_fn( &memory_descriptor::contains_memory_region ),
-                                                        std::placeholders::_1, region ) );
-                                  
-                    if( it == memmap.cend() )
-                        throw std::invalid_argument( "Occupied memory not contained in memory map" );
+                // Both ranges are sorted, so a single sweep suffices.
+                profile_boot_phase( "omd check", [&] {
+                    auto desc_it = memmap.cbegin();
+                    std::for_each( boost::begin( omd_view ),
+                                  boost::end( omd_view ),
+                                  [&] ( const target::memory_region &region ) {
+                        while( desc_it != memmap.cend() &&
+                              desc_it->virtual_start + desc_it->number_of_pages * pagesize <= region.base() )
+                            ++desc_it;
+
+                        if( desc_it == memmap.cend() || desc_it->contains_memory_region( region ) == false )
+                            throw std::invalid_argument( "Occupied memory not contained in memory map" );
+                    } );
                 } );
-                
+
                 // Get the memory requirement for every memory tag
-                auto memory_requests = hana::transform( memory_tags,
-                                            get_memory_requirement( memmap,
-                                                                   boost::begin( omd_view ),
-                                                                   boost::end( omd_view ) ) );
-                
-                // Allocate space for storing the memory regions that
-                // are used to meet the above requests.
-                auto internal_omds = hana::replicate<hana::tuple_tag>( target::memory_region(),
-                                                                     hana::length( memory_tags ) );
-                
-                // Allocate the space requested in the \a memory_requests
-                // above and calculate the new omd, that marks these
-                // allocated regions as occupied.
-                auto omd_stage2 = hana::fold_left( memory_tags,
-                                               omd_view,
-                    [&] ( const auto &omd, auto tag ) {
-                        const auto &request = memory_requests[tag_index[tag]];
-                        
-                        internal_omds[tag_index[tag]] = meet_request( memmap,
-                                                                     boost::begin( omd ),
-                                                                     boost::end( omd ),
-                                                                     request );
-                        return utils::sorted_range_insert_reference( omd,
-                                                             internal_omds[tag_index[tag]] );
-                    }
-                );
-                
+                auto requirement = get_memory_requirement( memmap,
+                                                          boost::begin( omd_view ),
+                                                          boost::end( omd_view ) );
+                auto memory_requests = profile_boot_phase( "memory requirements", [&] {
+                    return hana::transform( memory_tags, [&] ( auto tag ) {
+                        return profile_boot_phase( decltype(tag)::type::name,
+                                                  [&] { return requirement( tag ); } );
+                    } );
+                } );
+
                 // We also need to store the internal resource objects
                 // somewhere.
                 target::memory_request<
                     alignof(std::pmr::monotonic_buffer_resource)
                 > iresource_request = { hana::length( memory_tags ) *
                               sizeof(std::pmr::monotonic_buffer_resource) };
-                auto iresource_omd = meet_request( memmap,
-                                                  boost::begin( omd_stage2 ),
-                                                  boost::end( omd_stage2 ),
-                                                  iresource_request );
-                auto omd_final = utils::sorted_range_insert_reference( omd_stage2,
-                                                             iresource_omd );
-                
+
+                // Allocate the space for all of the above requests
+                // in a single sweep over the memory map.
+                auto internal_omds = profile_boot_phase( "meet_requests", [&] {
+                    return meet_requests( memmap,
+                                         boost::begin( omd_view ),
+                                         boost::end( omd_view ),
+                                         hana::append( memory_requests,
+                                                      iresource_request ) );
+                } );
+                const auto &iresource_omd = internal_omds.back();
+
+                // Calculate the new omd, that marks these
+                // allocated regions as occupied.
+                auto sorted_internal_omds = internal_omds;
+                std::sort( sorted_internal_omds.begin(), sorted_internal_omds.end() );
+
+                /** \todo Perform some runtime size check." */
+
+                auto omd_size = static_cast<std::size_t>( std::distance( omd_begin, omd_end ) );
+                auto omd_final = reinterpret_cast<target::memory_region *>(
+                         UTOPIAOS_ALLOCA_WITH_ALIGN( (omd_size + sorted_internal_omds.size()) *
+                                                    sizeof(target::memory_region),
+                                                    alignof(target::memory_region) ) );
+                auto omd_final_end = std::merge( omd_begin, omd_end,
+                                                sorted_internal_omds.cbegin(),
+                                                sorted_internal_omds.cend(),
+                                                omd_final );
+
                 // An array of iresource_ptrs to the internal resource
                 // objects.
                 std::array<iresource_ptr, hana::length( memory_tags )> iresources;
-                
+
                 // Put the internal memory resource objects into place
                 hana::for_each( memory_tags, [&] ( auto tag ) {
                     const auto &region = internal_omds[tag_index[tag]];
                     auto base = target::uintptr_to_ptr<
                         std::pmr::monotonic_buffer_resource
                     >( iresource_omd.base() );
-                    
+
                     iresources[tag_index[tag]] =
                         iresource_ptr( new (base + tag_index[tag]) 
                              iresource( region.base_ptr(), region.size ) );
                 } );
-                
+
                 return memory_manager( memmap,
-                                      boost::begin( omd_final ),
-                                      boost::end( omd_final ),
+                                      omd_final,
+                                      omd_final_end,
                                       std::move( iresources ) );
             }
-            
-            /** \brief Try to fulfil a memory request
+
+            /** \brief Try to fulfil several memory requests
              * \tparam MemMap The memory map type
              * \tparam InputIterator The omd iterator type
-             * \tparam MemRequest The memory request type
+             * \tparam MemRequests A boost::hana tuple type of
+             *         memory request types
              * \param[in] memmap The memory map
              * \param[in] omd_begin The begin of the omd
              * \param[in] omd_end The end of the omd
-             * \param[in] request The memory request to fulfil
+             * \param[in] requests The memory requests to fulfil
+             *
+             * The available memory regions are visited in a single
+             * sweep in ascending order. Every region is filled with
+             * the pending requests in their given order, each at the
+             * lowest suitable address behind the previous one.
              *
              * \note The omd range has to be sorted.
-             * \note Throws a \ std::runtime_error if the request
+             * \note Throws a \ std::runtime_error if a request
              * could not be fulfilled.
              *
-             * \returns A memory region that fulfils the request,
-             *          where \a base() always has the 
-             *          requested alignment.
+             * \returns An array of disjoint memory regions, the n-th
+             *          of which fulfils the n-th request, where
+             *          \a base() always has the requested alignment.
              */
-            template<class MemMap, class InputIterator, class MemRequest>
-            static target::memory_region meet_request( const MemMap &memmap,
-                                                      InputIterator omd_begin,
-                                                      InputIterator omd_end,
-                                                      const MemRequest &request )
+            template<class MemMap, class InputIterator, class MemRequests>
+            static std::array<
+                target::memory_region,
+                decltype(boost::hana::length( std::declval<MemRequests>() ))::value
+            > meet_requests( const MemMap &memmap,
+                            InputIterator omd_begin,
+                            InputIterator omd_end,
+                            const MemRequests &requests )
             {
-                utils::debug_assert( std::is_sorted( omd_begin, omd_end ),
-                                    "The omd has to be sorted!" );
-                
-                for( auto desc_it = memmap.cbegin(); desc_it != memmap.cend(); ++desc_it )
-                {
-                    const auto &desc = *desc_it;
-                    
-                    bool success = true;
-                    
-                    // Try the lowest possible region within the memory descriptor first
-                    auto aligned_address = target::align<MemRequest::alignment>( desc.virtual_start );
-                    target::memory_region attempt{ aligned_address, aligned_address + request.size };
-                    
-                    if( desc.contains_memory_region( attempt ) == false )
-                        continue;
-                    
-                    // Successively try higher regions if the attempted region
-                    // and an occupied region intersect.
-                    auto intersection = omd_begin;
-                    while( (intersection = std::find_if( intersection, omd_end,
-                                   std::bind( &target::memory_region::intersects_memory_region,
-                                   attempt,
-                                   std::placeholders::_1 ) )) != omd_end )
-                    {
-                        aligned_address = target::align<MemRequest::alignment>( intersection->top() );
-                        attempt = { aligned_address, aligned_address + request.size };
-                        
-                        if( desc.contains_memory_region( attempt ) == false )
-                        {
-                            success = false;
-                            break;
-                        }
-                        
-                        ++intersection;
-                    }
-                    
-                    if( success )
-                        return attempt;
-                }
-                
-                throw std::runtime_error( "Cannot meet memory request" );
+                namespace hana = boost::hana;
+
+                using num_requests = decltype(hana::length( requests ));
+                constexpr auto indices = hana::make_range( hana::size_c<0>,
+                                                          num_requests{} );
+
+                std::array<target::memory_region, num_requests::value> result;
+                std::array<bool, num_requests::value> met;
+                met.fill( false );
+
+                auto fill_region = [&] ( const target::memory_region &region ) {
+                    std::uintptr_t current = region.base();
+
+                    hana::for_each( indices, [&] ( auto index ) {
+                        const auto &request = requests[index];
+                        using request_type = std::decay_t<decltype(request)>;
+
+                        if( met[index] )
+                            return;
+
+                        auto aligned_address = target::align<request_type::alignment>( current );
+                        if( aligned_address < current || aligned_address > region.top() ||
+                           region.top() - aligned_address < request.size )
+                            return;
+
+                        result[index] = { aligned_address, request.size };
+                        met[index] = true;
+                        current = aligned_address + request.size;
+                    } );
+                };
+
+                transform_avm( memmap, omd_begin, omd_end, fill_region );
+
+                if( std::find( met.cbegin(), met.cend(), false ) != met.cend() )
+                    throw std::runtime_error( "Cannot meet memory request" );
+
+                return result;
             }
-            
+
             /** \brief Calculate the available memory regions
              *         and apply a function to them.
              * \tparam MemMap The memory map type
@@ -382,6 +618,8 @@ namespace UtopiaOS
              * \param[in] function The function to be applied
              *            to every available memory region.
              *
+             * Only general purpose memory is available.
+             *
              * \note The omd range has to be sorted in ascending
              *       order.
              */
@@ -390,52 +628,149 @@ namespace UtopiaOS
                                       InputIterator omd_begin,
                                       InputIterator omd_end,
                                       UnaryFunction function )
+            {
+                transform_memory( memmap, omd_begin, omd_end,
+                                 [] ( memory_type type ) {
+                                     return (type == memory_type::general_purpose);
+                                 },
+                                 [&function] ( const target::memory_region &region,
+                                              memory_type ) {
+                                     function( region );
+                                 } );
+            }
+
+            /** \brief Calculate the available memory regions and
+             *         the reclaimable memory regions and apply the
+             *         corresponding functions to them.
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \tparam SmallFunction The function object type for
+             *         the small-page regions
+             * \tparam LargeFunction The function object type for
+             *         the large-page regions
+             * \tparam ReclaimableFunction The function object type
+             *         for the reclaimable regions
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             * \param[in] small The function to apply to the
+             *            available small-page regions.
+             * \param[in] large The function to apply to the
+             *            available large-page regions.
+             * \param[in] reclaimable The function to apply to the
+             *            reclaimable regions that are not occupied.
+             *
+             * The available memory regions are split by
+             * \a split_large_pages. Reclaimable memory is
+             * only ever used for small pages.
+             *
+             * \note The omd range has to be sorted in ascending
+             *       order.
+             */
+            template<class MemMap, class InputIterator, class SmallFunction,
+                     class LargeFunction, class ReclaimableFunction>
+            static void transform_managed( const MemMap &memmap,
+                                          InputIterator omd_begin,
+                                          InputIterator omd_end,
+                                          SmallFunction small,
+                                          LargeFunction large,
+                                          ReclaimableFunction reclaimable )
+            {
+                transform_memory( memmap, omd_begin, omd_end,
+                                 [] ( memory_type type ) {
+                                     return (type == memory_type::general_purpose ||
+                                             is_reclaimable( type ));
+                                 },
+                                 [&] ( const target::memory_region &region,
+                                      memory_type type ) {
+                                     if( type == memory_type::general_purpose )
+                                         split_large_pages( region, small, large );
+                                     else
+                                         reclaimable( region );
+                                 } );
+            }
+
+            /** \brief Calculate the unoccupied memory regions of
+             *         some memory types and apply a function to them.
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \tparam TypePredicate The predicate type
+             * \tparam BinaryFunction The function object
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             * \param[in] predicate A predicate that selects the
+             *            memory types to consider.
+             * \param[in] function The function to be applied to
+             *            every unoccupied memory region of a selected
+             *            type and the type of the region.
+             *
+             * \note The omd range has to be sorted in ascending
+             *       order.
+             */
+            template<class MemMap, class InputIterator,
+                     class TypePredicate, class BinaryFunction>
+            static void transform_memory( const MemMap &memmap,
+                                         InputIterator omd_begin,
+                                         InputIterator omd_end,
+                                         TypePredicate predicate,
+                                         BinaryFunction function )
             {
                 utils::debug_assert( std::is_sorted( omd_begin, omd_end ),
                                     "The omd has to be sorted!" );
-                
+
+                // Both ranges are sorted, so the occupied regions
+                // below the current descriptor are never visited again.
+                auto first_candidate = omd_begin;
+
                 for( auto desc_it = memmap.cbegin(); desc_it != memmap.cend(); ++desc_it )
                 {
                     const auto &desc = *desc_it;
-                    if( desc.type != memory_type::general_purpose )
+                    if( predicate( desc.type ) == false )
                         continue;
-                    
+
                     target::memory_region desc_region = { desc.virtual_start,
                         desc.number_of_pages * pagesize };
                     auto rest = desc_region;
-                    
-                    auto intersection = omd_begin;
-                    while( (intersection = std::find_if( intersection, omd_end,
-                                    std::bind( &target::memory_region::intersects_memory_region,
-                                              rest,
-                                              std::placeholders::_1 ) )) != omd_end )
+
+                    while( first_candidate != omd_end &&
+                          first_candidate->top() <= desc_region.base() )
+                        ++first_candidate;
+
+                    for( auto intersection = first_candidate;
+                        intersection != omd_end && intersection->base() < desc_region.top();
+                        ++intersection )
                     {
-                        if( rest.base() != intersection->base() )
+                        // Occupied regions may overlap each other.
+                        if( rest.intersects_memory_region( *intersection ) == false )
+                            continue;
+
+                        if( rest.base() < intersection->base() )
                         {
                             target::memory_region av_region = { rest.base(),
                                 intersection->base() - rest.base() };
-                            function( av_region );
+                            function( av_region, desc.type );
                         }
-                        
-                        if( intersection->top() > rest.top() )
+
+                        if( intersection->top() >= rest.top() )
                         {
                             rest = { rest.top(), 0 };
                             break;
                         }
-                        
+
                         rest.size -= intersection->top() - rest.base();
                         rest.start = intersection->top();
                     }
-                    
+
                     if( rest.base() != desc_region.top() )
                     {
                         target::memory_region av_region = { rest.base(),
                             desc_region.top() - rest.base() };
-                        function( av_region );
+                        function( av_region, desc.type );
                     }
                 }
             }
-            
+
             /** \brief Calculate the number of memory regions
              * \tparam MemMap The memory map type
              * \tparam InputIterator The omd iterator type
@@ -443,7 +778,8 @@ namespace UtopiaOS
              * \param[in] omd_begin The begin of the omd
              * \param[in] omd_end The end of the omd
              *
-             * \returns The number of non-zero memory regions.
+             * \returns The number of non-zero memory regions,
+             *          including the reclaimable ones.
              *
              * \note The omd range has to be sorted in ascending
              *       order and be completely contained within
@@ -460,80 +796,480 @@ namespace UtopiaOS
                 auto count = [&] ( const auto & ) {
                     number_of_regions++;
                 };
-                
-                transform_avm( memmap, omd_begin, omd_end, count );
+                auto ignore = [] ( const auto & ) {};
+
+                transform_managed( memmap, omd_begin, omd_end,
+                                  count, ignore, count );
                 return number_of_regions;
             }
-            
-            /** \brief Calculate the number of memory regions
+
+            /** \brief Calculate the size of the bitmaps of
+             *         the reclaimable memory regions.
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             *
+             * \returns The total number of words of the bitmaps.
+             *
+             * \note The same requirements as for
+             *       \a number_of_avm_regions apply.
+             */
+            template<class MemMap, class InputIterator>
+            static std::size_t
+            number_of_reclaim_bitmap_words( const MemMap &memmap,
+                                           InputIterator omd_begin,
+                                           InputIterator omd_end )
+            {
+                std::size_t number_of_words = 0;
+                auto count = [&] ( const target::memory_region &region ) {
+                    number_of_words += page_frame_region::bitmap_words( region,
+                                                                       pagesize );
+                };
+
+                transform_memory( memmap, omd_begin, omd_end,
+                                 [] ( memory_type type ) {
+                                     return is_reclaimable( type );
+                                 },
+                                 [&count] ( const target::memory_region &region,
+                                           memory_type ) {
+                                     count( region );
+                                 } );
+                return number_of_words;
+            }
+
+            /** \brief Splits the large-page memory off an
+             *         available memory region.
+             * \tparam SmallFunction The function object type for
+             *         the remaining regions
+             * \tparam LargeFunction The function object type for
+             *         the large-page region
+             * \param[in] region The available memory region
+             * \param[in] small The function to apply to the parts
+             *            of \a region that are kept for the small
+             *            pages.
+             * \param[in] large The function to apply to the part
+             *            of \a region that is reserved for the
+             *            large pages.
+             *
+             * The top \a large_page_reservation percent of the
+             * large-page aligned part of \a region are reserved
+             * for the large pages, if they make up at least
+             * \a min_large_page_reservation large pages. The
+             * reservation starts at a multiple of \a huge_pagesize
+             * if it still holds a whole huge page that way. The
+             * parts below and above remain small-page memory.
+             */
+            template<class SmallFunction, class LargeFunction>
+            static void split_large_pages( const target::memory_region &region,
+                                          SmallFunction small, LargeFunction large )
+            {
+                auto start = target::align<large_pagesize>( region.base() );
+                auto end = region.top() - (region.top() % large_pagesize);
+
+                auto num_reserved = (start < region.base() || end <= start ? 0 :
+                                     (end - start) / large_pagesize *
+                                     large_page_reservation / 100);
+
+                if( num_reserved < min_large_page_reservation )
+                {
+                    small( region );
+                    return;
+                }
+
+                auto split = end - num_reserved * large_pagesize;
+                auto huge_split = target::align<huge_pagesize>( split );
+                if( huge_split >= split && huge_split < end &&
+                   end - huge_split >= huge_pagesize )
+                    split = huge_split;
+
+                small( target::memory_region{ region.base(), split - region.base() } );
+                large( target::memory_region{ split, end - split } );
+                if( end != region.top() )
+                    small( target::memory_region{ end, region.top() - end } );
+            }
+
+            /** \brief Calculate the number of large-page memory regions
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             *
+             * \returns The number of large-page memory regions.
+             *
+             * \note The same requirements as for
+             *       \a number_of_avm_regions apply.
+             */
+            template<class MemMap, class InputIterator>
+            static std::size_t
+            number_of_lpm_regions( const MemMap &memmap,
+                                  InputIterator omd_begin,
+                                  InputIterator omd_end )
+            {
+                std::size_t number_of_regions = 0;
+                auto count = [&] ( const auto & ) {
+                    number_of_regions++;
+                };
+                auto ignore = [] ( const auto & ) {};
+
+                transform_avm( memmap, omd_begin, omd_end,
+                              [&] ( const auto &region ) {
+                                  split_large_pages( region, ignore, count );
+                              } );
+                return number_of_regions;
+            }
+
+            /** \brief Calculate the size of the bitmaps of
+             *         the large-page memory regions.
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             *
+             * \returns The total number of words of the bitmaps.
+             *
+             * \note The same requirements as for
+             *       \a number_of_avm_regions apply.
+             */
+            template<class MemMap, class InputIterator>
+            static std::size_t
+            number_of_lpm_bitmap_words( const MemMap &memmap,
+                                       InputIterator omd_begin,
+                                       InputIterator omd_end )
+            {
+                std::size_t number_of_words = 0;
+                auto count = [&] ( const target::memory_region &region ) {
+                    number_of_words += page_frame_region::bitmap_words( region,
+                                                                       large_pagesize );
+                };
+                auto ignore = [] ( const auto & ) {};
+
+                transform_avm( memmap, omd_begin, omd_end,
+                              [&] ( const auto &region ) {
+                                  split_large_pages( region, ignore, count );
+                              } );
+                return number_of_words;
+            }
+
+            /** \brief Calculate the available memory regions
              * \tparam MemMap The memory map type
              * \tparam InputIterator The omd iterator type
              * \param[in] memmap The memory map
              * \param[in] omd_begin The begin of the omd
              * \param[in] omd_end The end of the omd
-             * \param[in] max_av_regions The maximum
-             *            number of available memory regions.
              * \param[in] alloc The allocator to be used for the
              *            construction of the return value.
              *
-             * \returns An array of \a std::memory_resource
-             *          objects that cover the available memory
+             * \returns An array of the available and the reclaimable
+             *          memory regions sorted by their proximity domain
+             *          and in ascending order within every domain.
              *
              * \note \a alloc has to be able to allocate
-             *       at least \a max_number_of_av_regions
-             *       memory_resource objects otherwise
+             *       at least \a number_of_avm_regions()
+             *       memory_region objects otherwise
              *       the behaviour is undefined.
-             * \note If max_av_regions is less than
-             *       \a number_of_avm_regions() the behaviour
-             *       is undefined.
              * \note The omd range has to be sorted in ascending
              *       order and be completely contained within
              *       the memory map otherwise the behaviour is
              *       undefined.
              */
             template<class MemMap, class InputIterator>
-            static decltype(available_memory)
-            enumerate_avm( const MemMap &memmap,
+            static decltype(available_regions)
+            enumerate_avr( const MemMap &memmap,
                           InputIterator omd_begin,
                           InputIterator omd_end,
-                          decltype(available_memory)::allocator_type &&alloc )
+                          decltype(available_regions)::allocator_type &&alloc )
             {
                 /** \todo Perform some runtime size check." */
-                
+
                 auto num_av_regions = number_of_avm_regions( memmap, omd_begin, omd_end );
-                
-                auto av_regions = reinterpret_cast<target::memory_region *>(
-                         UTOPIAOS_ALLOCA_WITH_ALIGN( num_av_regions * sizeof(target::memory_region),
+
+                // The domain of every region is looked up once,
+                // rather than in every comparison of the sort.
+                struct keyed_region
+                {
+                    std::uint32_t domain;
+                    target::memory_region region;
+                };
+
+                struct region_of
+                {
+                    const target::memory_region &operator()( const keyed_region &r ) const
+                    { return r.region; }
+                };
+
+                auto av_regions = reinterpret_cast<keyed_region *>(
+                         UTOPIAOS_ALLOCA_WITH_ALIGN( num_av_regions * sizeof(keyed_region),
+                                                    alignof(keyed_region) ) );
+                keyed_region *current = av_regions;
+
+                auto assign = [&current, domain = domain_of<MemMap>{ &memmap }] ( const auto &region ) {
+                    *current++ = { domain( region ), region };
+                };
+                auto ignore = [] ( const auto & ) {};
+
+                transform_managed( memmap, omd_begin, omd_end,
+                                  assign, ignore, assign );
+
+                // Group the regions by their proximity domains, so
+                // that every domain gets a contiguous range of them.
+                auto by_domain = [] ( const keyed_region &r1, const keyed_region &r2 ) {
+                    return (r1.domain < r2.domain);
+                };
+                if( std::is_sorted( av_regions, current, by_domain ) == false )
+                    std::stable_sort( av_regions, current, by_domain );
+
+                return decltype(available_regions)(
+                         boost::make_transform_iterator( av_regions, region_of() ),
+                         boost::make_transform_iterator( current, region_of() ),
+                         std::move( alloc ) );
+            }
+
+            /** \brief Calculate the large-page memory regions
+             * \tparam MemMap The memory map type
+             * \tparam InputIterator The omd iterator type
+             * \param[in] memmap The memory map
+             * \param[in] omd_begin The begin of the omd
+             * \param[in] omd_end The end of the omd
+             * \param[in] alloc The allocator to be used for the
+             *            construction of the return value.
+             *
+             * \returns An array of the memory regions that
+             *          \a split_large_pages reserves for the
+             *          large pages, in ascending order.
+             *
+             * \note \a alloc has to be able to allocate
+             *       at least \a number_of_lpm_regions()
+             *       memory_region objects otherwise
+             *       the behaviour is undefined.
+             * \note The same requirements as for
+             *       \a enumerate_avr apply.
+             */
+            template<class MemMap, class InputIterator>
+            static decltype(large_page_regions)
+            enumerate_lpr( const MemMap &memmap,
+                          InputIterator omd_begin,
+                          InputIterator omd_end,
+                          decltype(large_page_regions)::allocator_type &&alloc )
+            {
+                auto num_lp_regions = number_of_lpm_regions( memmap, omd_begin, omd_end );
+
+                auto lp_regions = reinterpret_cast<target::memory_region *>(
+                         UTOPIAOS_ALLOCA_WITH_ALIGN( num_lp_regions * sizeof(target::memory_region),
                                                     alignof(target::memory_region) ) );
-                target::memory_region *current = av_regions;
-                
+                target::memory_region *current = lp_regions;
+
                 auto assign = [&current] ( const auto &region ) {
                     *current++ = region;
                 };
-                
-                transform_avm( memmap, omd_begin, omd_end, assign );
-                
+                auto ignore = [] ( const auto & ) {};
+
+                transform_avm( memmap, omd_begin, omd_end,
+                              [&] ( const auto &region ) {
+                                  split_large_pages( region, ignore, assign );
+                              } );
+
+                return decltype(large_page_regions)( &(lp_regions[0]),
+                                                    current,
+                                                    std::move( alloc ) );
+            }
+
+            /** \brief Set up memory resources for the
+             *         large-page memory regions.
+             * \tparam RandomAccessIterator The region iterator type
+             * \param[in] regions_begin The begin of the regions
+             * \param[in] regions_end The end of the regions
+             * \param[in] alloc The allocator to be used for the
+             *            construction of the return value and
+             *            the bitmaps.
+             *
+             * \returns An array of \a page_frame_region objects
+             *          with pages of size \a large_pagesize that
+             *          cover the given regions.
+             *
+             * \note \a alloc has to be able to allocate what is
+             *       requested for \a lpm_memory_tag otherwise
+             *       the behaviour is undefined.
+             */
+            template<class RandomAccessIterator>
+            static decltype(large_page_memory)
+            enumerate_lpm( RandomAccessIterator regions_begin,
+                          RandomAccessIterator regions_end,
+                          decltype(large_page_memory)::allocator_type &&alloc )
+            {
+                using lp_container = decltype(large_page_memory);
+
+                std::pmr::memory_resource *bitmap_resource = alloc.resource();
+                auto construct = [bitmap_resource] ( page_frame_region *location,
+                                                    const target::memory_region &region ) {
+                    auto words = page_frame_region::bitmap_words( region, large_pagesize );
+                    auto bitmap = reinterpret_cast<std::size_t *>(
+                            bitmap_resource->allocate( words * sizeof(std::size_t),
+                                                      alignof(std::size_t) ) );
+
+                    new (location) page_frame_region( region, large_pagesize, bitmap );
+                };
+
+                return lp_container( regions_begin,
+                                    regions_end,
+                                    std::move( alloc ),
+                                    construct );
+            }
+
+            /** \brief Set up a memory resource for pages from
+             *         several page frame allocators.
+             * \tparam RandomAccessIterator The region iterator type
+             * \param[in] regions_begin The begin of the regions
+             * \param[in] regions_end The end of the regions
+             * \param[in] memory The page frame allocators, the
+             *            n-th of which manages the n-th region.
+             *
+             * \returns A \a distributed_resource for the given
+             *          allocators or \a nullptr if there are none.
+             */
+            template<class RandomAccessIterator, class Memory>
+            static std::unique_ptr<
+                distributed_resource,
+                utils::destruct_deleter<distributed_resource>
+            > distribute( RandomAccessIterator regions_begin,
+                         RandomAccessIterator regions_end,
+                         Memory &memory )
+            {
+                using resource_ptr = std::unique_ptr<
+                    distributed_resource,
+                    utils::destruct_deleter<distributed_resource>
+                >;
+
+                if( regions_begin == regions_end )
+                    return resource_ptr();
+
+                return resource_ptr( new distributed_resource(
+                     boost::make_transform_iterator( memory.begin(), address_of() ),
+                     boost::make_transform_iterator( memory.end(), address_of() ),
+                     regions_begin, large_pagesize ) );
+            }
+
+            /** \brief Set up memory resources for the
+             *         available memory regions.
+             * \tparam MemMap The memory map type
+             * \tparam RandomAccessIterator The region iterator type
+             * \param[in] memmap The memory map
+             * \param[in] regions_begin The begin of the regions
+             * \param[in] regions_end The end of the regions
+             * \param[in] alloc The allocator to be used for the
+             *            construction of the return value and
+             *            the bitmaps of reclaimable memory.
+             *
+             * \returns An array of \a page_frame_region
+             *          objects that cover the given regions.
+             *          The pages of reclaimable memory are
+             *          reserved until they are reclaimed.
+             *
+             * Within every proximity domain, only the first regions
+             * holding at least \a min_eager_memory bytes or the
+             * \a eager_memory_fraction th part of the memory of the
+             * domain are set up right away, which has to hold the
+             * allocators of the domain. The bitmaps of the other
+             * regions are left to \a initialize_deferred_memory.
+             *
+             * \note \a alloc has to be able to allocate what is
+             *       requested for \a avm_memory_tag otherwise
+             *       the behaviour is undefined.
+             * \note The regions have to be grouped by their
+             *       proximity domains.
+             */
+            template<class MemMap, class RandomAccessIterator>
+            static decltype(available_memory)
+            enumerate_avm( const MemMap &memmap,
+                          RandomAccessIterator regions_begin,
+                          RandomAccessIterator regions_end,
+                          decltype(available_memory)::allocator_type &&alloc )
+            {
                 using av_container = decltype(available_memory);
-                using buffer_resource = typename av_container::value_type;
-                auto buffer_constructor = [] ( decltype(available_memory)::value_type *buf,
-                                              const target::memory_region &region ) {
-                    new (buf) buffer_resource( target::uintptr_to_ptr<void>( region.base() ),
-                                              region.size );
+
+                // The contents of reclaimable memory are still in use,
+                // so its bitmaps have to be kept elsewhere.
+                std::pmr::memory_resource *bitmap_resource = alloc.resource();
+
+                // The regions are constructed in order, so the end
+                // of the current domain is found at its first region.
+                domain_of<MemMap> domain{ &memmap };
+                RandomAccessIterator next = regions_begin;
+                RandomAccessIterator domain_end = regions_begin;
+                std::size_t eager_bytes = 0;
+
+                auto construct = [&] ( page_frame_region *location,
+                                      const target::memory_region &region ) {
+                    auto desc = memmap.find_containing( region );
+
+                    utils::debug_assert( desc != memmap.cend(),
+                                        "The region is not contained in the memory map." );
+
+                    if( next++ == domain_end )
+                    {
+                        std::uint32_t current = desc->proximity_domain;
+                        std::size_t domain_bytes = 0;
+                        for( ; domain_end != regions_end && domain( *domain_end ) == current;
+                            ++domain_end )
+                            if( is_reclaimable( memmap.find_containing( *domain_end )->type ) == false )
+                                domain_bytes += domain_end->size;
+
+                        eager_bytes = std::max( min_eager_memory,
+                                               domain_bytes / eager_memory_fraction );
+                    }
+
+                    if( is_reclaimable( desc->type ) == false )
+                    {
+                        new (location) page_frame_region( region, eager_bytes == 0 );
+                        eager_bytes -= std::min( eager_bytes, region.size );
+                        return;
+                    }
+
+                    auto words = page_frame_region::bitmap_words( region, pagesize );
+                    auto bitmap = reinterpret_cast<std::size_t *>(
+                            bitmap_resource->allocate( words * sizeof(std::size_t),
+                                                      alignof(std::size_t) ) );
+
+                    new (location) page_frame_region( region, pagesize, bitmap, true );
                 };
-                
-                return av_container( &(av_regions[0]),
-                                    current,
+
+                return av_container( regions_begin,
+                                    regions_end,
                                     std::move( alloc ),
-                                    buffer_constructor );
+                                    construct );
             }
-            
+
+            /** \struct domain_of
+             * \brief A function object returning the proximity
+             *        domain of an available memory region.
+             * \tparam MemMap The memory map type
+             */
+            template<class MemMap>
+            struct domain_of
+            {
+                const MemMap *memmap;
+
+                std::uint32_t operator()( const target::memory_region &region ) const
+                {
+                    auto desc = memmap->find_containing( region );
+
+                    utils::debug_assert( desc != memmap->cend(),
+                                        "The region is not contained in the memory map." );
+
+                    return desc->proximity_domain;
+                }
+            };
+
             struct address_of
             {
                 template<class T>
                 auto operator()( T &&t ) const
                 { return std::addressof( std::forward<T>( t ) ); }
             };
-            
+
             /** \brief Construct an \a unsynchronized_memory_manager from
              *         data computed by \a build_memory_manager()
              * \tparam MemMap The memory map type
@@ -560,14 +1296,62 @@ namespace UtopiaOS
                    iresources[tag_index[boost::hana::type_c<memmap_memory_tag>]].get() ),
             omd( omd_begin, omd_end,
                 iresources[tag_index[boost::hana::type_c<omd_memory_tag>]].get() ),
-            available_memory( enumerate_avm( memmap, omd.cbegin(), omd.cend(),
-                 iresources[tag_index[boost::hana::type_c<avm_memory_tag>]].get() ) ),
-            avm_resource( new distributed_resource(
-                 boost::make_transform_iterator( available_memory.begin(),
-                                                address_of() ),
-                 boost::make_transform_iterator( available_memory.end(),
-                                                address_of() )
-                                                  ) )
+            available_regions( profile_boot_phase( "enumerate_avr", [&] {
+                return enumerate_avr( memmap, omd.cbegin(), omd.cend(),
+                     iresources[tag_index[boost::hana::type_c<avr_memory_tag>]].get() );
+            } ) ),
+            available_memory( profile_boot_phase( "enumerate_avm", [&] {
+                return enumerate_avm( memmap,
+                                     available_regions.cbegin(),
+                                     available_regions.cend(),
+                     iresources[tag_index[boost::hana::type_c<avm_memory_tag>]].get() );
+            } ) ),
+            large_page_regions( profile_boot_phase( "enumerate_lpr", [&] {
+                return enumerate_lpr( memmap, omd.cbegin(), omd.cend(),
+                     iresources[tag_index[boost::hana::type_c<lpr_memory_tag>]].get() );
+            } ) ),
+            large_page_memory( profile_boot_phase( "enumerate_lpm", [&] {
+                return enumerate_lpm( large_page_regions.cbegin(),
+                                     large_page_regions.cend(),
+                     iresources[tag_index[boost::hana::type_c<lpm_memory_tag>]].get() );
+            } ) ),
+            avm_resource( profile_boot_phase( "avm distributed_resource", [&] {
+                return new distributed_resource(
+                     boost::make_transform_iterator( available_memory.begin(),
+                                                    address_of() ),
+                     boost::make_transform_iterator( available_memory.end(),
+                                                    address_of() ),
+                     available_regions.cbegin(), pagesize );
+            } ) ),
+            lpm_resource( profile_boot_phase( "lpm distributed_resource", [&] {
+                return distribute( large_page_regions.cbegin(),
+                                  large_page_regions.cend(),
+                                  large_page_memory );
+            } ) ),
+            monotonic_avm_resource( new std::pmr::monotonic_buffer_resource(
+                 avm_resource.get() ) ),
+            numa_avm_resource( profile_boot_phase( "numa_resource", [&] {
+                return new numa_resource(
+                     boost::make_transform_iterator( available_memory.begin(),
+                                                    address_of() ),
+                     boost::make_transform_iterator( available_memory.end(),
+                                                    address_of() ),
+                     available_regions.cbegin(),
+                     boost::make_transform_iterator( available_regions.cbegin(),
+                                                    domain_of<decltype(memmap)>{ &memmap } ),
+                     avm_resource.get(), smallest_memory_chunk, processor_arena_size,
+                     processor_page_block_size );
+            } ) ),
+            zeroed_resource( new zeroed_page_pool( numa_avm_resource.get(),
+                                                  zeroed_pool_capacity ) ),
+            deferred( new deferred_progress{ { 0 }, {
+                static_cast<std::size_t>( std::count_if( available_memory.begin(),
+                                                        available_memory.end(),
+                                                        [] ( const page_frame_region &memory ) {
+                    return (memory.deferred_chunks() != 0);
+                } ) ) } } ),
+            reclaiming( new reclaim_progress{} ),
+            page_resource_lock( new utils::spinlock )
             {}
         public:
             /** \brief Construct the memory manager from a memory map
@@ -586,39 +1370,336 @@ namespace UtopiaOS
                                           RandomAccessIterator omd_end )
             : memory_manager( build_memory_manager( mm, omd_begin, omd_end ) )
             {}
-            
+
             /** \brief An unsynchronized_memory_manager is explicitly
              *         not copy-constructible!
              */
             memory_manager( const memory_manager & ) = delete;
-            
+
             /** \brief An unsynchronized_memory_manager is explicitly
              *         move-constructible!
              */
             memory_manager( memory_manager && ) = default;
-            
+
             /** \brief An unsynchronized_memory_manager is explicitly
              *         not copy-assignable!
              */
             memory_manager &operator=( const memory_manager & ) = delete;
-            
+
             /** \brief An unsynchronized_memory_manager is explicitly
              *         not move-assignable!
              */
             memory_manager &operator=( memory_manager && ) = delete;
-            
+
             /** \brief Returns a memory resource that can be used to
              *         allocate memory managed by the memory manager.
              * \returns Returns a memory resource that can be used to
              *         allocate memory managed by the memory manager.
              * \warning The returned resource is not thread-safe and
              *          will never make deallocated memory available
-             *          again.
+             *          again. It obtains its memory from
+             *          \a page_resource().
              */
             std::pmr::memory_resource *unsynchronized_monotonic_resource( void )
+            {
+                return monotonic_avm_resource.get();
+            }
+
+            /** \brief Returns a memory resource that can be used to
+             *         allocate pages managed by the memory manager.
+             * \returns Returns a memory resource that allocates runs
+             *          of contiguous pages, which become available
+             *          again upon deallocation.
+             * \warning The returned resource is not thread-safe.
+             * \note The returned resource is a \a fallible_resource,
+             *       so \a kernel::try_allocate can be used to
+             *       allocate from it without throwing.
+             */
+            std::pmr::memory_resource *page_resource( void )
             {
                 return avm_resource.get();
             }
+
+            /** \brief Returns a memory resource that can be used to
+             *         allocate large pages managed by the memory manager.
+             * \returns Returns a memory resource that allocates runs
+             *          of contiguous pages of size \a large_pagesize,
+             *          which become available again upon deallocation.
+             *          Requests aligned to \a huge_pagesize yield
+             *          memory that can be mapped with huge pages,
+             *          if a region reserves at least one of them.
+             *          If there is no large-page memory, the returned
+             *          resource fails every allocation.
+             * \warning The returned resource is not thread-safe.
+             * \note Memory reserved for large pages is never handed
+             *       out by \a page_resource(). How much is reserved
+             *       is set by \a large_page_reservation.
+             */
+            std::pmr::memory_resource *large_page_resource( void )
+            {
+                if( lpm_resource == nullptr )
+                    return std::pmr::null_memory_resource();
+
+                return lpm_resource.get();
+            }
+
+            /** \brief Returns a memory resource that can be used
+             *         concurrently by all processors.
+             * \returns Returns a memory resource that serves every
+             *          processor from its own shard of the memory
+             *          local to it and makes deallocated memory
+             *          available again. Memory of other proximity
+             *          domains is only used once the local memory
+             *          is exhausted.
+             * \warning The returned resource obtains its memory from
+             *          \a page_resource(), so the page resource and
+             *          \a unsynchronized_monotonic_resource() must not
+             *          be used once processors allocate concurrently.
+             * \note The returned resource is a \a fallible_resource,
+             *       so \a kernel::try_allocate can be used to
+             *       allocate from it without throwing.
+             */
+            std::pmr::memory_resource *synchronized_resource( void )
+            {
+                return numa_avm_resource.get();
+            }
+
+            /** \brief Returns a memory resource that allocates
+             *         memory of a single proximity domain.
+             * \param[in] proximity_domain The proximity domain
+             * \returns Returns a memory resource like
+             *          \a synchronized_resource() that never
+             *          falls back to other proximity domains.
+             * \throws std::invalid_argument if no memory of
+             *         \a proximity_domain is available.
+             */
+            std::pmr::memory_resource *resource_for_node( std::uint32_t proximity_domain )
+            {
+                return numa_avm_resource->node_resource( proximity_domain );
+            }
+
+            /** \brief Returns a memory resource that allocates
+             *         memory filled with zeros.
+             * \returns Returns a memory resource like
+             *          \a synchronized_resource() whose allocations
+             *          are filled with zeros. Single pages are
+             *          served from the pages cleared by
+             *          \a scrub_pages() first.
+             * \note Pages freed to the returned resource are only
+             *       made available again by \a scrub_pages().
+             */
+            std::pmr::memory_resource *zeroed_page_resource( void )
+            {
+                return zeroed_resource.get();
+            }
+
+            /** \brief Clears pages freed to \a zeroed_page_resource().
+             * \param[in] max_pages The maximum number of pages
+             *            to clear.
+             * \returns The number of pages that were processed,
+             *          which is \a 0 once there is nothing left
+             *          to do.
+             *
+             * This should be called by processors that are idle.
+             */
+            std::size_t scrub_pages( std::size_t max_pages )
+            {
+                return zeroed_resource->scrub( max_pages );
+            }
+
+            /** \brief Takes a snapshot of the allocators behind
+             *         \a synchronized_resource().
+             * \returns The figures of all shards and page resources.
+             *
+             * Only the free blocks are always reported. All other
+             * figures are counted if UTOPIAOS_ENABLE_ALLOCATOR_STATISTICS
+             * is set and remain zero otherwise.
+             *
+             * \note The shards are examined one after another, so
+             *       the snapshot is not atomic as a whole.
+             */
+            memory_statistics statistics( void )
+            {
+                memory_statistics snapshot{};
+                numa_avm_resource->accumulate_statistics( snapshot );
+                return snapshot;
+            }
+
+            /** \brief Returns the number of free pages of the
+             *         available memory.
+             * \returns The pages that neither \a page_resource()
+             *          nor \a synchronized_resource() hand out,
+             *          including the pages the latter keeps in
+             *          its arenas.
+             *
+             * The difference between two calls is the footprint
+             * of the allocators in between them. This is cheap
+             * enough to be sampled during a workload.
+             *
+             * \note This function may be called concurrently with
+             *       allocations from \a synchronized_resource().
+             */
+            std::size_t free_pages( void )
+            {
+                std::size_t sum = 0;
+                numa_avm_resource->with_all_pages_locked( [&] ( std::size_t first,
+                                                               std::size_t count ) {
+                    for( std::size_t index = first; index != first + count; ++index )
+                        sum += available_memory[index].free_pages();
+                } );
+                return sum;
+            }
+            
+            /** \brief Calls a function for every upstream resource
+             *         of the page resources of all proximity domains.
+             * \tparam Function The function object type
+             * \param[in] function The function to call with the
+             *            proximity domain and an \a upstream_statistics
+             *            object, from which the hit rate of every
+             *            page frame allocator can be derived.
+             */
+            template<class Function>
+            void enumerate_page_statistics( Function function ) const
+            {
+                numa_avm_resource->enumerate_upstream_statistics( function );
+            }
+
+            /** \brief Sets the proximity domain of a processor,
+             *         whose local memory is preferred by
+             *         \a synchronized_resource().
+             * \param[in] processor The index of the processor
+             * \param[in] proximity_domain The proximity domain
+             * \throws std::invalid_argument if \a processor is
+             *         out of range or if no memory of
+             *         \a proximity_domain is available.
+             */
+            void assign_processor( std::size_t processor,
+                                  std::uint32_t proximity_domain )
+            {
+                numa_avm_resource->assign_processor( processor, proximity_domain );
+            }
+
+            /** \brief Makes reclaimable memory available for allocation.
+             * \param[in] type The type of the memory to reclaim
+             * \param[in] max_pages The maximum number of pages
+             *            to reclaim.
+             * \returns The number of pages that were reclaimed,
+             *          which is \a 0 once all memory of type
+             *          \a type has been reclaimed.
+             * \throws std::invalid_argument if memory of type
+             *         \a type is not reclaimable.
+             *
+             * Reclaimable memory that is not occupied is managed
+             * from the start, but none of its pages are handed out
+             * before they are reclaimed. Thus memory of a type may
+             * only be reclaimed once the kernel no longer needs its
+             * contents, e.g. the ACPI tables once they are parsed.
+             * Reclaiming few pages at a time bounds the time spent
+             * holding the locks of the allocators.
+             *
+             * \note This function may be called concurrently with
+             *       allocations from \a synchronized_resource().
+             */
+            std::size_t reclaim( memory_type type, std::size_t max_pages )
+            {
+                if( is_reclaimable( type ) == false )
+                    throw std::invalid_argument( "The memory type is not reclaimable." );
+
+                auto &next_region = reclaiming->next_region[static_cast<std::size_t>( type )];
+
+                std::size_t reclaimed = 0;
+                std::size_t index = next_region.load( std::memory_order_relaxed );
+                while( index != available_regions.size() && reclaimed != max_pages )
+                {
+                    auto desc = memmap.find_containing( available_regions[index] );
+                    bool exhausted = (desc->type != type);
+                    if( exhausted == false )
+                    {
+                        auto &memory = available_memory[index];
+                        numa_avm_resource->with_node_pages_locked( desc->proximity_domain,
+                                                                  [&] ( distributed_resource &pages ) {
+                            std::size_t released = memory.release( max_pages - reclaimed );
+                            if( released != 0 )
+                                replenish( index, pages );
+                            reclaimed += released;
+                            exhausted = (memory.reserved_pages() == 0);
+                        } );
+                    }
+
+                    // A failed exchange yields the cursor another
+                    // processor has already moved further.
+                    if( exhausted &&
+                       next_region.compare_exchange_weak( index, index + 1,
+                                                         std::memory_order_relaxed ) )
+                        ++index;
+                }
+
+                return reclaimed;
+            }
+
+            /** \brief Sets up available memory whose bitmaps were
+             *         deferred while the memory manager was built.
+             * \param[in] max_chunks The maximum number of bitmap
+             *            chunks to clear. A chunk is a page of the
+             *            bitmap, i.e. it covers 8 * \a pagesize pages.
+             * \returns The number of chunks that were cleared,
+             *          which is \a 0 once every chunk is claimed.
+             *
+             * Every processor may call this function, so that they
+             * set up disjoint parts of the memory in parallel. The
+             * processor that clears the last chunk of a region makes
+             * it available to \a synchronized_resource() right away.
+             * Thus the boot processor only has to set up enough
+             * memory for the allocators of every proximity domain
+             * before the other processors are started.
+             *
+             * \note This function may be called concurrently with
+             *       allocations from \a synchronized_resource().
+             */
+            std::size_t initialize_deferred_memory( std::size_t max_chunks )
+            {
+                std::size_t cleared = 0;
+                std::size_t index = deferred->next_region.load( std::memory_order_relaxed );
+                while( cleared != max_chunks && index != available_memory.size() )
+                {
+                    auto &memory = available_memory[index];
+                    auto result = memory.initialize_chunk();
+                    if( result == page_frame_region::chunk_result::none_left )
+                    {
+                        // A failed exchange yields the cursor another
+                        // processor has already moved further.
+                        if( deferred->next_region.compare_exchange_weak( index, index + 1,
+                                                                        std::memory_order_relaxed ) )
+                            ++index;
+                        continue;
+                    }
+
+                    ++cleared;
+                    if( result == page_frame_region::chunk_result::completed )
+                    {
+                        auto desc = memmap.find_containing( available_regions[index] );
+                        numa_avm_resource->with_node_pages_locked( desc->proximity_domain,
+                                                                  [&] ( distributed_resource &pages ) {
+                            memory.publish();
+                            replenish( index, pages );
+                        } );
+                        deferred->pending_regions.fetch_sub( 1, std::memory_order_release );
+                    }
+                }
+
+                return cleared;
+            }
+
+            /** \brief Returns whether all available memory
+             *         has been set up.
+             * \returns \a true once every region deferred upon
+             *          construction has been made available by
+             *          \a initialize_deferred_memory.
+             */
+            bool all_memory_available( void ) const
+            {
+                return (deferred->pending_regions.load( std::memory_order_acquire ) == 0);
+            }
         };
     }
 }
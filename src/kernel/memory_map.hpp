@@ -10,14 +10,21 @@
 #define H_kernel_memory
 
 #include "utils/dynarray.hpp"
+#include "utils/ranges.hpp"
+#include "utils/radix_sort.hpp"
 #include "utils/debug.hpp"
 
 #include "constants.hpp"
 
+#include "UEFI/memory.hpp"
+
 #include <memory_resource>
 #include <algorithm>
 #include <limits>
 #include <functional>
+#include <cstdint>
+
+#include <boost/iterator/counting_iterator.hpp>
 
 namespace UtopiaOS
 {
@@ -31,10 +38,46 @@ namespace UtopiaOS
         enum class memory_type : std::uint32_t
         {
             general_purpose,
+            boot_services, /**< Used by the UEFI boot services */
+            loader, /**< Used by the UEFI bootloader */
+            acpi_reclaimable, /**< Holds ACPI tables */
             unusable,
             invalid
         };
         
+        /** \brief Checks whether memory of a given type can
+         *         be used once its contents are no longer needed.
+         * \param[in] type The memory type
+         * \returns \a true if memory of type \a type can be
+         *          reclaimed, \a false otherwise.
+         */
+        constexpr bool is_reclaimable( memory_type type )
+        {
+            return (type == memory_type::boot_services ||
+                    type == memory_type::loader ||
+                    type == memory_type::acpi_reclaimable);
+        }
+        
+        /** \brief The proximity domain of memory whose
+         *         affinity is unknown.
+         */
+        static constexpr std::uint32_t default_proximity_domain = 0;
+        
+        /** \struct memory_affinity
+         * \brief Associates a range of physical memory with
+         *        a proximity domain, as the memory affinity
+         *        structures of the ACPI SRAT do.
+         */
+        struct memory_affinity
+        {
+            std::uintptr_t physical_start;
+            std::size_t size;
+            std::uint32_t proximity_domain;
+            
+            std::uintptr_t physical_end( void ) const
+            { return physical_start + size; }
+        };
+        
         /** \struct memory_descriptor
          * \brief Analogous to a UEFI memory descriptor,
          *        but usable by the kernel. It also has
@@ -55,14 +98,18 @@ namespace UtopiaOS
             std::uintptr_t physical_start;
             std::uintptr_t virtual_start;
             std::size_t number_of_pages;
+            std::uint32_t proximity_domain;
             
             /** \brief Returns an invalid memory descriptor.
              * \returns An invalid memory descriptor
              */
             static memory_descriptor invalid_memory_descriptor( void )
             {
-                return memory_descriptor{ memory_type::invalid,
-                    0, 0, 0 };
+                // The constructor rejects empty descriptors,
+                // so invalidate a valid one instead.
+                memory_descriptor md{ memory_type::unusable, 0, 0, 1 };
+                md.type = memory_type::invalid;
+                return md;
             }
             
             /** \brief Constructs a memory descriptor from
@@ -71,15 +118,17 @@ namespace UtopiaOS
              * \param[in] ps The physical start of the memory region
              * \param[in] vs The virtual start of the memory region
              * \param[in] np The number of pages of the memory region
+             * \param[in] pd The proximity domain of the memory region
              *
              * If the parameters do not fulfil the guarantees
              * required of a memory_descriptor object, a
              * std::invalid_argument exception is thrown.
              */
             memory_descriptor( memory_type t, std::uintptr_t ps,
-                              std::uintptr_t vs, std::size_t np )
+                              std::uintptr_t vs, std::size_t np,
+                              std::uint32_t pd = default_proximity_domain )
             : type( t ), physical_start( ps ), virtual_start( vs ),
-            number_of_pages( np )
+            number_of_pages( np ), proximity_domain( pd )
             {
                 if( validate( *this ) == false )
                 {
@@ -103,14 +152,15 @@ valid memory descriptor with the specified arguments" );
              * \warning If the kernel pagesize cannot be used to fully
              *          cover the memory region, the memory region
              *          will be truncated accordingly.
+             * \note The proximity domain is \a default_proximity_domain.
              */
             memory_descriptor( const UEFI::memory_descriptor_v1 &uefi_desc )
-            : type( uefi_desc.type == UEFI::memory_type::EfiConventionalMemory ?
-                   memory_type::general_purpose : memory_type::unusable ),
+            : type( convert_type( uefi_desc.type ) ),
             physical_start( uefi_desc.physical_start ),
             virtual_start( uefi_desc.virtual_start ),
             number_of_pages( (uefi_desc.number_of_pages * UEFI::pagesize) /
-                               pagesize )
+                               pagesize ),
+            proximity_domain( default_proximity_domain )
             {
                 static_assert( std::numeric_limits<std::uintptr_t>::max() >=
                               std::numeric_limits<UEFI::uint64>::max(),
@@ -143,6 +193,30 @@ valid memory descriptor with the specified arguments" );
              */
             bool is_valid( void ) const { return (type != memory_type::invalid); }
         private:
+            /** \brief Converts a UEFI memory type.
+             * \param[in] uefi_type The UEFI memory type
+             * \returns The memory type that the kernel
+             *          uses for \a uefi_type.
+             */
+            static memory_type convert_type( UEFI::memory_type uefi_type )
+            {
+                switch( uefi_type )
+                {
+                    case UEFI::memory_type::EfiConventionalMemory:
+                        return memory_type::general_purpose;
+                    case UEFI::memory_type::EfiBootServicesCode:
+                    case UEFI::memory_type::EfiBootServicesData:
+                        return memory_type::boot_services;
+                    case UEFI::memory_type::EfiLoaderCode:
+                    case UEFI::memory_type::EfiLoaderData:
+                        return memory_type::loader;
+                    case UEFI::memory_type::EfiACPIReclaimMemory:
+                        return memory_type::acpi_reclaimable;
+                    default:
+                        return memory_type::unusable;
+                }
+            }
+            
             /** \brief Checks whether a memory descriptor does
              *         not fulfil the required guarantees.
              * \param[in] md The memory descriptor to validate
@@ -173,27 +247,8 @@ valid memory descriptor with the specified arguments" );
             }
         };
         
-        /** \class memory_map
-         * \brief The memory map used by the kernel
-         * \tparam Allocator The type of allocator to use
-         *
-         * It has some sanity guarantees that UEFI lacks, like:
-         * - fixed size of descriptors that is known compile-time
-         * - Every descriptor is valid
-         * - overlapping ranges are merged if possible
-         *   and removed otherwise
-         * - The descriptors are sorted by virtual_start in
-         *   ascending order
-         */
-        template<class Allocator>
-        class memory_map
+        namespace detail
         {
-        public:
-            using allocator_type = Allocator;
-        private:
-            using desc_array = utils::dynarray<memory_descriptor, allocator_type>;
-            desc_array descriptors;
-            
             /** \brief Checks whether the memory regions
              *         described by two memory descriptors
              *         overlap.
@@ -204,7 +259,7 @@ valid memory descriptor with the specified arguments" );
              *          preceede that of \a md2, otherwise
              *          the behaviour is undefined.
              */
-            static bool have_overlap( const memory_descriptor &md1,
+            inline bool have_overlap( const memory_descriptor &md1,
                         const memory_descriptor &md2 )
             {
                 utils::debug_assert( md1.virtual_start <= md2.virtual_start,
@@ -212,7 +267,7 @@ valid memory descriptor with the specified arguments" );
                 
                 auto end1 = md1.virtual_start + pagesize * md1.number_of_pages;
                 return (end1 > md2.virtual_start);
-            };
+            }
             
             /** \brief Merges the memory regions described
              *         by two overlapping memory descriptors.
@@ -229,7 +284,7 @@ valid memory descriptor with the specified arguments" );
              *          and \a md2 have to overlap, otherwise
              *          the behaviour is undefined.
              */
-            static memory_descriptor merge_with_overlap( const memory_descriptor &md1,
+            inline memory_descriptor merge_with_overlap( const memory_descriptor &md1,
                                                        const memory_descriptor &md2 )
             {
                 utils::debug_assert( md1.virtual_start <= md2.virtual_start,
@@ -237,10 +292,11 @@ valid memory descriptor with the specified arguments" );
                 utils::debug_assert( have_overlap( md1, md2 ),
                              "md1 and md2 do not overlap" );
                 
-                if( md1.type != md2.type )
+                if( md1.type != md2.type ||
+                   md1.proximity_domain != md2.proximity_domain )
                 {
-                    // Different memory descriptor types
-                    // for overlapping ranges... Corrupt!
+                    // Different memory descriptor types or proximity
+                    // domains for overlapping ranges... Corrupt!
                     return memory_descriptor::invalid_memory_descriptor();
                 }
                 
@@ -262,7 +318,8 @@ valid memory descriptor with the specified arguments" );
                 auto end = std::max( end1, end2 );
                 
                 return memory_descriptor{ md1.type, md1.physical_start,
-                    md1.virtual_start, (end - md1.virtual_start) / pagesize };
+                    md1.virtual_start, (end - md1.virtual_start) / pagesize,
+                    md1.proximity_domain };
             }
             
             /** \brief Checks whether the memory regions described
@@ -276,15 +333,17 @@ valid memory descriptor with the specified arguments" );
              *          the behaviour is undefined.
              *
              * Two memory ranges are mergable if they share the
-             * same type and their physical addresses line up.
+             * same type and proximity domain and their physical
+             * addresses line up.
              */
-            static bool are_adjacent_and_mergable( const memory_descriptor &md1,
+            inline bool are_adjacent_and_mergable( const memory_descriptor &md1,
                                                   const memory_descriptor &md2 )
             {
                 utils::debug_assert( md1.virtual_start <= md2.virtual_start,
                              "md1 does not preceede md2!" );
                 
-                if( md1.type != md2.type )
+                if( md1.type != md2.type ||
+                   md1.proximity_domain != md2.proximity_domain )
                     return false;
                 
                 auto end1 = md1.virtual_start + pagesize * md1.number_of_pages;
@@ -293,7 +352,7 @@ valid memory descriptor with the specified arguments" );
                     return false;
                 
                 return (end1 == md2.virtual_start);
-            };
+            }
             
             /** \brief Merges the memory regions described
              *         by two adjacent memory descriptors.
@@ -308,7 +367,7 @@ valid memory descriptor with the specified arguments" );
              *          and \a md2 have to be adjacent and mergable,
              *          otherwise the behaviour is undefined.
              */
-            static memory_descriptor merge_adjacent( const memory_descriptor &md1,
+            inline memory_descriptor merge_adjacent( const memory_descriptor &md1,
                                                     const memory_descriptor &md2 )
             {
                 utils::debug_assert( md1.virtual_start <= md2.virtual_start,
@@ -320,7 +379,307 @@ valid memory descriptor with the specified arguments" );
                             pagesize * md2.number_of_pages);
                 
                 return memory_descriptor{ md1.type, md1.physical_start,
-                    md1.virtual_start, (end - md1.virtual_start) / pagesize };
+                    md1.virtual_start, (end - md1.virtual_start) / pagesize,
+                    md1.proximity_domain };
+            }
+        }
+        
+        /** \class memory_map_view
+         * \brief A memory map that reads the descriptors of a
+         *        UEFI memory map in place.
+         *
+         * The UEFI descriptors are converted lazily upon traversal.
+         * Invalid descriptors are skipped and adjacent descriptors
+         * that are mergable are coalesced on the fly. Hence the view
+         * provides the same guarantees as \a memory_map without a
+         * copy, provided that the firmware map is sorted, which can
+         * be checked with \a is_usable.
+         *
+         * \note All descriptors have the proximity domain
+         *       \a default_proximity_domain.
+         */
+        class memory_map_view
+        {
+        public:
+            /** \class const_iterator
+             * \brief A forward iterator that yields the
+             *        coalesced descriptors.
+             */
+            class const_iterator
+            {
+            public:
+                /** \name Iterator Traits
+                 * \{ */
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = memory_descriptor;
+                using reference = const memory_descriptor &;
+                using pointer = const memory_descriptor *;
+                using difference_type = std::ptrdiff_t;
+                /** \} */
+            private:
+                /** \brief The first UEFI descriptor of \a current */
+                UEFI::const_memmap_iterator_v1 first;
+                /** \brief The UEFI descriptor following \a current */
+                UEFI::const_memmap_iterator_v1 next;
+                UEFI::const_memmap_iterator_v1 last;
+                memory_descriptor current = memory_descriptor::invalid_memory_descriptor();
+                
+                /** \brief Skips invalid descriptors and coalesces
+                 *         the descriptors starting at \a next.
+                 */
+                void advance( void )
+                {
+                    first = next;
+                    while( first != last && memory_descriptor( *first ).is_valid() == false )
+                        ++first;
+                    
+                    next = first;
+                    if( first == last )
+                        return;
+                    
+                    current = memory_descriptor( *next++ );
+                    for( ; next != last; ++next )
+                    {
+                        memory_descriptor md( *next );
+                        
+                        if( md.is_valid() == false )
+                            continue;
+                        if( detail::are_adjacent_and_mergable( current, md ) == false )
+                            break;
+                        
+                        current = detail::merge_adjacent( current, md );
+                    }
+                }
+            public:
+                const_iterator( UEFI::const_memmap_iterator_v1 position,
+                               UEFI::const_memmap_iterator_v1 end )
+                : first( position ), next( position ), last( end )
+                { advance(); }
+                
+                const_iterator &operator++( void )
+                { advance(); return *this; }
+                const_iterator operator++( int )
+                { const_iterator cp( *this ); ++(*this); return cp; }
+                
+                reference operator*( void ) const { return current; }
+                pointer operator->( void ) const { return &current; }
+                
+                bool operator==( const const_iterator &it ) const
+                { return first == it.first; }
+                bool operator!=( const const_iterator &it ) const
+                { return first != it.first; }
+            };
+        private:
+            UEFI::const_memmap_iterator_v1 uefi_begin;
+            UEFI::const_memmap_iterator_v1 uefi_end;
+            
+            /** \brief The number of coalesced descriptors */
+            std::size_t size;
+        public:
+            /** \brief Checks whether a UEFI memory map can be
+             *         used without sorting it.
+             * \param[in] uefi_map The UEFI memory map
+             * \returns \a true if the valid descriptors of
+             *          \a uefi_map are sorted by virtual_start
+             *          and do not overlap, false otherwise.
+             */
+            static bool is_usable( const UEFI::memory_map &uefi_map )
+            {
+                if( uefi_map.least_compatible_version != 1 )
+                    return false;
+                
+                memory_descriptor previous = memory_descriptor::invalid_memory_descriptor();
+                for( auto it = UEFI::cbegin_v1( uefi_map ); it != UEFI::cend_v1( uefi_map ); ++it )
+                {
+                    memory_descriptor md( *it );
+                    if( md.is_valid() == false )
+                        continue;
+                    
+                    if( previous.is_valid() &&
+                       (md.virtual_start < previous.virtual_start ||
+                        detail::have_overlap( previous, md )) )
+                        return false;
+                    
+                    previous = md;
+                }
+                
+                return true;
+            }
+            
+            /** \brief Constructs a view of a UEFI memory map.
+             * \param[in] uefi_map The UEFI memory map, which has
+             *            to outlive the view.
+             *
+             * \note \a is_usable has to return \a true for
+             *       \a uefi_map otherwise the behaviour is
+             *       undefined.
+             */
+            memory_map_view( const UEFI::memory_map &uefi_map )
+            : uefi_begin( UEFI::cbegin_v1( uefi_map ) ),
+            uefi_end( UEFI::cend_v1( uefi_map ) ),
+            size( static_cast<std::size_t>( std::distance( cbegin(), cend() ) ) )
+            {
+                utils::debug_assert( is_usable( uefi_map ),
+                                    "The UEFI memory map has to be sorted!" );
+            }
+            
+            /** \brief Returns a memory_request that when fulfilled
+             *         will suffice to copy the memory map.
+             * \returns The memory_request
+             */
+            target::memory_request<alignof(memory_descriptor)> maximum_copy_requirement( void ) const
+            {
+                return { size * sizeof(memory_descriptor) };
+            }
+            
+            /** \brief Returns a const iterator to the begin of
+             *         the memory descriptor range.
+             * \returns A const iterator to the begin of
+             *          the memory descriptor range
+             */
+            const_iterator cbegin( void ) const
+            { return const_iterator( uefi_begin, uefi_end ); }
+            
+            /** \brief Returns a const iterator to the end of
+             *         the memory descriptor range.
+             * \returns A const iterator to the end of
+             *          the memory descriptor range
+             */
+            const_iterator cend( void ) const
+            { return const_iterator( uefi_end, uefi_end ); }
+        };
+        
+        /** \class memory_map
+         * \brief The memory map used by the kernel
+         * \tparam Allocator The type of allocator to use
+         *
+         * It has some sanity guarantees that UEFI lacks, like:
+         * - fixed size of descriptors that is known compile-time
+         * - Every descriptor is valid
+         * - overlapping ranges are merged if possible
+         *   and removed otherwise
+         * - The descriptors are sorted by virtual_start in
+         *   ascending order
+         */
+        template<class Allocator>
+        class memory_map
+        {
+        public:
+            using allocator_type = Allocator;
+        private:
+            using desc_array = utils::dynarray<memory_descriptor, allocator_type>;
+            desc_array descriptors;
+            
+            /** \brief Calls a function for every piece of a
+             *         memory descriptor that lies within a
+             *         single proximity domain.
+             * \tparam RandomAccessIterator The affinity iterator type
+             * \tparam Function The function object type
+             * \param[in] md The memory descriptor
+             * \param[in] affinity_begin The begin of the affinities
+             * \param[in] affinity_end The end of the affinities
+             * \param[in] function The function, which is called
+             *            with the physical start, the number of
+             *            pages and the proximity domain of every
+             *            piece in ascending order.
+             *
+             * Memory that is not covered by any affinity keeps the
+             * proximity domain of \a md. Boundaries that do not
+             * fall onto a page boundary are rounded down, but every
+             * piece consists of at least one page.
+             *
+             * \note The affinities have to be sorted by their physical
+             *       start and be disjoint otherwise the behaviour is
+             *       undefined.
+             */
+            template<class RandomAccessIterator, class Function>
+            static void for_each_domain_piece( const memory_descriptor &md,
+                                              RandomAccessIterator affinity_begin,
+                                              RandomAccessIterator affinity_end,
+                                              Function function )
+            {
+                auto start = md.physical_start;
+                auto end = start + pagesize * md.number_of_pages;
+                
+                for( auto current = start; current != end; )
+                {
+                    auto affinity = utils::last_not_greater( affinity_begin, affinity_end,
+                                                            current,
+                                                            std::mem_fn( &memory_affinity::physical_start ) );
+            
+                    auto domain = md.proximity_domain;
+                    auto next = end;
+                
+                    if( affinity != affinity_end && affinity->physical_start <= current )
+                    {
+                        if( current < affinity->physical_end() )
+                        {
+                            domain = affinity->proximity_domain;
+                            next = std::min<std::uintptr_t>( next, affinity->physical_end() );
+                        } else if( ++affinity != affinity_end )
+                            next = std::min<std::uintptr_t>( next, affinity->physical_start );
+                    } else if( affinity != affinity_end )
+                        next = std::min<std::uintptr_t>( next, affinity->physical_start );
+                    
+                    next = start + ((next - start) / pagesize) * pagesize;
+                    if( next == current )
+                        next = current + pagesize;
+                    
+                    function( current, (next - current) / pagesize, domain );
+                    current = next;
+                }
+            }
+            
+            /** \brief Splits the memory descriptors of an array
+             *         along the boundaries of proximity domains.
+             * \tparam RandomAccessIterator The affinity iterator type
+             * \param[in] source The memory descriptors
+             * \param[in] affinity_begin The begin of the affinities
+             * \param[in] affinity_end The end of the affinities
+             * \param[in] alloc The allocator to use
+             * \returns An array of the pieces of the descriptors
+             *          in \a source in the same order, each of
+             *          which lies within a single proximity domain.
+             */
+            template<class RandomAccessIterator>
+            static desc_array
+            split_by_affinity( const desc_array &source,
+                              RandomAccessIterator affinity_begin,
+                              RandomAccessIterator affinity_end,
+                              allocator_type &&alloc )
+            {
+                utils::debug_assert( std::is_sorted( affinity_begin, affinity_end,
+                                        [] ( const memory_affinity &a1, const memory_affinity &a2 ) {
+                                            return (a1.physical_start < a2.physical_start);
+                                        } ),
+                                    "The affinities have to be sorted!" );
+                
+                std::size_t num_pieces = 0;
+                for( const auto &md : source )
+                    for_each_domain_piece( md, affinity_begin, affinity_end,
+                                          [&num_pieces] ( std::uintptr_t, std::size_t, std::uint32_t ) {
+                                              num_pieces++;
+                                          } );
+                
+                desc_array pieces( boost::make_counting_iterator( std::size_t( 0 ) ),
+                                  boost::make_counting_iterator( num_pieces ),
+                                  std::forward<allocator_type>( alloc ),
+                                  [] ( memory_descriptor *piece, std::size_t ) {
+                                      new (piece) memory_descriptor(
+                                            memory_descriptor::invalid_memory_descriptor() );
+                                  } );
+                
+                auto current = pieces.begin();
+                for( const auto &md : source )
+                    for_each_domain_piece( md, affinity_begin, affinity_end,
+                                          [&] ( std::uintptr_t start, std::size_t pages,
+                                               std::uint32_t domain ) {
+                                              auto offset = start - md.physical_start;
+                                              *current++ = memory_descriptor{ md.type, start,
+                                                  md.virtual_start + offset, pages, domain };
+                                          } );
+                
+                return desc_array( std::move( pieces ), num_pieces );
             }
             
             /** \brief Convert a uefi memory map to a
@@ -342,44 +701,76 @@ valid memory descriptor with the specified arguments" );
                                               UEFI::cend_v1( uefi_map ),
                                               std::forward<allocator_type>( alloc ) );
                 
-                auto endValid = std::partition( stage1_descriptors.begin(),
+                // Keep the order of the firmware, which
+                // is usually sorted already.
+                auto endValid = std::remove_if( stage1_descriptors.begin(),
                                                stage1_descriptors.end(),
-                                               std::mem_fn( &memory_descriptor::is_valid ) );
+                                               [] ( const memory_descriptor &md ) {
+                                                   return (md.is_valid() == false);
+                                               } );
+                
+                auto virtual_start = [] ( const memory_descriptor &md ) {
+                    return md.virtual_start;
+                };
+                auto virtual_end = [] ( const memory_descriptor &md ) {
+                    return md.virtual_start + pagesize * md.number_of_pages;
+                };
                 
-                std::sort( stage1_descriptors.begin(), stage1_descriptors.end(),
-                          [] ( const memory_descriptor &md1, const memory_descriptor &md2 ) {
-                              return (md1.virtual_start < md2.virtual_start);
-                          } );
+                if( std::is_sorted( stage1_descriptors.begin(), endValid,
+                                   [] ( const memory_descriptor &md1, const memory_descriptor &md2 ) {
+                                       return (md1.virtual_start < md2.virtual_start);
+                                   } ) == false )
+                    utils::radix_sort( stage1_descriptors.begin(), endValid, virtual_start );
                 
-                for( auto lower = stage1_descriptors.begin();
-                    lower != endValid; ++lower )
+                // Coalesce the sorted descriptors in place. Every
+                // descriptor is either merged into the last one kept
+                // or appended to them. Overlapping descriptors that
+                // cannot be merged are corrupt and removed together
+                // with everything else that overlaps them.
+                auto endKept = stage1_descriptors.begin();
+                std::uintptr_t corrupt_end = 0;
+                bool corrupt = false;
+                
+                for( auto current = stage1_descriptors.begin(); current != endValid; ++current )
                 {
-                    auto &md1 = *lower;
-                    auto upper = lower + 1;
-                    
-                    if( upper == endValid )
-                        break;
-                    auto &md2 = *upper;
-                    
-                    if( have_overlap( md1, md2 ) )
+                    if( corrupt && current->virtual_start < corrupt_end )
                     {
-                        md2 = merge_with_overlap( md1, md2 );
-                        if( md2.type == memory_type::invalid )
-                            md1.type = memory_type::invalid;
-                        ++lower;
-                    } else if( are_adjacent_and_mergable( md1, md2 ) )
+                        corrupt_end = std::max( corrupt_end, virtual_end( *current ) );
+                        continue;
+                    }
+                    corrupt = false;
+                    
+                    if( endKept != stage1_descriptors.begin() )
                     {
-                        md2 = merge_adjacent( md1, md2 );
-                        ++lower;
+                        auto &last = *(endKept - 1);
+                    
+                        if( detail::have_overlap( last, *current ) )
+                        {
+                            auto merged = detail::merge_with_overlap( last, *current );
+                            if( merged.is_valid() )
+                            {
+                                last = merged;
+                                continue;
+                            }
+                            
+                            corrupt = true;
+                            corrupt_end = std::max( virtual_end( last ), virtual_end( *current ) );
+                            --endKept;
+                            continue;
+                        }
+                        
+                        if( detail::are_adjacent_and_mergable( last, *current ) )
+                        {
+                            last = detail::merge_adjacent( last, *current );
+                            continue;
+                        }
                     }
+                    
+                    *endKept++ = *current;
                 }
                 
-                endValid = std::partition( stage1_descriptors.begin(),
-                                          stage1_descriptors.end(),
-                                          std::mem_fn( &memory_descriptor::is_valid ) );
-                
                 return desc_array( std::move( stage1_descriptors ),
-                                  endValid - stage1_descriptors.begin() );
+                                  endKept - stage1_descriptors.begin() );
             }
         public:
             /** \brief Returns a memory_request that when fulfilled
@@ -394,6 +785,24 @@ valid memory descriptor with the specified arguments" );
                 return { uefi_map.number_of_descriptors * sizeof(memory_descriptor) };
             }
             
+            /** \brief Returns a memory_request that when fulfilled
+             *         will suffice to convert a UEFI memory map
+             *         to a kernel-usable one and split it along
+             *         the given number of memory affinities.
+             * \param[in] uefi_map The UEFI memory map
+             * \param[in] num_affinities The number of affinities
+             * \returns The memory_request
+             */
+            static target::memory_request<alignof(memory_descriptor)>
+            maximum_conversion_requirement( const UEFI::memory_map &uefi_map,
+                                           std::size_t num_affinities )
+            {
+                // Every boundary of an affinity splits at most one descriptor.
+                auto max_pieces = uefi_map.number_of_descriptors + 2 * num_affinities;
+                return { (uefi_map.number_of_descriptors + max_pieces) *
+                    sizeof(memory_descriptor) };
+            }
+            
             /** \brief Returns a memory_request that when fulfilled
              *         will suffice to copy the memory map.
              * \returns The memory_request
@@ -416,11 +825,54 @@ valid memory descriptor with the specified arguments" );
                                              std::forward<allocator_type>( alloc ) ) )
             {}
             
+            /** \brief Constructs a kernel-usable memory map
+             *         from a UEFI memory map and assigns the
+             *         proximity domains of the memory.
+             * \tparam RandomAccessIterator The affinity iterator type
+             * \param[in] uefi_map The UEFI memory map
+             * \param[in] affinity_begin The begin of the memory
+             *            affinities, e.g. from the ACPI SRAT
+             * \param[in] affinity_end The end of the memory affinities
+             * \param[in] alloc The allocator used to copy the
+             *                  memory map. It has to be able to
+             *                  allocate at least what is returned
+             *                  by \a maximum_conversion_requirement
+             *                  for the number of affinities.
+             *
+             * Descriptors that span several proximity domains are
+             * split, so that every descriptor lies within one domain.
+             *
+             * \note The affinities have to be sorted by their physical
+             *       start and be disjoint otherwise the behaviour is
+             *       undefined.
+             */
+            template<class RandomAccessIterator>
+            memory_map( const UEFI::memory_map &uefi_map,
+                       RandomAccessIterator affinity_begin,
+                       RandomAccessIterator affinity_end,
+                       allocator_type &&alloc )
+            : descriptors( split_by_affinity( convert_from_uefi( uefi_map, allocator_type( alloc ) ),
+                                             affinity_begin, affinity_end,
+                                             std::forward<allocator_type>( alloc ) ) )
+            {}
+            
             template<class OtherAllocator>
             memory_map( const memory_map<OtherAllocator> &other, allocator_type &&alloc )
             : descriptors( other.cbegin(), other.cend(), std::forward<allocator_type>( alloc ) )
             {}
             
+            /** \brief Copies the descriptors of a \a memory_map_view.
+             * \param[in] view The view
+             * \param[in] alloc The allocator used to copy the
+             *                  memory map. It has to be able to
+             *                  allocate at least what is returned
+             *                  by the \a maximum_copy_requirement
+             *                  of \a view.
+             */
+            memory_map( const memory_map_view &view, allocator_type &&alloc )
+            : descriptors( view.cbegin(), view.cend(), std::forward<allocator_type>( alloc ) )
+            {}
+            
             /** \brief Returns a const iterator to the begin of
              *         the memory descriptor range.
              * \returns A const iterator to the begin of
@@ -436,6 +888,47 @@ valid memory descriptor with the specified arguments" );
              */
             typename desc_array::const_iterator cend( void ) const
             { return descriptors.cend(); }
+            
+            /** \brief Finds the memory descriptor that describes
+             *         a given address.
+             * \param[in] address The virtual address
+             * \returns A const iterator to the memory descriptor
+             *          containing \a address or \a cend() if
+             *          there is none.
+             *
+             * Since the descriptors are sorted and disjoint, this
+             * is a binary search that takes O(log n) steps.
+             */
+            typename desc_array::const_iterator find_descriptor( std::uintptr_t address ) const
+            {
+                return find_containing( target::memory_region{ address, 1 } );
+            }
+            
+            /** \brief Finds the memory descriptor that contains
+             *         a given memory region.
+             * \param[in] region The memory region
+             * \returns A const iterator to the memory descriptor
+             *          containing \a region or \a cend() if there
+             *          is none.
+             *
+             * Since the descriptors are sorted and disjoint, this
+             * is a binary search that takes O(log n) steps.
+             */
+            typename desc_array::const_iterator
+            find_containing( const target::memory_region &region ) const
+            {
+                auto desc = utils::last_not_greater( descriptors.cbegin(),
+                                                    descriptors.cend(),
+                                                    region.base(),
+                                                    [] ( const memory_descriptor &d ) {
+                                                        return d.virtual_start;
+                                                    } );
+                
+                if( desc == descriptors.cend() || desc->contains_memory_region( region ) == false )
+                    return descriptors.cend();
+                
+                return desc;
+            }
         };
     }
 }
@@ -0,0 +1,110 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/numa_resource.cpp
+ * \brief This file implements the \a numa_resource
+ *        class, that keeps one allocator hierarchy
+ *        per proximity domain.
+ */
+
+#include "numa_resource.hpp"
+
+#include "target/target.hpp"
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <stdexcept>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::memory_node;
+using detail::node_route;
+
+std::size_t numa_resource::node_index( std::uint32_t proximity_domain ) const
+{
+    auto node = std::find_if( nodes.cbegin(), nodes.cend(),
+                             [proximity_domain] ( const memory_node &n ) {
+                                 return (n.proximity_domain == proximity_domain);
+                             } );
+    
+    if( node == nodes.cend() )
+        throw std::invalid_argument( "There is no memory of the \
+specified proximity domain." );
+
+    return static_cast<std::size_t>( node - nodes.cbegin() );
+}
+
+void numa_resource::assign_processor( std::size_t processor,
+                                     std::uint32_t proximity_domain )
+{
+    if( processor >= processor_nodes.size() )
+        throw std::invalid_argument( "The processor index exceeds \
+the maximum number of processors." );
+
+    processor_nodes[processor] = node_index( proximity_domain );
+}
+
+void *numa_resource::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    std::size_t local = processor_nodes[UTOPIAOS_CURRENT_CPU() % processor_nodes.size()];
+    
+    void *result = nodes[local].synchronized.try_allocate( bytes, alignment );
+    if( result != nullptr || bytes == 0 )
+        return result;
+    
+    // Only fall back to remote memory once
+    // the local node is exhausted.
+    for( std::size_t i = 1; i != nodes.size(); ++i )
+    {
+        result = nodes[(local + i) % nodes.size()].synchronized.try_allocate( bytes,
+                                                                             alignment );
+        if( result != nullptr )
+            return result;
+    }
+    
+    return nullptr;
+}
+
+void numa_resource::do_deallocate( void* p, std::size_t bytes,
+                                  std::size_t alignment )
+{
+    if( bytes == 0 )
+        return;
+    
+    std::uintptr_t address = target::ptr_to_uintptr( p );
+    const node_route *route = utils::last_not_greater( routes.cbegin(), routes.cend(),
+                                                      address,
+                                                      [] ( const node_route &r ) {
+                                                          return r.region.base();
+                                                      } );
+    
+    utils::debug_assert( route != routes.cend() &&
+                        route->region.base() <= address &&
+                        address - route->region.base() < route->region.size,
+                        "The address is not managed by this resource." );
+    
+    nodes[route->node].synchronized.deallocate( p, bytes, alignment );
+}
+
+bool numa_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+void numa_resource::accumulate_statistics( memory_statistics &sum )
+{
+    for( memory_node &node : nodes )
+    {
+        node.synchronized.accumulate_statistics( sum.shards, sum.caches );
+        
+        for( std::size_t i = 0; i != node.pages.number_of_upstreams(); ++i )
+        {
+            upstream_statistics figures = node.pages.statistics( i );
+            sum.page_attempts += figures.attempts;
+            sum.page_hits += figures.hits;
+        }
+    }
+}
+
+/** \} */
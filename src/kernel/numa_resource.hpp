@@ -0,0 +1,383 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/numa_resource.hpp
+ * \brief This file declares the \a numa_resource
+ *        class, that keeps one allocator hierarchy
+ *        per proximity domain.
+ */
+
+#ifndef H_kernel_numa_resource
+#define H_kernel_numa_resource
+
+#include "fallible_resource.hpp"
+#include "distributed_resource.hpp"
+#include "sharded_resource.hpp"
+#include "allocator_statistics.hpp"
+#include "constants.hpp"
+
+#include "target/target.hpp"
+#include "target/memory.hpp"
+#include "utils/dynarray.hpp"
+#include "utils/ranges.hpp"
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <cstdint>
+#include <array>
+#include <new>
+
+#include <boost/iterator/counting_iterator.hpp>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct memory_node
+             * \brief The allocator hierarchy of the memory
+             *        of one proximity domain.
+             *
+             * The page resources hand out runs of whole pages.
+             */
+            struct memory_node
+            {
+                std::uint32_t proximity_domain;
+                distributed_resource pages;
+                sharded_resource synchronized;
+
+                /** \brief Constructs a \a memory_node object
+                 * \param[in] domain The proximity domain
+                 * \param[in] resource_begin The begin of the page resources
+                 * \param[in] resource_end The end of the page resources
+                 * \param[in] region_begin The begin of the regions
+                 *            managed by the page resources
+                 * \param[in] min_block_size The minimum block size
+                 *            of the shards.
+                 * \param[in] arena_size The size of the arenas
+                 *            of the shards.
+                 * \param[in] page_block_size The smallest block of
+                 *            the headerless shards or \a 0.
+                 */
+                template<class ResourceIterator, class RegionIterator>
+                memory_node( std::uint32_t domain,
+                            ResourceIterator resource_begin,
+                            ResourceIterator resource_end,
+                            RegionIterator region_begin,
+                            std::size_t min_block_size,
+                            std::size_t arena_size,
+                            std::size_t page_block_size )
+                : proximity_domain( domain ),
+                pages( resource_begin, resource_end, region_begin, pagesize ),
+                synchronized( region_begin, region_begin + (resource_end - resource_begin),
+                             &pages, UTOPIAOS_KERNEL_MAX_CPUS,
+                             min_block_size, arena_size, page_block_size )
+                {}
+            };
+
+            /** \struct node_route
+             * \brief Associates a memory region with the
+             *        node that manages it.
+             */
+            struct node_route
+            {
+                target::memory_region region;
+                std::size_t node;
+
+                bool operator<( const node_route &other ) const
+                { return (region.base() < other.region.base()); }
+            };
+        }
+
+        /** \class numa_resource
+         * \brief A thread-safe subclass of \a std::pmr::memory_resource
+         *        that prefers memory close to the current processor.
+         *
+         * The memory of every proximity domain is managed by its
+         * own \a sharded_resource. Allocations are served from the
+         * domain of the current processor and only fall back to
+         * the other domains once it is exhausted. Deallocations
+         * are returned to the domain the memory belongs to.
+         */
+        class numa_resource : public fallible_resource
+        {
+        private:
+            using node_allocator = std::pmr::polymorphic_allocator<detail::memory_node>;
+            using node_container = utils::dynarray<detail::memory_node, node_allocator>;
+
+            using route_allocator = std::pmr::polymorphic_allocator<detail::node_route>;
+            using route_container = utils::dynarray<detail::node_route, route_allocator>;
+
+            /** \brief The routes to the nodes, sorted
+             *         by the base of their regions.
+             */
+            route_container routes;
+
+            /** \brief The nodes in the order of their regions. */
+            node_container nodes;
+
+            /** \brief The index of the node of every processor. */
+            std::array<std::size_t, UTOPIAOS_KERNEL_MAX_CPUS> processor_nodes;
+
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+
+            /** \brief Returns the index of a node.
+             * \param[in] proximity_domain The proximity domain
+             *            of the node
+             * \returns The index of the node
+             * \throws std::invalid_argument if no memory of
+             *         \a proximity_domain is available.
+             */
+            std::size_t node_index( std::uint32_t proximity_domain ) const;
+
+            /** \brief Associates every region with its node.
+             * \tparam RegionIterator The region iterator type
+             * \tparam DomainIterator The domain iterator type
+             * \param[in] region_begin The begin of the regions
+             * \param[in] domain_begin The begin of the domains
+             * \param[in] num_regions The number of regions
+             * \param[in] upstream The resource to allocate from
+             * \returns The routes in the order of the regions.
+             *
+             * The node of a region is the number of domain changes
+             * preceding it. The routes are constructed in order, so
+             * the domain of every region is only looked up once.
+             */
+            template<class RegionIterator, class DomainIterator>
+            static route_container enumerate_routes( RegionIterator region_begin,
+                                                    DomainIterator domain_begin,
+                                                    std::size_t num_regions,
+                                                    std::pmr::memory_resource *upstream )
+            {
+                std::size_t node = 0;
+                std::uint32_t previous = (num_regions != 0 ? domain_begin[0] : 0);
+
+                return route_container( boost::make_counting_iterator( std::size_t( 0 ) ),
+                                       boost::make_counting_iterator( num_regions ),
+                                       route_allocator( upstream ),
+                                       [&] ( detail::node_route *route, std::size_t index ) {
+                                           std::uint32_t domain = domain_begin[index];
+                                           node += (domain != previous);
+                                           previous = domain;
+                                           new (route) detail::node_route{ region_begin[index], node };
+                                       } );
+            }
+
+            /** \brief Sets up the nodes of the regions of
+             *         a route table in a single pass.
+             * \tparam ResourceIterator The resource iterator type
+             * \tparam RegionIterator The region iterator type
+             * \tparam DomainIterator The domain iterator type
+             * \param[in] table The routes in the order of the regions
+             * \param[in] resource_begin The begin of the page resources
+             * \param[in] region_begin The begin of the regions
+             * \param[in] domain_begin The begin of the domains
+             * \param[in] upstream The resource to allocate from
+             * \param[in] min_block_size The minimum block size
+             *            of the shards.
+             * \param[in] arena_size The size of the arenas
+             *            of the shards.
+             * \param[in] page_block_size The smallest block of
+             *            the headerless shards or \a 0.
+             * \returns One node per distinct domain.
+             */
+            template<class ResourceIterator, class RegionIterator, class DomainIterator>
+            static node_container enumerate_nodes( const route_container &table,
+                                                  ResourceIterator resource_begin,
+                                                  RegionIterator region_begin,
+                                                  DomainIterator domain_begin,
+                                                  std::pmr::memory_resource *upstream,
+                                                  std::size_t min_block_size,
+                                                  std::size_t arena_size,
+                                                  std::size_t page_block_size )
+            {
+                std::size_t num_nodes = (table.size() == 0 ? 0 : table.back().node + 1);
+                std::size_t first = 0;
+
+                return node_container( boost::make_counting_iterator( std::size_t( 0 ) ),
+                                      boost::make_counting_iterator( num_nodes ),
+                                      node_allocator( upstream ),
+                                      [&] ( detail::memory_node *node, std::size_t index ) {
+                                          std::size_t last = first;
+                                          while( last != table.size() && table[last].node == index )
+                                              ++last;
+
+                                          new (node) detail::memory_node( domain_begin[first],
+                                                                         resource_begin + first,
+                                                                         resource_begin + last,
+                                                                         region_begin + first,
+                                                                         min_block_size,
+                                                                         arena_size,
+                                                                         page_block_size );
+                                          first = last;
+                                      } );
+            }
+        public:
+            /** \brief Constructs a \a numa_resource object
+             * \tparam ResourceIterator A random access iterator to
+             *         pointers to page resources
+             * \tparam RegionIterator A random access iterator to the
+             *         \a target::memory_region objects managed by
+             *         the page resources
+             * \tparam DomainIterator A random access iterator to
+             *         the proximity domains of the regions
+             * \param[in] resource_begin The begin of the page resources
+             * \param[in] resource_end The end of the page resources
+             * \param[in] region_begin The begin of the regions
+             * \param[in] domain_begin The begin of the domains
+             * \param[in] upstream The resource used to allocate
+             *            the nodes and the routing table.
+             * \param[in] min_block_size The minimum block size
+             *            of the shards.
+             * \param[in] arena_size The size of the arenas
+             *            of the shards.
+             * \param[in] page_block_size The smallest block of
+             *            the headerless shards or \a 0.
+             *
+             * Every processor initially uses the first node.
+             *
+             * \note The regions have to be sorted by their proximity
+             *       domain otherwise the behaviour is undefined.
+             */
+            template<class ResourceIterator, class RegionIterator, class DomainIterator>
+            numa_resource( ResourceIterator resource_begin,
+                          ResourceIterator resource_end,
+                          RegionIterator region_begin,
+                          DomainIterator domain_begin,
+                          std::pmr::memory_resource *upstream,
+                          std::size_t min_block_size,
+                          std::size_t arena_size,
+                          std::size_t page_block_size )
+            : routes( enumerate_routes( region_begin, domain_begin,
+                                       static_cast<std::size_t>( resource_end - resource_begin ),
+                                       upstream ) ),
+            nodes( enumerate_nodes( routes, resource_begin, region_begin, domain_begin,
+                                   upstream, min_block_size, arena_size,
+                                   page_block_size ) )
+            {
+                utils::debug_assert( nodes.size() != 0,
+                                    "There has to be available memory." );
+                utils::debug_assert( std::adjacent_find( nodes.cbegin(), nodes.cend(),
+                                        [] ( const detail::memory_node &n1,
+                                            const detail::memory_node &n2 ) {
+                                            return (n1.proximity_domain >= n2.proximity_domain);
+                                        } ) == nodes.cend(),
+                                    "The regions have to be sorted by proximity domain." );
+
+                std::sort( routes.begin(), routes.end() );
+                processor_nodes.fill( 0 );
+            }
+
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            numa_resource( const numa_resource & ) = delete;
+
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            numa_resource( numa_resource && ) = delete;
+
+            /** \brief Returns the memory resource of a
+             *         proximity domain.
+             * \param[in] proximity_domain The proximity domain
+             * \returns A thread-safe memory resource that only
+             *          allocates memory of \a proximity_domain.
+             * \throws std::invalid_argument if no memory of
+             *         \a proximity_domain is available.
+             */
+            fallible_resource *node_resource( std::uint32_t proximity_domain )
+            { return &(nodes[node_index( proximity_domain )].synchronized); }
+
+            /** \brief Calls a function while the page resources
+             *         of a proximity domain are locked.
+             * \tparam Function The function object type
+             * \param[in] proximity_domain The proximity domain
+             * \param[in] function The function to call with the
+             *            \a distributed_resource of the page
+             *            resources, e.g. to replenish it.
+             * \throws std::invalid_argument if no memory of
+             *         \a proximity_domain is available.
+             */
+            template<class Function>
+            void with_node_pages_locked( std::uint32_t proximity_domain,
+                                        Function function )
+            {
+                detail::memory_node &node = nodes[node_index( proximity_domain )];
+                node.synchronized.with_pages_locked( [&] ( void ) {
+                    function( node.pages );
+                } );
+            }
+
+            /** \brief Calls a function for every node while
+             *         its page resources are locked.
+             * \tparam Function The function object type
+             * \param[in] function The function to call with the
+             *            index of the first region of the node and
+             *            the number of its regions.
+             *
+             * The nodes are visited in the order of their regions,
+             * so that the ranges follow each other.
+             */
+            template<class Function>
+            void with_all_pages_locked( Function function )
+            {
+                std::size_t first = 0;
+                for( detail::memory_node &node : nodes )
+                {
+                    std::size_t count = node.pages.number_of_upstreams();
+                    node.synchronized.with_pages_locked( [&] ( void ) {
+                        function( first, count );
+                    } );
+                    first += count;
+                }
+            }
+            
+            /** \brief Assigns a processor to a proximity domain.
+             * \param[in] processor The index of the processor
+             * \param[in] proximity_domain The proximity domain
+             *            of the processor, e.g. from the ACPI SRAT
+             * \throws std::invalid_argument if \a processor is
+             *         out of range or if no memory of
+             *         \a proximity_domain is available.
+             */
+            void assign_processor( std::size_t processor,
+                                  std::uint32_t proximity_domain );
+
+            /** \brief Adds the figures of all nodes to
+             *         a snapshot.
+             * \param[inout] sum The snapshot
+             */
+            void accumulate_statistics( memory_statistics &sum );
+
+            /** \brief Calls a function for every upstream
+             *         resource of the page resources.
+             * \tparam Function The function object type
+             * \param[in] function The function to call with the
+             *            proximity domain and a snapshot of
+             *            every upstream resource.
+             */
+            template<class Function>
+            void enumerate_upstream_statistics( Function function ) const
+            {
+                for( const detail::memory_node &node : nodes )
+                    for( std::size_t i = 0; i != node.pages.number_of_upstreams(); ++i )
+                        function( node.proximity_domain, node.pages.statistics( i ) );
+            }
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,288 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/page_frame_region.cpp
+ * \brief This file implements the \a page_frame_region
+ *        class, that allocates runs of contiguous pages
+ *        from a single memory region.
+ */
+
+#include "page_frame_region.hpp"
+
+#include "target/target.hpp"
+#include "target/memory.hpp"
+
+#include "utils/bitwise.hpp"
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+std::size_t page_frame_region::find_free( std::size_t from ) const
+{
+    std::size_t num_words = (num_pages + bits_per_word - 1) / bits_per_word;
+    std::size_t word = from / bits_per_word;
+    
+    if( word >= num_words )
+        return num_pages;
+    
+    // Pages past the end are always marked as occupied,
+    // so they are never reported as free.
+    std::size_t free = (~occupied[word] >> (from % bits_per_word)) << (from % bits_per_word);
+    while( free == 0 )
+    {
+        if( ++word == num_words )
+            return num_pages;
+        
+        free = ~occupied[word];
+    }
+    
+    return (word * bits_per_word + utils::ctz( free ));
+}
+
+std::size_t page_frame_region::find_occupied( std::size_t from, std::size_t to ) const
+{
+    if( from == to )
+        return to;
+    
+    std::size_t word = from / bits_per_word;
+    std::size_t last_word = (to - 1) / bits_per_word;
+    
+    std::size_t used = (occupied[word] >> (from % bits_per_word)) << (from % bits_per_word);
+    while( used == 0 )
+    {
+        if( word++ == last_word )
+            return to;
+        
+        used = occupied[word];
+    }
+    
+    return std::min( word * bits_per_word + utils::ctz( used ), to );
+}
+
+void page_frame_region::mark( std::size_t from, std::size_t to, bool value )
+{
+    while( from != to )
+    {
+        std::size_t word = from / bits_per_word;
+        std::size_t offset = from % bits_per_word;
+        std::size_t count = std::min( to - from, bits_per_word - offset );
+        
+        std::size_t mask = (count == bits_per_word ? ~std::size_t( 0 ) :
+                            ((std::size_t( 1U ) << count) - 1) << offset);
+        
+        if( value )
+            occupied[word] |= mask;
+        else
+            occupied[word] &= ~mask;
+        
+        from += count;
+    }
+}
+
+void *page_frame_region::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    if( bytes == 0 )
+        return nullptr;
+    if( bytes > std::numeric_limits<std::size_t>::max() - (frame_size - 1) )
+        return nullptr;
+    
+    std::size_t run_pages = pages_for( bytes );
+    if( run_pages > num_free_pages )
+        return nullptr;
+    
+    // The run has to start at a page whose index is congruent
+    // to the following value modulo alignment_pages.
+    std::size_t alignment_pages = std::max( alignment, frame_size ) / frame_size;
+    std::size_t base_page = region.base() / frame_size;
+    std::size_t phase = (alignment_pages - base_page % alignment_pages) % alignment_pages;
+    
+    auto align_up = [&] ( std::size_t page ) {
+        std::size_t misalignment = (page + alignment_pages - phase) % alignment_pages;
+        return (misalignment == 0 ? page : page + (alignment_pages - misalignment));
+    };
+    
+    std::size_t first_free = find_free( first_free_hint );
+    std::size_t start = align_up( first_free );
+    
+    while( start < num_pages && run_pages <= num_pages - start )
+    {
+        std::size_t conflict = find_occupied( start, start + run_pages );
+        
+        if( conflict == start + run_pages )
+        {
+            mark( start, start + run_pages, true );
+            num_free_pages -= run_pages;
+            first_free_hint = (start == first_free ? start + run_pages : first_free);
+            
+            return target::uintptr_to_ptr<void>( region.base() + start * frame_size );
+        }
+        
+        start = align_up( find_free( conflict ) );
+    }
+    
+    first_free_hint = first_free;
+    return nullptr;
+}
+
+void page_frame_region::do_deallocate( void* p, std::size_t bytes, std::size_t )
+{
+    if( bytes == 0 )
+        return;
+    
+    std::size_t start = (target::ptr_to_uintptr( p ) - region.base()) / frame_size;
+    std::size_t run_pages = pages_for( bytes );
+    
+    utils::debug_assert( start + run_pages <= num_pages &&
+                        find_free( start ) >= start + run_pages,
+                        "Deallocating pages that are not allocated." );
+    
+    mark( start, start + run_pages, false );
+    num_free_pages += run_pages;
+    first_free_hint = std::min( first_free_hint, start );
+}
+
+bool page_frame_region::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+target::memory_region page_frame_region::whole_pages( const target::memory_region &r,
+                                                     std::size_t page_size )
+{
+    std::uintptr_t base = r.base() + (page_size - r.base() % page_size) % page_size;
+    std::uintptr_t top = r.top() - (r.top() % page_size);
+    
+    if( base < r.base() )
+        return { 0, 0 };
+    
+    // The page at address zero would be indistinguishable from
+    // a null pointer, so the region starts at the next one.
+    if( base == 0 )
+        base = page_size;
+    
+    if( base >= top )
+        return { 0, 0 };
+    
+    return { base, top - base };
+}
+    
+std::size_t page_frame_region::bitmap_words( const target::memory_region &r,
+                                            std::size_t page_size )
+{
+    std::size_t total_pages = whole_pages( r, page_size ).size / page_size;
+    return ((total_pages + bits_per_word - 1) / bits_per_word);
+}
+    
+void page_frame_region::complete( std::size_t metadata_pages )
+{
+    mark( 0, metadata_pages, true );
+    mark( num_pages, num_words() * bits_per_word, true );
+    
+    num_free_pages = num_pages - metadata_pages;
+    first_free_hint = metadata_pages;
+}
+
+void page_frame_region::initialize( std::size_t *bitmap, std::size_t metadata_pages )
+{
+    occupied = bitmap;
+    std::memset( occupied, 0, num_words() * sizeof(std::size_t) );
+    complete( metadata_pages );
+}
+
+page_frame_region::page_frame_region( const target::memory_region &r, bool deferred )
+: region{ 0, 0 }, frame_size( pagesize ), num_pages( 0 ), num_free_pages( 0 ),
+first_free_hint( 0 ), first_reserved( 0 ), occupied( nullptr ),
+num_chunks( 0 ), claimed_chunks( 0 ), initialized_chunks( 0 )
+{
+    target::memory_region pages = whole_pages( r, frame_size );
+    std::size_t total_pages = pages.size / frame_size;
+    std::size_t num_words = (total_pages + bits_per_word - 1) / bits_per_word;
+    std::size_t metadata_pages = pages_for( num_words * sizeof(std::size_t) );
+    
+    if( metadata_pages >= total_pages )
+        return;
+    
+    region = pages;
+    num_pages = total_pages;
+    first_reserved = num_pages;
+    
+    if( deferred )
+    {
+        occupied = target::uintptr_to_ptr<std::size_t>( region.base() );
+        num_chunks = (num_words + words_per_chunk - 1) / words_per_chunk;
+    } else
+        initialize( target::uintptr_to_ptr<std::size_t>( region.base() ), metadata_pages );
+}
+
+page_frame_region::page_frame_region( const target::memory_region &r,
+                                     std::size_t page_size, std::size_t *bitmap,
+                                     bool reserved )
+: region{ 0, 0 }, frame_size( page_size ), num_pages( 0 ), num_free_pages( 0 ),
+first_free_hint( 0 ), first_reserved( 0 ), occupied( nullptr ),
+num_chunks( 0 ), claimed_chunks( 0 ), initialized_chunks( 0 )
+{
+    if( utils::popcount( frame_size ) != 1 )
+        throw std::invalid_argument( "The page size has to be a \
+power of two." );
+
+    target::memory_region pages = whole_pages( r, frame_size );
+    if( pages.size == 0 )
+        return;
+    
+    region = pages;
+    num_pages = pages.size / frame_size;
+    first_reserved = (reserved ? 0 : num_pages);
+    initialize( bitmap, first_reserved == 0 ? num_pages : 0 );
+}
+
+std::size_t page_frame_region::release( std::size_t max_pages )
+{
+    std::size_t count = std::min( max_pages, reserved_pages() );
+    if( count == 0 )
+        return 0;
+    
+    mark( first_reserved, first_reserved + count, false );
+    num_free_pages += count;
+    first_free_hint = std::min( first_free_hint, first_reserved );
+    first_reserved += count;
+    
+    return count;
+}
+
+page_frame_region::chunk_result page_frame_region::initialize_chunk( void ) noexcept
+{
+    // Keep the counter from growing once everything is claimed
+    if( claimed_chunks.load( std::memory_order_relaxed ) >= num_chunks )
+        return chunk_result::none_left;
+    
+    std::size_t chunk = claimed_chunks.fetch_add( 1, std::memory_order_relaxed );
+    if( chunk >= num_chunks )
+        return chunk_result::none_left;
+    
+    std::size_t first = chunk * words_per_chunk;
+    std::size_t count = std::min( words_per_chunk, num_words() - first );
+    std::memset( occupied + first, 0, count * sizeof(std::size_t) );
+    
+    // The caller that clears the last chunk sees all other chunks
+    if( initialized_chunks.fetch_add( 1, std::memory_order_acq_rel ) + 1 == num_chunks )
+        return chunk_result::completed;
+    
+    return chunk_result::initialized;
+}
+
+void page_frame_region::publish( void )
+{
+    utils::debug_assert( num_chunks != 0 &&
+                        initialized_chunks.load( std::memory_order_acquire ) == num_chunks,
+                        "Publishing a region whose bitmap is not cleared." );
+    
+    complete( pages_for( num_words() * sizeof(std::size_t) ) );
+}
+
+/** \} */
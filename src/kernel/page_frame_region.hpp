@@ -0,0 +1,280 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/page_frame_region.hpp
+ * \brief This file declares the \a page_frame_region
+ *        class, that allocates runs of contiguous pages
+ *        from a single memory region.
+ */
+
+#ifndef H_kernel_page_frame_region
+#define H_kernel_page_frame_region
+
+#include "fallible_resource.hpp"
+#include "constants.hpp"
+
+#include "target/memory.hpp"
+
+#include <memory_resource>
+#include <limits>
+#include <atomic>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        /** \class page_frame_region
+         * \brief A conforming subclass of \a std::pmr::memory_resource
+         *        that manages the pages of a memory region.
+         *
+         * Every allocation occupies a run of contiguous pages,
+         * i.e. its size is rounded up to a multiple of
+         * \a pagesize and it is aligned to at least \a pagesize.
+         * Larger alignments are supported as well.
+         *
+         * The state of every page is kept in a bitmap with one
+         * bit per page, that is stored in the first pages of the
+         * region itself. Deallocated pages become available again
+         * immediately.
+         *
+         * Pages need not be of size \a pagesize. For larger pages
+         * the bitmap can be kept outside of the region, so that it
+         * does not occupy a whole page.
+         *
+         * The bitmap of a large region may also be set up later
+         * and in parallel, one chunk of \a pagesize bytes at a
+         * time, while the region offers no pages until it has
+         * been published.
+         */
+        class page_frame_region : public fallible_resource
+        {
+        public:
+            /** \brief The outcome of \a initialize_chunk */
+            enum class chunk_result
+            {
+                none_left, /**< Every chunk had been claimed already */
+                initialized, /**< A chunk was initialized */
+                completed /**< The last chunk was initialized */
+            };
+        private:
+            static constexpr std::size_t bits_per_word =
+                std::numeric_limits<std::size_t>::digits;
+            
+            /** \brief The number of bitmap words per chunk */
+            static constexpr std::size_t words_per_chunk =
+                pagesize / sizeof(std::size_t);
+            
+            /** \brief The page-aligned part of the region */
+            target::memory_region region;
+            
+            /** \brief The size of a page, which is a power of two */
+            std::size_t frame_size;
+            
+            std::size_t num_pages;
+            std::size_t num_free_pages;
+            
+            /** \brief No page below this index is free */
+            std::size_t first_free_hint;
+            
+            /** \brief The pages at and above this index are
+             *         reserved until they are released.
+             */
+            std::size_t first_reserved;
+            
+            /** \brief Bit \a n is set if and only if
+             *         page \a n is occupied.
+             */
+            std::size_t *occupied;
+            
+            /** \brief The number of chunks of the bitmap that
+             *         are left to \a initialize_chunk, or \a 0.
+             */
+            std::size_t num_chunks;
+            
+            std::atomic<std::size_t> claimed_chunks;
+            std::atomic<std::size_t> initialized_chunks;
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            
+            /** \brief Returns the number of pages an
+             *         allocation of a given size occupies.
+             * \param[in] bytes The size of the allocation
+             * \returns The number of pages
+             */
+            std::size_t pages_for( std::size_t bytes ) const
+            { return (bytes / frame_size + (bytes % frame_size != 0)); }
+            
+            /** \brief Returns the index of the first free page
+             *         at or above a given index.
+             * \param[in] from The index to start at
+             * \returns The index of the free page or \a num_pages
+             *          if there is none.
+             */
+            std::size_t find_free( std::size_t from ) const;
+            
+            /** \brief Returns the index of the first occupied
+             *         page within a given range.
+             * \param[in] from The begin of the range
+             * \param[in] to The end of the range
+             * \returns The index of the occupied page or \a to
+             *          if there is none.
+             */
+            std::size_t find_occupied( std::size_t from, std::size_t to ) const;
+            
+            /** \brief Marks a range of pages as occupied or free.
+             * \param[in] from The begin of the range
+             * \param[in] to The end of the range
+             * \param[in] value \a true to mark the pages as occupied
+             */
+            void mark( std::size_t from, std::size_t to, bool value );
+            
+            /** \brief Returns the page-aligned part of a region.
+             * \param[in] r The region
+             * \param[in] page_size The size of a page
+             * \returns The largest region of whole pages within
+             *          \a r, leaving out the page at address zero,
+             *          or an empty region if there is none.
+             */
+            static target::memory_region whole_pages( const target::memory_region &r,
+                                                     std::size_t page_size );
+            
+            /** \brief Returns the number of words of the bitmap. */
+            std::size_t num_words( void ) const
+            { return (num_pages + bits_per_word - 1) / bits_per_word; }
+            
+            /** \brief Marks the metadata and the bits past the end
+             *         of a cleared bitmap and counts the free pages.
+             * \param[in] metadata_pages The number of pages at the
+             *            beginning of the region to mark as occupied.
+             */
+            void complete( std::size_t metadata_pages );
+            
+            /** \brief Sets up the bitmap of a non-empty region.
+             * \param[in] bitmap The storage of the bitmap
+             * \param[in] metadata_pages The number of pages at the
+             *            beginning of the region to mark as occupied.
+             */
+            void initialize( std::size_t *bitmap, std::size_t metadata_pages );
+        public:
+            /** \brief Constructs a \a page_frame_region object
+             * \param[in] r The memory region to manage. Partial
+             *            pages at its boundaries are ignored.
+             * \param[in] deferred If \a true, the bitmap is not set
+             *            up until every chunk has been initialized
+             *            by \a initialize_chunk and the region has
+             *            been published by \a publish. Until then,
+             *            the region has no free pages.
+             *
+             * \note The bitmap is placed at the beginning of
+             *       the region, so the memory has to be writable.
+             */
+            page_frame_region( const target::memory_region &r, bool deferred = false );
+            
+            /** \brief Constructs a \a page_frame_region object with
+             *         pages of a given size and an external bitmap.
+             * \param[in] r The memory region to manage. Partial
+             *            pages at its boundaries are ignored.
+             * \param[in] page_size The size of a page, which
+             *            has to be a power of two.
+             * \param[in] bitmap The storage for the bitmap, which
+             *            has to hold at least \a bitmap_words
+             *            words and outlive the object.
+             * \param[in] reserved If \a true, all pages are reserved
+             *            until they are released by \a release.
+             *            Since the bitmap is external, the memory of
+             *            the region is not touched until then.
+             *
+             * \throws std::invalid_argument if \a page_size
+             *         is not a power of two.
+             */
+            page_frame_region( const target::memory_region &r,
+                              std::size_t page_size, std::size_t *bitmap,
+                              bool reserved = false );
+            
+            /** \brief Returns the size of an external bitmap.
+             * \param[in] r The memory region to manage
+             * \param[in] page_size The size of a page
+             * \returns The number of words the bitmap for
+             *          \a r occupies.
+             */
+            static std::size_t bitmap_words( const target::memory_region &r,
+                                            std::size_t page_size );
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            page_frame_region( const page_frame_region & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            page_frame_region( page_frame_region && ) = delete;
+            
+            /** \brief Returns the number of free pages.
+             * \returns The number of free pages
+             */
+            std::size_t free_pages( void ) const
+            { return num_free_pages; }
+            
+            /** \brief Returns the size of a page.
+             * \returns The size of a page
+             */
+            std::size_t page_size( void ) const
+            { return frame_size; }
+            
+            /** \brief Returns the number of reserved pages.
+             * \returns The number of pages that have not
+             *          been released yet.
+             */
+            std::size_t reserved_pages( void ) const
+            { return num_pages - first_reserved; }
+            
+            /** \brief Makes reserved pages available for allocation.
+             * \param[in] max_pages The maximum number of pages
+             *            to release.
+             * \returns The number of pages that were released.
+             *
+             * The pages are released in ascending order.
+             */
+            std::size_t release( std::size_t max_pages );
+            
+            /** \brief Returns the number of chunks the bitmap
+             *         of a deferred region consists of.
+             * \returns The number of chunks or \a 0 if the
+             *          bitmap was set up upon construction.
+             */
+            std::size_t deferred_chunks( void ) const
+            { return num_chunks; }
+            
+            /** \brief Clears the next unclaimed chunk of the bitmap.
+             * \returns Whether a chunk was claimed and whether
+             *          it was the last one to be cleared.
+             *
+             * This function may be called concurrently. The caller
+             * that gets \a chunk_result::completed has to call
+             * \a publish afterwards.
+             */
+            chunk_result initialize_chunk( void ) noexcept;
+            
+            /** \brief Makes the pages of a deferred region available
+             *         once its bitmap has been cleared.
+             *
+             * \note The same synchronization as for allocations
+             *       from the region is needed.
+             */
+            void publish( void );
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,137 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/recording_resource.cpp
+ * \brief This file contains the definitions for
+ *        the \a recording_resource class and the
+ *        allocation traces it writes.
+ */
+
+#include "recording_resource.hpp"
+
+#include "target/memory.hpp"
+
+#include <stdexcept>
+#include <new>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::allocation_trace_header;
+using detail::allocation_record;
+
+allocation_trace::allocation_trace( void *storage, std::size_t size )
+{
+    if( size < sizeof(allocation_trace_header) )
+        throw std::invalid_argument( "The allocation trace is too small." );
+    
+    header = new (storage) allocation_trace_header;
+    header->magic = detail::allocation_trace_magic;
+    header->version = detail::allocation_trace_version;
+    header->capacity = (size - sizeof(allocation_trace_header)) / sizeof(allocation_record);
+    header->head.store( 0, std::memory_order_relaxed );
+    header->dropped.store( 0, std::memory_order_relaxed );
+    
+    records = reinterpret_cast<allocation_record *>( header + 1 );
+}
+
+void allocation_trace::write( const allocation_event &event ) noexcept
+{
+    std::uint64_t position = header->head.load( std::memory_order_relaxed );
+    do
+    {
+        if( position == header->capacity )
+        {
+            header->dropped.fetch_add( 1, std::memory_order_relaxed );
+            return;
+        }
+    } while( header->head.compare_exchange_weak( position, position + 1,
+                                                std::memory_order_relaxed ) == false );
+    
+    allocation_record *record = new (records + position) allocation_record{
+        { 0 }, event.alignment, event.timestamp, event.address, event.bytes, event.call_site
+    };
+    record->tag.store( static_cast<std::uint32_t>( event.kind ) |
+                      (static_cast<std::uint32_t>( event.cpu ) << 8),
+                      std::memory_order_release );
+}
+
+std::size_t allocation_trace::used_bytes( void ) const noexcept
+{
+    return sizeof(allocation_trace_header) +
+        header->head.load( std::memory_order_relaxed ) * sizeof(allocation_record);
+}
+
+allocation_trace_view::allocation_trace_view( const void *trace, std::size_t size )
+: header( static_cast<const allocation_trace_header *>( trace ) ),
+records( reinterpret_cast<const allocation_record *>( header + 1 ) )
+{
+    if( size < sizeof(allocation_trace_header) ||
+       header->magic != detail::allocation_trace_magic ||
+       header->version != detail::allocation_trace_version )
+        throw std::invalid_argument( "The memory does not hold an allocation trace." );
+    
+    count = header->head.load( std::memory_order_acquire );
+    if( count > (size - sizeof(allocation_trace_header)) / sizeof(allocation_record) )
+        throw std::invalid_argument( "The allocation trace is truncated." );
+}
+
+bool allocation_trace_view::read( std::size_t index, allocation_event &event ) const noexcept
+{
+    const allocation_record &record = records[index];
+    std::uint32_t tag = record.tag.load( std::memory_order_acquire );
+    if( tag == 0 )
+        return false;
+    
+    event = { static_cast<allocation_event_kind>( tag & 0xFF ),
+              static_cast<std::uint16_t>( tag >> 8 ), record.alignment,
+              record.timestamp, record.address, record.bytes, record.call_site };
+    return true;
+}
+
+void *recording_resource::record_allocation( std::size_t bytes, std::size_t alignment,
+                                            const void *call_site ) noexcept
+{
+    void *p = kernel::try_allocate( upstream, bytes, alignment );
+    
+    trace->write( { (p != nullptr ? allocation_event_kind::allocate :
+                     allocation_event_kind::failure),
+                    static_cast<std::uint16_t>( UTOPIAOS_CURRENT_CPU() ),
+                    static_cast<std::uint32_t>( alignment ), UTOPIAOS_TIMESTAMP(),
+                    target::ptr_to_uintptr( p ), bytes,
+                    target::ptr_to_uintptr( call_site ) } );
+    return p;
+}
+
+void* recording_resource::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    return record_allocation( bytes, alignment, UTOPIAOS_CALL_SITE() );
+}
+
+void* recording_resource::do_allocate( std::size_t bytes, std::size_t alignment )
+{
+    void *p = record_allocation( bytes, alignment, UTOPIAOS_CALL_SITE() );
+    
+    if( p == nullptr && bytes != 0 )
+        throw std::bad_alloc();
+    
+    return p;
+}
+
+void recording_resource::do_deallocate( void* p, std::size_t bytes, std::size_t alignment )
+{
+    trace->write( { allocation_event_kind::deallocate,
+                    static_cast<std::uint16_t>( UTOPIAOS_CURRENT_CPU() ),
+                    static_cast<std::uint32_t>( alignment ), UTOPIAOS_TIMESTAMP(),
+                    target::ptr_to_uintptr( p ), bytes,
+                    target::ptr_to_uintptr( UTOPIAOS_CALL_SITE() ) } );
+    
+    upstream->deallocate( p, bytes, alignment );
+}
+
+bool recording_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (this == &other);
+}
+
+/** \} */
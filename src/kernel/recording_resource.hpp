@@ -0,0 +1,238 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/recording_resource.hpp
+ * \brief This file declares the \a recording_resource
+ *        class, that records the requests to another
+ *        memory resource into a binary allocation trace.
+ */
+
+#ifndef H_kernel_recording_resource
+#define H_kernel_recording_resource
+
+#include "fallible_resource.hpp"
+
+#include "target/target.hpp"
+
+#include <memory_resource>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \brief The magic number of an allocation trace */
+            static constexpr std::uint32_t allocation_trace_magic = 0x54416155; // "UaAT"
+            
+            /** \brief The version of the allocation trace layout */
+            static constexpr std::uint32_t allocation_trace_version = 1;
+            
+            /** \struct allocation_trace_header
+             * \brief The header of an allocation trace, that
+             *        is followed by the records.
+             */
+            struct allocation_trace_header
+            {
+                std::uint32_t magic;
+                std::uint32_t version;
+                std::uint64_t capacity; /**< The number of records */
+                std::atomic<std::uint64_t> head; /**< The number of reserved records */
+                std::atomic<std::uint64_t> dropped; /**< The number of lost records */
+            };
+            
+            /** \struct allocation_record
+             * \brief The layout of one request in an
+             *        allocation trace.
+             *
+             * \a tag holds the kind in its lowest byte and the
+             * processor above. It is written last, so that a
+             * record whose tag is zero is still incomplete.
+             */
+            struct allocation_record
+            {
+                std::atomic<std::uint32_t> tag;
+                std::uint32_t alignment;
+                std::uint64_t timestamp;
+                std::uint64_t address;
+                std::uint64_t bytes;
+                std::uint64_t call_site;
+            };
+            static_assert( sizeof(allocation_record) == 5 * sizeof(std::uint64_t),
+                          "The records of an allocation trace have to be packed." );
+        }
+        
+        /** \enum allocation_event_kind
+         * \brief The kinds of requests in an allocation trace.
+         */
+        enum class allocation_event_kind : std::uint8_t
+        {
+            allocate = 1, /**< A satisfied allocation */
+            deallocate = 2, /**< A deallocation */
+            failure = 3 /**< An allocation that could not be satisfied */
+        };
+        
+        /** \struct allocation_event
+         * \brief A request as it is read from an allocation trace.
+         */
+        struct allocation_event
+        {
+            allocation_event_kind kind;
+            std::uint16_t cpu; /**< The processor that made the request */
+            std::uint32_t alignment;
+            std::uint64_t timestamp; /**< The value of \a UTOPIAOS_TIMESTAMP() */
+            std::uint64_t address; /**< The allocated memory, \a 0 for failures */
+            std::uint64_t bytes;
+            std::uint64_t call_site; /**< The return address of the request */
+        };
+        
+        /** \class allocation_trace
+         * \brief A buffer of allocation records, that can
+         *        be saved and replayed by another program.
+         *
+         * Records are appended without locking until the buffer
+         * is full, from then on they are counted as dropped.
+         *
+         * \note The buffer is laid out in host byte order and
+         *       does not contain any pointers.
+         */
+        class allocation_trace
+        {
+        private:
+            detail::allocation_trace_header *header;
+            detail::allocation_record *records;
+        public:
+            /** \brief Constructs an \a allocation_trace object
+             * \param[in] storage The memory for the buffer, which
+             *            has to be aligned to 8 bytes and outlive
+             *            the object.
+             * \param[in] size The size of the memory
+             *
+             * \throws std::invalid_argument if \a size is smaller
+             *         than the header of the buffer.
+             */
+            allocation_trace( void *storage, std::size_t size );
+            
+            /** \brief Appends a record.
+             * \param[in] event The request to record
+             */
+            void write( const allocation_event &event ) noexcept;
+            
+            /** \brief Returns the number of bytes of the buffer
+             *         that hold the header and the records, i.e.
+             *         the part that has to be saved.
+             */
+            std::size_t used_bytes( void ) const noexcept;
+            
+            /** \brief Returns the number of lost records.
+             * \returns The number of records that did not
+             *          fit into the buffer.
+             */
+            std::uint64_t dropped( void ) const
+            { return header->dropped.load( std::memory_order_relaxed ); }
+        };
+        
+        /** \class allocation_trace_view
+         * \brief Reads the records of an allocation trace.
+         */
+        class allocation_trace_view
+        {
+        private:
+            const detail::allocation_trace_header *header;
+            const detail::allocation_record *records;
+            std::size_t count;
+        public:
+            /** \brief Constructs an \a allocation_trace_view object
+             * \param[in] trace The memory of the trace, as written
+             *            by an \a allocation_trace object
+             * \param[in] size The size of the memory
+             *
+             * \throws std::invalid_argument if the memory does not
+             *         hold an allocation trace or is truncated.
+             */
+            allocation_trace_view( const void *trace, std::size_t size );
+            
+            /** \brief Returns the number of records, including
+             *         incomplete ones.
+             */
+            std::size_t size( void ) const
+            { return count; }
+            
+            /** \brief Reads a record.
+             * \param[in] index The index of the record
+             * \param[out] event The request
+             * \returns \a false if the record is incomplete,
+             *          i.e. it was still being written.
+             */
+            bool read( std::size_t index, allocation_event &event ) const noexcept;
+            
+            /** \brief Returns the number of lost records. */
+            std::uint64_t dropped( void ) const
+            { return header->dropped.load( std::memory_order_relaxed ); }
+        };
+        
+        /** \class recording_resource
+         * \brief A subclass of \a std::pmr::memory_resource that
+         *        forwards every request to another resource and
+         *        records it into an \a allocation_trace.
+         *
+         * The resource is thread-safe if the upstream one is.
+         * Allocations are recorded once they are satisfied and
+         * deallocations before they are forwarded, so that the
+         * trace never lists memory as allocated twice.
+         */
+        class recording_resource : public fallible_resource
+        {
+        private:
+            std::pmr::memory_resource *upstream;
+            allocation_trace *trace;
+            
+            /** \brief Forwards and records an allocation.
+             * \param[in] call_site The return address of the request
+             */
+            void *record_allocation( std::size_t bytes, std::size_t alignment,
+                                    const void *call_site ) noexcept;
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified by the c++ standard
+             * \throws std::bad_alloc if the upstream resource
+             *         cannot satisfy the request.
+             */
+            virtual void* do_allocate( std::size_t bytes, std::size_t alignment );
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes, std::size_t alignment );
+            
+            /** \brief As specified by the c++ standard */
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+        public:
+            /** \brief Constructs a \a recording_resource object
+             * \param[in] upstream_resource The resource to forward to
+             * \param[in] allocation_trace The trace to record into
+             */
+            recording_resource( std::pmr::memory_resource *upstream_resource,
+                               allocation_trace *allocation_trace )
+            : upstream( upstream_resource ), trace( allocation_trace ) {}
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            recording_resource( const recording_resource & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            recording_resource &operator=( const recording_resource & ) = delete;
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,218 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/scheduler.cpp
+ * \brief This file contains the definitions for
+ *        the \a scheduler class.
+ */
+
+#include "scheduler.hpp"
+
+#include "utils/bitwise.hpp"
+
+#include <stdexcept>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::task;
+using detail::task_deque;
+using detail::processor_tasks;
+
+bool task_deque::push( task *t ) noexcept
+{
+    std::int64_t b = bottom.load( std::memory_order_relaxed );
+    std::int64_t t0 = top.load( std::memory_order_acquire );
+    if( b - t0 > mask )
+        return false;
+    
+    slots[b & mask].store( t, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    bottom.store( b + 1, std::memory_order_relaxed );
+    return true;
+}
+
+task *task_deque::pop( void ) noexcept
+{
+    std::int64_t b = bottom.load( std::memory_order_relaxed ) - 1;
+    bottom.store( b, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    std::int64_t t0 = top.load( std::memory_order_relaxed );
+    
+    if( t0 > b )
+    {
+        // The deque was empty
+        bottom.store( b + 1, std::memory_order_relaxed );
+        return nullptr;
+    }
+    
+    task *result = slots[b & mask].load( std::memory_order_relaxed );
+    if( t0 == b )
+    {
+        // This is the last task, which a thief may take as well
+        if( top.compare_exchange_strong( t0, t0 + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed ) == false )
+            result = nullptr;
+        
+        bottom.store( b + 1, std::memory_order_relaxed );
+    }
+    
+    return result;
+}
+
+task *task_deque::steal( void ) noexcept
+{
+    std::int64_t t0 = top.load( std::memory_order_acquire );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    std::int64_t b = bottom.load( std::memory_order_acquire );
+    
+    if( t0 >= b )
+        return nullptr;
+    
+    task *result = slots[t0 & mask].load( std::memory_order_relaxed );
+    if( top.compare_exchange_strong( t0, t0 + 1,
+                                    std::memory_order_seq_cst,
+                                    std::memory_order_relaxed ) == false )
+        return nullptr;
+    
+    return result;
+}
+
+processor_tasks::processor_tasks( std::atomic<task *> *slots, task *pool, std::size_t capacity,
+                                 std::uint32_t index, std::size_t first_victim )
+: deque( slots, capacity ), free_tasks( nullptr ), next_victim( first_victim )
+{
+    for( std::size_t i = capacity; i != 0; --i )
+    {
+        task *t = new (pool + i - 1) task;
+        t->owner = index;
+        t->next = free_tasks;
+        free_tasks = t;
+    }
+}
+
+scheduler::scheduler( std::pmr::memory_resource *resource,
+                     std::size_t processors,
+                     std::size_t capacity )
+: memory( resource ), num_processors( processors ),
+tasks_per_processor( capacity ), stopped( false )
+{
+    if( processors == 0 || processors > max_processors )
+        throw std::invalid_argument( "The number of processors is not supported." );
+    
+    if( utils::popcount( tasks_per_processor ) != 1 )
+        throw std::invalid_argument( "The number of tasks has to be a power of two." );
+    
+    std::size_t total = num_processors * tasks_per_processor;
+    tasks = static_cast<task *>( memory->allocate( total * sizeof(task), alignof(task) ) );
+    try
+    {
+        slots = static_cast<std::atomic<task *> *>(
+            memory->allocate( total * sizeof(std::atomic<task *>),
+                             alignof(std::atomic<task *>) ) );
+    } catch( ... )
+    {
+        memory->deallocate( tasks, total * sizeof(task), alignof(task) );
+        throw;
+    }
+    
+    for( std::size_t i = 0; i != total; ++i )
+        new (slots + i) std::atomic<task *>( nullptr );
+    
+    for( std::size_t index = 0; index != num_processors; ++index )
+        new (&processor_storage[index]) processor_tasks( slots + index * tasks_per_processor,
+                                                        tasks + index * tasks_per_processor,
+                                                        tasks_per_processor,
+                                                        static_cast<std::uint32_t>( index ),
+                                                        (index + 1) % num_processors );
+}
+
+scheduler::~scheduler( void )
+{
+    for( std::size_t index = 0; index != num_processors; ++index )
+    {
+        processor_tasks &processor = processor_at( index );
+        for( task *t = processor.deque.steal(); t != nullptr; t = processor.deque.steal() )
+            t->invoke( t, false );
+        
+        processor.~processor_tasks();
+    }
+    
+    std::size_t total = num_processors * tasks_per_processor;
+    memory->deallocate( slots, total * sizeof(std::atomic<task *>),
+                       alignof(std::atomic<task *>) );
+    memory->deallocate( tasks, total * sizeof(task), alignof(task) );
+}
+
+task *scheduler::allocate_task( processor_tasks &local ) noexcept
+{
+    if( local.free_tasks == nullptr )
+        local.free_tasks = local.returned_tasks.pop_all();
+    
+    task *t = local.free_tasks;
+    if( t != nullptr )
+        local.free_tasks = t->next;
+    
+    return t;
+}
+
+void scheduler::release_task( task *t, std::size_t current ) noexcept
+{
+    processor_tasks &owner = processor_at( t->owner );
+    if( t->owner == current )
+    {
+        t->next = owner.free_tasks;
+        owner.free_tasks = t;
+    } else
+        owner.returned_tasks.push( t );
+}
+
+task *scheduler::steal( std::size_t current ) noexcept
+{
+    processor_tasks &local = processor_at( current );
+    
+    // Start with the processor that had work the last time,
+    // since it likely spawns more.
+    std::size_t victim = local.next_victim;
+    for( std::size_t i = 1; i != num_processors; ++i )
+    {
+        if( victim == current )
+            victim = (victim + 1) % num_processors;
+        
+        task *t = processor_at( victim ).deque.steal();
+        if( t != nullptr )
+        {
+            local.next_victim = victim;
+            return t;
+        }
+        
+        victim = (victim + 1) % num_processors;
+    }
+    
+    return nullptr;
+}
+
+void scheduler::push( task *t ) noexcept
+{
+    // The deque is as large as the pool, so it never overflows
+    processor_at( current_processor() ).deque.push( t );
+}
+
+bool scheduler::run_one( void ) noexcept
+{
+    std::size_t current = current_processor();
+    
+    task *t = processor_at( current ).deque.pop();
+    if( t == nullptr )
+        t = steal( current );
+    
+    if( t == nullptr )
+        return false;
+    
+    t->invoke( t, true );
+    release_task( t, current );
+    return true;
+}
+
+/** \} */
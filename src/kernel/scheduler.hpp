@@ -0,0 +1,340 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/scheduler.hpp
+ * \brief This file declares the \a scheduler class,
+ *        that runs kernel tasks on all processors
+ *        and balances them by work stealing.
+ */
+
+#ifndef H_kernel_scheduler
+#define H_kernel_scheduler
+
+#include "target/target.hpp"
+#include "utils/mpsc_stack.hpp"
+
+#include <memory_resource>
+#include <type_traits>
+#include <utility>
+#include <atomic>
+#include <array>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct task
+             * \brief A function object waiting to be run,
+             *        that fills a single cache line.
+             *
+             * Tasks are taken from the pool of the processor that
+             * spawns them and are always returned to that pool.
+             */
+            struct alignas(UTOPIAOS_CACHE_LINE_SIZE) task
+            {
+                /** \brief Runs the function object if \a execute
+                 *         is \a true and destroys it.
+                 */
+                void (*invoke)( task *self, bool execute );
+                task *next; /**< The link while the task is in a pool */
+                std::uint32_t owner; /**< The processor whose pool holds the task */
+                alignas(void *) unsigned char closure[UTOPIAOS_CACHE_LINE_SIZE -
+                                                      3 * sizeof(void *)];
+            };
+            static_assert( sizeof(task) == UTOPIAOS_CACHE_LINE_SIZE,
+                          "A task has to fill exactly one cache line." );
+            
+            /** \class task_deque
+             * \brief A Chase-Lev work-stealing deque of a fixed capacity.
+             *
+             * The processor that owns the deque pushes and pops
+             * tasks at the bottom, while any other processor may
+             * steal the oldest task at the top. The owner takes no
+             * lock and only synchronizes with the thieves when the
+             * deque holds a single task.
+             *
+             * \note The memory orders follow the formulation of
+             *       the deque for weak memory models by Lê et al.
+             */
+            class task_deque
+            {
+            private:
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) std::atomic<std::int64_t> top;
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) std::atomic<std::int64_t> bottom;
+                std::atomic<task *> *slots;
+                std::int64_t mask;
+            public:
+                /** \brief Constructs an empty \a task_deque object
+                 * \param[in] storage The slots, whose number has
+                 *            to be a power of two.
+                 * \param[in] capacity The number of slots
+                 */
+                task_deque( std::atomic<task *> *storage, std::size_t capacity )
+                : top( 0 ), bottom( 0 ), slots( storage ),
+                mask( static_cast<std::int64_t>( capacity ) - 1 ) {}
+                
+                task_deque( const task_deque & ) = delete;
+                task_deque &operator=( const task_deque & ) = delete;
+                
+                /** \brief Pushes a task at the bottom.
+                 * \param[in] t The task
+                 * \returns \a false if the deque is full.
+                 * \note Only the owner may call this function.
+                 */
+                bool push( task *t ) noexcept;
+                
+                /** \brief Pops the newest task at the bottom.
+                 * \returns The task or \a nullptr if the deque is empty.
+                 * \note Only the owner may call this function.
+                 */
+                task *pop( void ) noexcept;
+                
+                /** \brief Steals the oldest task at the top.
+                 * \returns The task or \a nullptr if the deque is
+                 *          empty or another processor took the
+                 *          task first.
+                 */
+                task *steal( void ) noexcept;
+            };
+            
+            /** \struct processor_tasks
+             * \brief The tasks of one processor.
+             *
+             * \a free_tasks is only ever touched by the processor
+             * itself. Tasks that other processors ran are returned
+             * through \a returned_tasks, which lives on its own
+             * cache line, since it is written by all of them.
+             */
+            struct alignas(UTOPIAOS_CACHE_LINE_SIZE) processor_tasks
+            {
+                task_deque deque;
+                task *free_tasks;
+                std::size_t next_victim; /**< The processor to steal from first */
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) utils::mpsc_stack<task> returned_tasks;
+                
+                processor_tasks( std::atomic<task *> *slots, task *pool, std::size_t capacity,
+                                std::uint32_t index, std::size_t first_victim );
+            };
+        }
+        
+        /** \class scheduler
+         * \brief Runs short kernel tasks on all processors
+         *        that take part in scheduling.
+         *
+         * Every processor spawns tasks onto its own Chase-Lev
+         * deque and runs them newest first, so that a task mostly
+         * runs where its data is still cached. A processor that
+         * finds its deque empty steals the oldest task of another
+         * processor, starting with the one it last stole from,
+         * and calls an idle function if there is nothing to steal.
+         *
+         * The tasks are carved out of per-processor pools that are
+         * allocated once upon construction, so that spawning never
+         * allocates memory. A task that another processor ran is
+         * returned to the pool of its spawner through a lock-free
+         * queue with a single atomic operation. The deques are as
+         * large as the pools, so they never overflow.
+         *
+         * Processors are identified by \a UTOPIAOS_CURRENT_CPU().
+         *
+         * \note Tasks must not throw, since nothing could handle
+         *       the exception.
+         */
+        class scheduler
+        {
+        public:
+            /** \brief The maximum number of processors */
+            static constexpr std::size_t max_processors = UTOPIAOS_KERNEL_MAX_CPUS;
+            
+            /** \brief The maximum size of a function object
+             *         that can be spawned.
+             */
+            static constexpr std::size_t max_task_size = sizeof(detail::task::closure);
+        private:
+            std::pmr::memory_resource *memory;
+            std::size_t num_processors;
+            std::size_t tasks_per_processor;
+            detail::task *tasks;
+            std::atomic<detail::task *> *slots;
+            std::atomic<bool> stopped;
+            
+            std::array<
+                std::aligned_storage_t<sizeof(detail::processor_tasks),
+                                       alignof(detail::processor_tasks)>,
+                max_processors
+            > processor_storage;
+            
+            /** \brief Returns the tasks of a given processor.
+             * \param[in] index The index of the processor
+             */
+            detail::processor_tasks &processor_at( std::size_t index )
+            {
+                return *std::launder( reinterpret_cast<detail::processor_tasks *>(
+                                          &processor_storage[index] ) );
+            }
+            
+            /** \brief Returns the index of the current processor. */
+            std::size_t current_processor( void ) const
+            { return UTOPIAOS_CURRENT_CPU() % num_processors; }
+            
+            /** \brief Takes a task from the pool of a processor.
+             * \param[inout] local The tasks of the current processor
+             * \returns The task or \a nullptr if the pool is exhausted.
+             */
+            static detail::task *allocate_task( detail::processor_tasks &local ) noexcept;
+            
+            /** \brief Returns a task to the pool it was taken from.
+             * \param[in] t The task
+             * \param[in] current The index of the current processor
+             */
+            void release_task( detail::task *t, std::size_t current ) noexcept;
+            
+            /** \brief Steals a task from another processor.
+             * \param[in] current The index of the current processor
+             * \returns The task or \a nullptr if none was found.
+             */
+            detail::task *steal( std::size_t current ) noexcept;
+            
+            /** \brief Spawns the function object of a task.
+             * \param[in] t The task, whose function object
+             *            has been constructed.
+             */
+            void push( detail::task *t ) noexcept;
+        public:
+            /** \brief Constructs a \a scheduler object
+             * \param[in] resource The resource the pools and the
+             *            deques are allocated from
+             * \param[in] processors The number of processors
+             *            that take part in scheduling
+             * \param[in] capacity The number of tasks every
+             *            processor can have spawned at a time,
+             *            which has to be a power of two.
+             *
+             * \throws std::invalid_argument if \a processors is zero
+             *         or larger than \a max_processors or if
+             *         \a capacity is not a power of two.
+             */
+            scheduler( std::pmr::memory_resource *resource,
+                      std::size_t processors,
+                      std::size_t capacity );
+            
+            scheduler( const scheduler & ) = delete;
+            scheduler &operator=( const scheduler & ) = delete;
+            
+            /** \brief Destroys the tasks that have not been run.
+             *
+             * \note No processor may use the scheduler anymore.
+             */
+            ~scheduler( void );
+            
+            /** \brief Spawns a task on the current processor.
+             * \tparam Function A function object type
+             * \param[in] f The function object
+             * \returns \a false if the pool of the current
+             *          processor is exhausted, in which case
+             *          \a f is discarded.
+             */
+            template<class Function>
+            bool try_spawn( Function f )
+            {
+                static_assert( sizeof(Function) <= max_task_size &&
+                              alignof(Function) <= alignof(void *),
+                              "The function object does not fit into a task." );
+                
+                detail::task *t = allocate_task( processor_at( current_processor() ) );
+                if( t == nullptr )
+                    return false;
+                
+                new (t->closure) Function( std::move( f ) );
+                t->invoke = [] ( detail::task *self, bool execute ) {
+                    Function *function = std::launder( reinterpret_cast<Function *>( self->closure ) );
+                    if( execute )
+                        (*function)();
+                    function->~Function();
+                };
+                push( t );
+                return true;
+            }
+            
+            /** \brief Spawns a task on the current processor.
+             * \tparam Function A function object type
+             * \param[in] f The function object
+             *
+             * If the pool of the current processor is exhausted,
+             * \a f is run right away, which keeps a processor that
+             * spawns faster than the tasks are run from deadlocking.
+             */
+            template<class Function>
+            void spawn( Function f )
+            {
+                if( try_spawn( f ) == false )
+                    f();
+            }
+            
+            /** \brief Spawns a task that repeats a step of work
+             *         until nothing is left to do.
+             * \tparam Step A function object type which returns
+             *         the amount of work it did
+             * \param[in] step The function object
+             *
+             * Every step is a task of its own, so that other
+             * tasks can run and other processors can steal in
+             * between. If the pool is exhausted, steps are run
+             * right away until a task can be spawned.
+             */
+            template<class Step>
+            void spawn_repeatedly( Step step )
+            {
+                auto repeat = [this, step] ( void ) mutable {
+                    if( step() != 0 )
+                        spawn_repeatedly( step );
+                };
+                
+                while( try_spawn( repeat ) == false )
+                    if( step() == 0 )
+                        return;
+            }
+            
+            /** \brief Runs a single task.
+             * \returns \a false if there was no task to run.
+             *
+             * The current processor runs its newest own task
+             * or steals the oldest task of another processor.
+             */
+            bool run_one( void ) noexcept;
+            
+            /** \brief Runs tasks until \a stop is called.
+             * \tparam Idle A function object type
+             * \param[in] idle The function to call whenever
+             *            there is no task to run
+             *
+             * Every processor taking part in scheduling should
+             * call this function once it is started.
+             */
+            template<class Idle>
+            void run( Idle idle )
+            {
+                while( stopped.load( std::memory_order_relaxed ) == false )
+                    if( run_one() == false )
+                        idle();
+            }
+            
+            /** \brief Makes every processor return from \a run
+             *         after its current task.
+             *
+             * Tasks that have not been run are kept.
+             */
+            void stop( void ) noexcept
+            { stopped.store( true, std::memory_order_relaxed ); }
+        };
+    }
+}
+
+#endif
+
+/** \} */
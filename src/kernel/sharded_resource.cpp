@@ -0,0 +1,264 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/sharded_resource.cpp
+ * \brief This file implements the \a sharded_resource
+ *        class, that serves allocations from
+ *        per-processor shards of memory.
+ */
+
+#include "sharded_resource.hpp"
+
+#include "target/target.hpp"
+#include "utils/bitwise.hpp"
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <stdexcept>
+#include <new>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::shard;
+using detail::shard_upstream;
+using detail::owner_route;
+using detail::remote_free;
+
+void *shard_upstream::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    return parent->allocate_arena( bytes, alignment, index );
+}
+
+void shard_upstream::do_deallocate( void* p, std::size_t bytes,
+                                   std::size_t alignment )
+{
+    parent->deallocate_arena( p, bytes, alignment );
+}
+
+bool shard_upstream::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+std::uint8_t &sharded_resource::owner_of( const void *p )
+{
+    std::uintptr_t address = target::ptr_to_uintptr( p );
+    const owner_route *route = utils::last_not_greater( owner_routes.cbegin(),
+                                                       owner_routes.cend(),
+                                                       address,
+                                                       [] ( const owner_route &r ) {
+                                                           return r.region.base();
+                                                       } );
+    
+    utils::debug_assert( route != owner_routes.cend() &&
+                        route->region.base() <= address &&
+                        address - route->region.base() < route->region.size,
+                        "The address is not managed by this resource." );
+    
+    return owners[route->first_entry + address / arena_size -
+                  route->region.base() / arena_size];
+}
+
+void *sharded_resource::allocate_arena( std::size_t bytes, std::size_t alignment,
+                                       std::uint8_t index ) noexcept
+{
+    utils::spinlock_guard guard( &page_lock );
+    
+    void *arena = kernel::try_allocate( page_resource, bytes, alignment );
+    if( arena == nullptr )
+        return nullptr;
+    
+    utils::debug_assert( bytes == arena_size &&
+                        (target::ptr_to_uintptr( arena ) % arena_size) == 0,
+                        "Shards only allocate aligned arenas." );
+    
+    owner_of( arena ) = index;
+    return arena;
+}
+
+void sharded_resource::deallocate_arena( void *p, std::size_t bytes,
+                                        std::size_t alignment )
+{
+    utils::spinlock_guard guard( &page_lock );
+    
+    owner_of( p ) = unowned;
+    page_resource->deallocate( p, bytes, alignment );
+}
+
+void sharded_resource::drain_remote_frees( shard &s )
+{
+    remote_free *current = s.remote_frees.pop_all();
+    
+    while( current != nullptr )
+    {
+        remote_free *next = current->next;
+        s.cache.deallocate( current, current->bytes, current->alignment );
+        current = next;
+    }
+}
+
+void *sharded_resource::try_allocate_pages( std::size_t first, std::size_t bytes,
+                                           std::size_t alignment ) noexcept
+{
+    for( std::size_t i = 0; i != num_shards; ++i )
+    {
+        shard &s = shard_at( (first + i) % num_shards );
+        utils::spinlock_guard guard( &s.lock );
+        
+        void *result = s.pages->try_allocate( bytes, alignment );
+        if( result != nullptr )
+            return result;
+    }
+    
+    return nullptr;
+}
+
+void *sharded_resource::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    if( bytes == 0 )
+        return nullptr;
+    
+    // All shards are configured alike.
+    if( shard_at( 0 ).buddy.can_satisfy( bytes, alignment ) == false )
+    {
+        utils::spinlock_guard guard( &page_lock );
+        return kernel::try_allocate( page_resource, bytes, alignment );
+    }
+    
+    std::size_t current = UTOPIAOS_CURRENT_CPU() % num_shards;
+    shard &local = shard_at( current );
+    void *result;
+    
+    // The buddies serve whatever the headerless
+    // shards cannot.
+    if( is_page_request( bytes, alignment ) &&
+       (result = try_allocate_pages( current, bytes, alignment )) != nullptr )
+        return result;
+    
+    drain_remote_frees( local );
+    
+    result = local.cache.try_allocate( bytes, alignment );
+    if( result != nullptr )
+        return result;
+    
+    // The local shard cannot grow anymore, so take
+    // free blocks from the other shards instead.
+    for( std::size_t i = 1; i != num_shards; ++i )
+    {
+        shard &victim = shard_at( (current + i) % num_shards );
+        utils::spinlock_guard guard( &victim.lock );
+        
+        result = victim.buddy.try_allocate( bytes, alignment );
+        if( result != nullptr )
+            return result;
+    }
+    
+    return nullptr;
+}
+
+void sharded_resource::do_deallocate( void* p, std::size_t bytes,
+                                     std::size_t alignment )
+{
+    if( bytes == 0 )
+        return;
+    
+    // The owner of an arena cannot change while
+    // it contains allocated memory.
+    std::uint8_t owner = owner_of( p );
+    
+    if( owner == unowned )
+    {
+        utils::spinlock_guard guard( &page_lock );
+        page_resource->deallocate( p, bytes, alignment );
+        return;
+    }
+    
+    if( (owner & detail::page_arena) != 0 )
+    {
+        shard &s = shard_at( owner & ~detail::page_arena );
+        utils::spinlock_guard guard( &s.lock );
+        s.pages->deallocate( p, bytes, alignment );
+        return;
+    }
+    
+    if( owner == UTOPIAOS_CURRENT_CPU() % num_shards )
+    {
+        shard_at( owner ).cache.deallocate( p, bytes, alignment );
+        return;
+    }
+    
+    remote_free *node = reinterpret_cast<remote_free *>( p );
+    node->bytes = bytes;
+    node->alignment = alignment;
+    shard_at( owner ).remote_frees.push( node );
+}
+
+bool sharded_resource::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+void sharded_resource::accumulate_statistics( buddy_statistics &buddies,
+                                             cache_statistics &caches )
+{
+    for( std::size_t index = 0; index != num_shards; ++index )
+    {
+        shard &s = shard_at( index );
+        s.cache.accumulate_statistics( caches );
+        
+        utils::spinlock_guard guard( &s.lock );
+        s.buddy.accumulate_statistics( buddies );
+        if( s.pages )
+            s.pages->accumulate_statistics( buddies );
+    }
+}
+
+void sharded_resource::initialize( std::size_t min_block_size )
+{
+    if( num_shards == 0 || num_shards > max_num_shards )
+        throw std::invalid_argument( "The number of shards has to be \
+positive and must not exceed the maximum number of processors." );
+    if( utils::popcount( arena_size ) != 1 )
+        throw std::invalid_argument( "The arena size has to be a \
+power of two." );
+
+    utils::debug_assert( std::adjacent_find( owner_routes.begin(), owner_routes.end(),
+                            [] ( const owner_route &lower, const owner_route &upper ) {
+                                return (lower.region.top() > upper.region.base());
+                            } ) == owner_routes.end(),
+                        "The regions have to be disjoint." );
+    
+    std::size_t entry = 0;
+    for( owner_route &route : owner_routes )
+    {
+        route.first_entry = entry;
+        entry += num_entries( route.region, arena_size );
+    }
+    
+    std::size_t constructed = 0;
+    try
+    {
+        for( ; constructed != num_shards; ++constructed )
+            new (&shard_storage[constructed]) shard( this, std::uint8_t( constructed ),
+                                                    min_block_size, arena_size,
+                                                    page_block_size );
+    } catch( ... )
+    {
+        while( constructed != 0 )
+            shard_at( --constructed ).~shard();
+        
+        throw;
+    }
+}
+
+sharded_resource::~sharded_resource( void )
+{
+    for( std::size_t index = num_shards; index != 0; --index )
+    {
+        drain_remote_frees( shard_at( index - 1 ) );
+        shard_at( index - 1 ).~shard();
+    }
+}
+
+/** \} */
@@ -0,0 +1,433 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/sharded_resource.hpp
+ * \brief This file declares the \a sharded_resource
+ *        class, that serves allocations from
+ *        per-processor shards of memory.
+ */
+
+#ifndef H_kernel_sharded_resource
+#define H_kernel_sharded_resource
+
+#include "fallible_resource.hpp"
+#include "buddy_resource.hpp"
+#include "cached_buddy_resource.hpp"
+#include "headerless_buddy_resource.hpp"
+#include "allocator_statistics.hpp"
+
+#include "target/target.hpp"
+#include "target/memory.hpp"
+#include "utils/dynarray.hpp"
+#include "utils/spinlock.hpp"
+#include "utils/mpsc_stack.hpp"
+#include "utils/ranges.hpp"
+#include "utils/debug.hpp"
+
+#include <memory_resource>
+#include <type_traits>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <optional>
+#include <limits>
+#include <array>
+#include <new>
+
+#include <boost/iterator/counting_iterator.hpp>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        class sharded_resource;
+        
+        namespace detail
+        {
+            /** \class shard_upstream
+             * \brief The upstream resource of a shard, that
+             *        obtains arenas from the shared page
+             *        resource and records the shard as
+             *        their owner.
+             */
+            class shard_upstream : public fallible_resource
+            {
+            private:
+                sharded_resource *parent;
+                std::uint8_t index;
+                
+                /** \brief As specified by \a fallible_resource */
+                virtual void* do_try_allocate( std::size_t bytes,
+                                              std::size_t alignment ) noexcept;
+                
+                /** \brief As specified by the c++ standard */
+                virtual void do_deallocate( void* p, std::size_t bytes,
+                                           std::size_t alignment );
+                
+                virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            public:
+                shard_upstream( sharded_resource *p, std::uint8_t i )
+                : parent( p ), index( i ) {}
+            };
+            
+            /** \struct remote_free
+             * \brief The bookkeeping information that is stored
+             *        in an allocation while it waits to be
+             *        returned to the shard that owns it.
+             */
+            struct remote_free
+            {
+                remote_free *next;
+                std::size_t bytes;
+                std::size_t alignment;
+            };
+            
+            static_assert( sizeof(remote_free) <= sizeof(memory_block_info),
+                          "Every allocation of a buddy_resource has to be \
+able to hold a remote_free." );
+
+            /** \brief The flag of the owner entries of the
+             *         arenas that hold whole-page blocks.
+             */
+            static constexpr std::uint8_t page_arena = 0x80;
+            
+            /** \struct shard
+             * \brief The memory of one processor.
+             *
+             * The magazines of \a cache are only ever touched by
+             * the processor the shard belongs to. The lock protects
+             * \a buddy, which is also accessed by other processors
+             * that steal from it. Other processors return memory
+             * through \a remote_frees, which lives on its own cache
+             * line, since it is written by all of them.
+             *
+             * If \a pages is engaged, it serves the power-of-two
+             * requests of at least a page under the same lock.
+             * It has arenas of its own, so that its blocks are
+             * not doubled by the header of a \a buddy_resource.
+             */
+            struct alignas(UTOPIAOS_CACHE_LINE_SIZE) shard
+            {
+                utils::spinlock lock;
+                shard_upstream upstream;
+                buddy_resource buddy;
+                cached_buddy_resource cache;
+                shard_upstream page_upstream;
+                std::optional<headerless_buddy_resource> pages;
+                alignas(UTOPIAOS_CACHE_LINE_SIZE) utils::mpsc_stack<remote_free> remote_frees;
+                
+                shard( sharded_resource *parent, std::uint8_t index,
+                      std::size_t min_block_size, std::size_t arena_size,
+                      std::size_t page_block_size )
+                : upstream( parent, index ),
+                buddy( min_block_size, arena_size, arena_size, &upstream ),
+                cache( &buddy, arena_size / 16,
+                      cached_buddy_resource::default_magazine_capacity, &lock ),
+                page_upstream( parent, std::uint8_t( index | page_arena ) )
+                {
+                    buddy.set_trim_watermarks( 1, 2 );
+                    if( page_block_size != 0 )
+                        pages.emplace( page_block_size, arena_size, &page_upstream );
+                }
+            };
+            
+            /** \struct owner_route
+             * \brief Locates the owner entries of the arenas
+             *        within one memory region.
+             */
+            struct owner_route
+            {
+                target::memory_region region;
+                std::size_t first_entry;
+                
+                bool operator<( const owner_route &other ) const
+                { return (region.base() < other.region.base()); }
+            };
+        }
+        
+        /** \class sharded_resource
+         * \brief A thread-safe subclass of \a std::pmr::memory_resource
+         *        that splits the memory among the processors.
+         *
+         * Every processor allocates from its own shard, which is
+         * a \a cached_buddy_resource in front of a \a buddy_resource.
+         * The shards obtain their memory in arenas of a fixed size
+         * from a shared page resource. Cached allocations and
+         * deallocations take no lock at all. Refilling and draining
+         * the cache take the lock of the shard and only growing or
+         * trimming a shard takes the lock of the page resource.
+         *
+         * Memory is always returned to the shard that owns its
+         * arena. Memory freed by another processor is pushed onto
+         * a lock-free queue of the owning shard with a single
+         * atomic operation. The owner takes these allocations back
+         * in one batch upon its next allocation or in \a collect.
+         * If the shard of the current processor runs out of
+         * memory, the request is stolen from the other shards.
+         *
+         * Requests that are too large for an arena are forwarded
+         * to the page resource.
+         *
+         * Optionally, power-of-two requests from the page block
+         * size up to half an arena are served by a
+         * \a headerless_buddy_resource per shard instead, which
+         * needs half the memory for them. These are freed under
+         * the lock of the owning shard, even remotely. Its arenas
+         * are never returned to the page resource.
+         */
+        class sharded_resource : public fallible_resource
+        {
+            friend class detail::shard_upstream;
+        public:
+            /** \brief The maximum number of shards */
+            static constexpr std::size_t max_num_shards = UTOPIAOS_KERNEL_MAX_CPUS;
+        private:
+            static constexpr std::uint8_t unowned =
+                std::numeric_limits<std::uint8_t>::max();
+            
+            static_assert( max_num_shards <= detail::page_arena &&
+                          ((max_num_shards - 1) | detail::page_arena) < unowned,
+                          "Too many shards for the owner table." );
+            
+            using route_allocator = std::pmr::polymorphic_allocator<detail::owner_route>;
+            using route_container = utils::dynarray<detail::owner_route, route_allocator>;
+            
+            using owner_allocator = std::pmr::polymorphic_allocator<std::uint8_t>;
+            using owner_container = utils::dynarray<std::uint8_t, owner_allocator>;
+            
+            std::pmr::memory_resource *page_resource;
+            utils::spinlock page_lock;
+            
+            std::size_t arena_size;
+            
+            /** \brief The smallest block of the headerless
+             *         shards or \a 0 if they are disabled.
+             */
+            std::size_t page_block_size;
+            
+            /** \brief The routes to the owner entries,
+             *         sorted by the base of their regions.
+             */
+            route_container owner_routes;
+            
+            /** \brief The index of the shard that owns an arena
+             *         or \a unowned, with one entry for every
+             *         arena-aligned block of every region.
+             */
+            owner_container owners;
+            
+            std::size_t num_shards;
+            std::array<
+                std::aligned_storage_t<sizeof(detail::shard), alignof(detail::shard)>,
+                max_num_shards
+            > shard_storage;
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            
+            /** \brief Returns the shard of a given index.
+             * \param[in] index The index of the shard
+             * \returns The shard with the index \a index
+             */
+            detail::shard &shard_at( std::size_t index )
+            { return *std::launder( reinterpret_cast<detail::shard *>( &shard_storage[index] ) ); }
+            
+            /** \brief Returns the allocations freed by other
+             *         processors to a shard.
+             * \param[inout] s The shard, which has to belong
+             *               to the current processor.
+             */
+            static void drain_remote_frees( detail::shard &s );
+            
+            /** \brief Returns whether a request is served by
+             *         the headerless shards.
+             * \param[in] bytes The size of the request
+             * \param[in] alignment The alignment of the request
+             */
+            bool is_page_request( std::size_t bytes, std::size_t alignment ) const
+            {
+                return (page_block_size != 0 && bytes >= page_block_size &&
+                        bytes < arena_size && utils::popcount( bytes ) == 1 &&
+                        alignment <= bytes);
+            }
+            
+            /** \brief Allocates from the headerless shards,
+             *         starting with a given one.
+             * \param[in] first The index of the first shard
+             * \param[in] bytes The size of the request
+             * \param[in] alignment The alignment of the request
+             * \returns The memory or \a nullptr if no headerless
+             *          shard can satisfy the request.
+             */
+            void *try_allocate_pages( std::size_t first, std::size_t bytes,
+                                     std::size_t alignment ) noexcept;
+            
+            /** \brief Returns the number of arena-aligned
+             *         blocks a region intersects.
+             * \param[in] region The region
+             * \param[in] arena_size The arena size
+             * \returns The number of owner entries of \a region
+             */
+            static std::size_t num_entries( const target::memory_region &region,
+                                           std::size_t arena_size )
+            {
+                if( region.size == 0 )
+                    return 0;
+                
+                return ((region.base() + region.size - 1) / arena_size -
+                        region.base() / arena_size + 1);
+            }
+            
+            /** \brief Returns the owner entry of an address.
+             * \param[in] p The address
+             * \returns The entry of the owner table that
+             *          describes the arena containing \a p.
+             * \note \a p has to be contained in one of the
+             *       regions otherwise the behaviour is
+             *       undefined.
+             */
+            std::uint8_t &owner_of( const void *p );
+            
+            /** \brief Allocates an arena for a shard from
+             *         the page resource.
+             * \param[in] bytes The size of the arena
+             * \param[in] alignment The alignment of the arena
+             * \param[in] index The index of the shard
+             * \returns The arena or \a nullptr if the
+             *          page resource is exhausted.
+             */
+            void *allocate_arena( std::size_t bytes, std::size_t alignment,
+                                 std::uint8_t index ) noexcept;
+            
+            /** \brief Returns an arena to the page resource.
+             * \param[in] p The arena
+             * \param[in] bytes The size of the arena
+             * \param[in] alignment The alignment of the arena
+             */
+            void deallocate_arena( void *p, std::size_t bytes,
+                                  std::size_t alignment );
+            
+            /** \brief Sets up the owner table and the shards.
+             * \throws std::invalid_argument if the parameters
+             *         are unsupported.
+             */
+            void initialize( std::size_t min_block_size );
+        public:
+            /** \brief Constructs a \a sharded_resource object
+             * \tparam RegionIterator A random access iterator to
+             *         \a target::memory_region objects
+             * \param[in] region_begin The begin of the regions
+             *            managed by \a upstream
+             * \param[in] region_end The end of the regions
+             *            managed by \a upstream
+             * \param[in] upstream The page resource, which has to
+             *            be able to allocate arenas aligned to
+             *            their size. It is also used to allocate
+             *            the owner table.
+             * \param[in] shards The number of shards.
+             * \param[in] min_block_size The minimum block size
+             *            of the shards.
+             * \param[in] arena The size of the arenas.
+             * \param[in] page_block The smallest block of the
+             *            headerless shards, e.g. the page size,
+             *            or \a 0 to serve all requests from
+             *            the buddies.
+             *
+             * \throws std::invalid_argument if the parameters
+             *         are unsupported.
+             */
+            template<class RegionIterator>
+            sharded_resource( RegionIterator region_begin,
+                             RegionIterator region_end,
+                             std::pmr::memory_resource *upstream,
+                             std::size_t shards,
+                             std::size_t min_block_size,
+                             std::size_t arena,
+                             std::size_t page_block )
+            : page_resource( upstream ), arena_size( arena ), page_block_size( page_block ),
+            owner_routes( region_begin, region_end, route_allocator( upstream ),
+                         [] ( detail::owner_route *r, const target::memory_region &region ) {
+                             new (r) detail::owner_route{ region, 0 };
+                         } ),
+            owners( boost::make_counting_iterator( std::size_t( 0 ) ),
+                   boost::make_counting_iterator(
+                        std::accumulate( region_begin, region_end, std::size_t( 0 ),
+                                        [arena] ( std::size_t sum,
+                                                 const target::memory_region &region ) {
+                                            return sum + num_entries( region, arena );
+                                        } ) ),
+                   owner_allocator( upstream ),
+                   [] ( std::uint8_t *entry, std::size_t ) {
+                       *entry = unowned;
+                   } ),
+            num_shards( shards )
+            {
+                std::sort( owner_routes.begin(), owner_routes.end() );
+                initialize( min_block_size );
+            }
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            sharded_resource( const sharded_resource & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            sharded_resource( sharded_resource && ) = delete;
+            
+            virtual ~sharded_resource( void );
+            
+            /** \brief Takes back the memory that other processors
+             *         freed to the shard of the current processor.
+             *
+             * This happens upon every allocation anyway, but a
+             * processor that rarely allocates should call this
+             * function periodically, e.g. from its timer.
+             */
+            void collect( void )
+            { drain_remote_frees( shard_at( UTOPIAOS_CURRENT_CPU() % num_shards ) ); }
+            
+            /** \brief Calls a function while the page resource
+             *         is locked.
+             * \tparam Function The function object type
+             * \param[in] function The function to call
+             *
+             * This allows to change the page frame allocators
+             * underneath the page resource safely.
+             *
+             * \warning \a function must not allocate from
+             *          this resource.
+             */
+            template<class Function>
+            void with_pages_locked( Function function )
+            {
+                utils::spinlock_guard guard( &page_lock );
+                function();
+            }
+            
+            /** \brief Adds the figures of the shards to
+             *         a snapshot.
+             * \param[inout] buddies The snapshot of the buddies
+             * \param[inout] caches The snapshot of the caches
+             *
+             * The lock of every shard is taken while its
+             * buddy is examined. The headerless shards are
+             * added to \a buddies.
+             */
+            void accumulate_statistics( buddy_statistics &buddies,
+                                       cache_statistics &caches );
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,244 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/static_buddy_resource.hpp
+ * \brief This file contains the \a static_buddy_resource
+ *        class template, that implements the buddy method
+ *        for block sizes known at compile time.
+ */
+
+#ifndef H_kernel_static_buddy_resource
+#define H_kernel_static_buddy_resource
+
+#include "buddy_resource.hpp"
+#include "constants.hpp"
+#include "fallible_resource.hpp"
+#include "allocator_statistics.hpp"
+
+#include "utils/bitwise.hpp"
+#include "target/memory.hpp"
+
+#include <memory_resource>
+#include <limits>
+#include <array>
+#include <new>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct static_buddy_geometry
+             * \brief The block sizes of a \a static_buddy_resource.
+             */
+            template<std::size_t MinBlock, std::size_t MaxBlock, std::size_t TopAlign>
+            struct static_buddy_geometry
+            {
+                static constexpr std::size_t min_block_size = MinBlock;
+                static constexpr std::size_t max_block_size = MaxBlock;
+                static constexpr std::size_t top_level_block_alignment =
+                    (TopAlign > max_align ? TopAlign : max_align);
+                
+                static constexpr std::size_t min_msb = utils::msb( min_block_size );
+                static constexpr std::size_t max_msb = utils::msb( max_block_size );
+                static constexpr std::size_t max_block_level = max_msb - min_msb;
+                static constexpr std::size_t num_block_levels = max_block_level + 1;
+            };
+        }
+        
+        /** \class static_buddy_resource
+         * \brief A conforming subclass of \a std::pmr::memory_resource
+         *        that implements the 'buddy method' like a
+         *        \a buddy_resource whose block sizes are fixed
+         *        at compile time.
+         * \tparam MinBlock The minimum block size
+         * \tparam MaxBlock The maximum block size, which is the
+         *         size of the top-level blocks.
+         * \tparam TopAlign The alignment of the top-level blocks
+         *
+         * All quantities derived from the block sizes are constants,
+         * so that finding the level of a request with a constant
+         * size folds to a constant as well, and the free lists are
+         * part of the object. Callers that know the concrete type
+         * bind to the non-virtual \a allocate, \a try_allocate and
+         * \a deallocate, which can be inlined. The virtual interface
+         * forwards to the same functions.
+         */
+        template<std::size_t MinBlock = smallest_memory_chunk,
+                 std::size_t MaxBlock = pagesize,
+                 std::size_t TopAlign = MaxBlock>
+        class static_buddy_resource final
+        : public fallible_resource,
+          private detail::buddy_core<
+            detail::static_buddy_geometry<MinBlock, MaxBlock, TopAlign>,
+            std::array<detail::memory_block_info *,
+                       detail::static_buddy_geometry<MinBlock, MaxBlock, TopAlign>::num_block_levels>
+          >
+        {
+            using geometry = detail::static_buddy_geometry<MinBlock, MaxBlock, TopAlign>;
+            using core = detail::buddy_core<
+                geometry,
+                std::array<detail::memory_block_info *, geometry::num_block_levels>
+            >;
+        public:
+            using core::min_block_size;
+            using core::max_block_size;
+            using core::top_level_block_alignment;
+        private:
+            using core::min_msb;
+            using core::max_block_level;
+            using core::num_block_levels;
+            
+            static_assert( utils::popcount( min_block_size ) == 1,
+                          "The minimum block size has to be a power of two." );
+            static_assert( utils::popcount( max_block_size ) == 1,
+                          "The maximum block size has to be a power of two." );
+            static_assert( utils::popcount( TopAlign ) == 1,
+                          "The top-level block alignment has to be a power of two." );
+            static_assert( min_block_size <= max_block_size,
+                          "The minimum block size has to be less than or equal \
+to the maximum block size." );
+            static_assert( min_block_size > sizeof(detail::memory_block_info) + detail::padding,
+                          "The minimum block size has to be larger than the \
+per-block bookkeeping information." );
+            static_assert( num_block_levels <= buddy_resource::max_num_allowed_block_levels,
+                          "Too many block levels." );
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept
+            { return try_allocate( bytes, alignment ); }
+            
+            /** \brief As specified by the c++ standard
+             * \throws std::bad_alloc if the request cannot be
+             *         satisfied.
+             */
+            virtual void* do_allocate( std::size_t bytes, std::size_t alignment )
+            { return allocate( bytes, alignment ); }
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment )
+            { deallocate( p, bytes, alignment ); }
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+            { return (std::addressof( other ) == this); }
+        public:
+            /** \brief Constructs a \a static_buddy_resource object
+             * \param[in] upstream_resource The resource the
+             *            top-level blocks are obtained from.
+             */
+            explicit static_buddy_resource( std::pmr::memory_resource *upstream_resource )
+            : core( geometry(), upstream_resource )
+            {}
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            static_buddy_resource( const static_buddy_resource & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            static_buddy_resource( static_buddy_resource && ) = delete;
+            
+            virtual ~static_buddy_resource( void )
+            {
+                // Every block that is not in use has been merged upon
+                // deallocation already, so only top-level blocks remain.
+                trim( 0 );
+            }
+            
+            /** \brief Returns the block level necessary to satisfy
+             *         a given allocation request.
+             * \param[in] bytes The number of bytes requested
+             * \param[in] alignment The requested alignment
+             * \returns The block level or a level larger than the
+             *          largest one if the request cannot be satisfied.
+             */
+            static constexpr std::size_t level_for_allocation_request( std::size_t bytes,
+                                                                      std::size_t alignment )
+            {
+                if( alignment > top_level_block_alignment )
+                    return num_block_levels;
+                
+                std::size_t offset = detail::memory_block_info::data_offset( alignment );
+                if( bytes > std::numeric_limits<std::size_t>::max() - offset )
+                    return num_block_levels;
+                
+                std::size_t required_size = bytes + offset;
+                if( required_size <= min_block_size )
+                    return 0;
+                
+                return (utils::msb( required_size - 1 ) + 1 - min_msb);
+            }
+            
+            /** \brief Checks whether an allocation request fits
+             *         into a top-level block at all.
+             */
+            static constexpr bool can_satisfy( std::size_t bytes,
+                                              std::size_t alignment = detail::max_align )
+            { return (level_for_allocation_request( bytes, alignment ) <= max_block_level); }
+            
+            /** \brief Allocates memory without throwing.
+             * \param[in] bytes The number of bytes to allocate
+             * \param[in] alignment The alignment of the allocation
+             * \returns The allocated memory or \a nullptr if the
+             *          request cannot be satisfied.
+             */
+            void *try_allocate( std::size_t bytes,
+                               std::size_t alignment = detail::max_align ) noexcept
+            {
+                if( bytes == 0 )
+                    return nullptr;
+                
+                std::size_t level = level_for_allocation_request( bytes, alignment );
+                if( level > max_block_level )
+                    return nullptr;
+                
+                detail::memory_block_info *block = this->allocate_block( level );
+                if( block == nullptr )
+                    return nullptr;
+                
+                this->record( [level] ( detail::buddy_counters &c ) { c.levels[level].allocations.add(); } );
+                return block->data( alignment );
+            }
+            
+            /** \brief Allocates memory.
+             * \throws std::bad_alloc if the request cannot be
+             *         satisfied.
+             */
+            void *allocate( std::size_t bytes, std::size_t alignment = detail::max_align )
+            {
+                void *memory = try_allocate( bytes, alignment );
+                
+                if( memory == nullptr && bytes != 0 )
+                    throw std::bad_alloc();
+                
+                return memory;
+            }
+            
+            /** \brief Deallocates memory that was allocated
+             *         with the same size and alignment.
+             */
+            void deallocate( void *p, std::size_t bytes,
+                            std::size_t alignment = detail::max_align ) noexcept
+            {
+                if( bytes == 0 )
+                    return;
+                
+                auto block = target::uintptr_to_ptr<detail::memory_block_info>(
+                    target::ptr_to_uintptr( p ) - detail::memory_block_info::data_offset( alignment ) );
+                this->deallocate_block( block, level_for_allocation_request( bytes, alignment ) );
+            }
+            
+            using core::trim;
+            using core::accumulate_statistics;
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,177 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/zeroed_page_pool.cpp
+ * \brief This file implements the \a zeroed_page_pool
+ *        class, that hands out pages which have been
+ *        cleared in the background.
+ */
+
+#include "zeroed_page_pool.hpp"
+
+#include "target/target.hpp"
+
+#include <memory_resource>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+using namespace UtopiaOS;
+using namespace kernel;
+
+using detail::pool_page;
+
+void kernel::clear_memory( void *p, std::size_t bytes ) noexcept
+{
+    auto current = reinterpret_cast<unsigned char *>( p );
+
+    // Whole cache lines are streamed, so that the stores
+    // are combined before they reach the memory.
+    constexpr std::size_t word = sizeof(std::uint64_t);
+    constexpr std::size_t line = UTOPIAOS_CACHE_LINE_SIZE;
+    std::size_t head = std::min( bytes, (line - target::ptr_to_uintptr( current ) % line) % line );
+    std::memset( current, 0, head );
+    current += head;
+    bytes -= head;
+    
+    if( bytes >= line )
+    {
+        for( ; bytes >= line; bytes -= line, current += line )
+        {
+            auto words = reinterpret_cast<std::uint64_t *>( current );
+            for( std::size_t i = 0; i != line / word; ++i )
+                UTOPIAOS_STREAM_WORD( words + i, 0 );
+        }
+        
+        // Non-temporal stores are weakly ordered, so they have to
+        // be visible before the memory is handed to anyone else.
+        UTOPIAOS_STREAM_FENCE();
+    }
+
+    std::memset( current, 0, bytes );
+}
+
+pool_page *zeroed_page_pool::take_dirty( void ) noexcept
+{
+    if( pending == nullptr )
+        pending = dirty.pop_all();
+    
+    pool_page *page = pending;
+    if( page != nullptr )
+        pending = page->next;
+    
+    return page;
+}
+
+void *zeroed_page_pool::do_try_allocate( std::size_t bytes, std::size_t alignment ) noexcept
+{
+    if( bytes == 0 )
+        return nullptr;
+    
+    // The memory is used right away, so it is
+    // cleared through the caches.
+    if( is_pooled( bytes, alignment ) == false )
+    {
+        void *memory = kernel::try_allocate( upstream, bytes, alignment );
+        if( memory != nullptr )
+            std::memset( memory, 0, bytes );
+        
+        return memory;
+    }
+    
+    pool_page *page;
+    {
+        utils::spinlock_guard guard( &zeroed_lock );
+        
+        page = zeroed;
+        if( page != nullptr )
+        {
+            zeroed = page->next;
+            num_zeroed.fetch_sub( 1, std::memory_order_relaxed );
+        }
+    }
+    
+    if( page != nullptr )
+    {
+        page->next = nullptr;
+        return page;
+    }
+    
+    void *memory = kernel::try_allocate( upstream, pagesize, pagesize );
+    if( memory == nullptr )
+    {
+        utils::spinlock_guard guard( &pending_lock );
+        memory = take_dirty();
+    }
+    
+    if( memory != nullptr )
+        std::memset( memory, 0, pagesize );
+    
+    return memory;
+}
+
+void zeroed_page_pool::do_deallocate( void* p, std::size_t bytes,
+                                     std::size_t alignment )
+{
+    if( bytes == 0 )
+        return;
+    
+    if( is_pooled( bytes, alignment ) == false )
+    {
+        upstream->deallocate( p, bytes, alignment );
+        return;
+    }
+    
+    dirty.push( reinterpret_cast<pool_page *>( p ) );
+}
+
+bool zeroed_page_pool::do_is_equal( const std::pmr::memory_resource& other ) const noexcept
+{
+    return (std::addressof( other ) == this);
+}
+
+std::size_t zeroed_page_pool::scrub( std::size_t max_pages ) noexcept
+{
+    std::size_t processed = 0;
+    for( ; processed != max_pages; ++processed )
+    {
+        pool_page *page;
+        {
+            utils::spinlock_guard guard( &pending_lock );
+            page = take_dirty();
+        }
+        
+        if( page == nullptr )
+            break;
+        
+        if( zeroed_pages() >= capacity )
+        {
+            upstream->deallocate( page, pagesize, pagesize );
+            continue;
+        }
+        
+        clear_memory( page, pagesize );
+        
+        utils::spinlock_guard guard( &zeroed_lock );
+        page->next = zeroed;
+        zeroed = page;
+        num_zeroed.fetch_add( 1, std::memory_order_relaxed );
+    }
+    
+    return processed;
+}
+
+zeroed_page_pool::~zeroed_page_pool( void )
+{
+    for( pool_page *page = take_dirty(); page != nullptr; page = take_dirty() )
+        upstream->deallocate( page, pagesize, pagesize );
+    
+    while( zeroed != nullptr )
+    {
+        pool_page *next = zeroed->next;
+        upstream->deallocate( zeroed, pagesize, pagesize );
+        zeroed = next;
+    }
+}
+
+/** \} */
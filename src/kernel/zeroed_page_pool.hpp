@@ -0,0 +1,161 @@
+/** \ingroup kernel
+ * \{
+ *
+ * \file kernel/zeroed_page_pool.hpp
+ * \brief This file declares the \a zeroed_page_pool
+ *        class, that hands out pages which have been
+ *        cleared in the background.
+ */
+
+#ifndef H_kernel_zeroed_page_pool
+#define H_kernel_zeroed_page_pool
+
+#include "fallible_resource.hpp"
+#include "constants.hpp"
+
+#include "utils/spinlock.hpp"
+#include "utils/mpsc_stack.hpp"
+
+#include <memory_resource>
+#include <cstddef>
+#include <atomic>
+
+namespace UtopiaOS
+{
+    namespace kernel
+    {
+        namespace detail
+        {
+            /** \struct pool_page
+             * \brief The link that is stored in the first
+             *        word of a page while it resides in
+             *        the pool.
+             */
+            struct pool_page
+            {
+                pool_page *next;
+            };
+        }
+        
+        /** \brief Clears memory with non-temporal stores.
+         * \param[in] p The memory to clear
+         * \param[in] bytes The number of bytes to clear
+         *
+         * The stores bypass the caches where the target
+         * supports it, so that clearing does not evict
+         * data that is still in use. They only use general
+         * purpose registers, so no vector state has to be
+         * saved around it.
+         */
+        void clear_memory( void *p, std::size_t bytes ) noexcept;
+        
+        /** \class zeroed_page_pool
+         * \brief A thread-safe subclass of \a std::pmr::memory_resource
+         *        whose allocations are always filled with zeros.
+         *
+         * Pages that are freed to the pool are not returned to
+         * the upstream resource right away. They are kept dirty
+         * until \a scrub clears them, which a processor should
+         * do whenever it is idle. Single pages are then served
+         * from the cleared pages first, so that clearing happens
+         * off the allocation path. Only if there are none, a page
+         * is obtained from upstream and cleared on the spot.
+         *
+         * Allocations larger than a page or aligned to more than
+         * a page are always obtained from upstream and cleared
+         * on the spot.
+         */
+        class zeroed_page_pool : public fallible_resource
+        {
+        private:
+            std::pmr::memory_resource *upstream;
+            std::size_t capacity;
+            
+            /** \brief The pages that were freed to the pool */
+            utils::mpsc_stack<detail::pool_page> dirty;
+            
+            /** \brief The pages that were taken off \a dirty
+             *         but have not been scrubbed yet.
+             */
+            detail::pool_page *pending;
+            utils::spinlock pending_lock;
+            
+            /** \brief The pages that are filled with zeros
+             *         except for their link.
+             */
+            detail::pool_page *zeroed;
+            std::atomic<std::size_t> num_zeroed;
+            utils::spinlock zeroed_lock;
+            
+            /** \brief As specified by \a fallible_resource */
+            virtual void* do_try_allocate( std::size_t bytes,
+                                          std::size_t alignment ) noexcept;
+            
+            /** \brief As specified by the c++ standard */
+            virtual void do_deallocate( void* p, std::size_t bytes,
+                                       std::size_t alignment );
+            
+            virtual bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept;
+            
+            /** \brief Takes a page that still has to be scrubbed.
+             * \returns The page or \a nullptr if there is none.
+             * \note \a pending_lock has to be held.
+             */
+            detail::pool_page *take_dirty( void ) noexcept;
+            
+            /** \brief Checks whether a request is served
+             *         from the pool.
+             */
+            static bool is_pooled( std::size_t bytes, std::size_t alignment )
+            { return (bytes <= pagesize && alignment <= pagesize); }
+        public:
+            /** \brief Constructs a \a zeroed_page_pool object
+             * \param[in] up The upstream resource, which has
+             *            to be thread-safe.
+             * \param[in] max_zeroed The maximum number of cleared
+             *            pages to keep. Scrubbed pages beyond it
+             *            are returned to \a up.
+             */
+            zeroed_page_pool( std::pmr::memory_resource *up, std::size_t max_zeroed )
+            : upstream( up ), capacity( max_zeroed ), pending( nullptr ),
+            zeroed( nullptr ), num_zeroed( 0 )
+            {}
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         copyable.
+             */
+            zeroed_page_pool( const zeroed_page_pool & ) = delete;
+            
+            /** \brief A std::pmr::memory_resource should not be
+             *         movable.
+             */
+            zeroed_page_pool( zeroed_page_pool && ) = delete;
+            
+            /** \brief Returns all pages to the upstream resource. */
+            virtual ~zeroed_page_pool( void );
+            
+            /** \brief Clears pages that were freed to the pool.
+             * \param[in] max_pages The maximum number of pages
+             *            to process.
+             * \returns The number of pages that were processed,
+             *          which is \a 0 once there is nothing left
+             *          to do.
+             *
+             * Bounding the number of pages keeps an idle processor
+             * responsive. Several processors may scrub at once.
+             */
+            std::size_t scrub( std::size_t max_pages ) noexcept;
+            
+            /** \brief Returns the number of cleared pages.
+             * \returns The number of pages that can currently
+             *          be allocated without clearing them.
+             */
+            std::size_t zeroed_pages( void ) const
+            { return num_zeroed.load( std::memory_order_relaxed ); }
+        };
+    }
+}
+
+#endif
+
+/** \} */
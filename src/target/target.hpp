@@ -24,12 +24,114 @@
  */
 #define UTOPIAOS_KERNEL_PAGESIZE (std::size_t(1) << 12)
 
+/** \def UTOPIAOS_KERNEL_LARGE_PAGESIZE
+ * \brief Specifies the smallest size of the large
+ *        pages supported by the target.
+ */
+#define UTOPIAOS_KERNEL_LARGE_PAGESIZE (std::size_t(1) << 21)
+
+/** \def UTOPIAOS_KERNEL_HUGE_PAGESIZE
+ * \brief Specifies the largest size of the large
+ *        pages supported by the target.
+ */
+#define UTOPIAOS_KERNEL_HUGE_PAGESIZE (std::size_t(1) << 30)
+
 /** \def UTOPIAOS_TRAP()
  * \brief Causes an immediate halt of the current
  *        thread of execution.
  */
 #define UTOPIAOS_TRAP() __builtin_trap()
 
+/** \def UTOPIAOS_CPU_RELAX()
+ * \brief Tells the processor that the current thread
+ *        of execution is spinning on a lock.
+ */
+#define UTOPIAOS_CPU_RELAX() __builtin_ia32_pause()
+
+/** \def UTOPIAOS_STREAM_WORD( address, value )
+ * \brief Stores a 64-bit word past the caches.
+ * \param[in] address A \a std::uint64_t pointer
+ *            to the destination
+ * \param[in] value The word to store
+ *
+ * Only general-purpose registers are involved, so the
+ * kernel can use this without saving any vector state.
+ */
+#define UTOPIAOS_STREAM_WORD( address, value ) \
+__asm__ __volatile__( "movnti %1, %0" : "=m"( *(address) ) : "r"( std::uint64_t( value ) ) )
+
+/** \def UTOPIAOS_STREAM_FENCE()
+ * \brief Orders all preceding \a UTOPIAOS_STREAM_WORD
+ *        stores before any later store.
+ */
+#define UTOPIAOS_STREAM_FENCE() __asm__ __volatile__( "sfence" ::: "memory" )
+
+/** \def UTOPIAOS_RETAIN
+ * \brief Marks a variable that has to be emitted into
+ *        the binary even if it is never referenced.
+ */
+#define UTOPIAOS_RETAIN __attribute__((used))
+
+/** \def UTOPIAOS_TIMESTAMP()
+ * \brief Returns the value of a counter that increases
+ *        at a constant rate, as an \a std::uint64_t.
+ */
+#define UTOPIAOS_TIMESTAMP() (static_cast<std::uint64_t>( __builtin_ia32_rdtsc() ))
+
+/** \def UTOPIAOS_TIMESTAMP_ORDERED( aux )
+ * \brief Like \a UTOPIAOS_TIMESTAMP(), but waits for all
+ *        preceding instructions to complete first, so that
+ *        it can mark the end of a measured piece of code.
+ * \param aux An \a unsigned int lvalue that receives an
+ *        identifier of the current processor
+ */
+#define UTOPIAOS_TIMESTAMP_ORDERED( aux ) (static_cast<std::uint64_t>( __builtin_ia32_rdtscp( &(aux) ) ))
+
+/** \def UTOPIAOS_CALL_SITE()
+ * \brief Returns the address the current function
+ *        returns to, which identifies its caller.
+ */
+#define UTOPIAOS_CALL_SITE() (__builtin_return_address( 0 ))
+
+/** \def UTOPIAOS_CACHE_LINE_SIZE
+ * \brief Specifies the size of a cache line, which
+ *        data written by different processors should
+ *        not share.
+ */
+#define UTOPIAOS_CACHE_LINE_SIZE (64)
+
+/** \def UTOPIAOS_KERNEL_MAX_CPUS
+ * \brief Specifies the maximum number of processors
+ *        supported by the kernel.
+ */
+#define UTOPIAOS_KERNEL_MAX_CPUS (16)
+
+/** \def UTOPIAOS_CURRENT_CPU()
+ * \brief Returns the index of the processor that executes
+ *        the current thread of execution, which is less
+ *        than \a UTOPIAOS_KERNEL_MAX_CPUS.
+ *
+ * In hosted builds every thread of the host can act as a
+ * processor of its own by setting \a hosted_cpu.
+ *
+ * \todo Read the index from the per-processor data once
+ *       secondary processors are brought up.
+ */
+#if UTOPIAOS_HOSTED
+namespace UtopiaOS
+{
+    namespace target
+    {
+        /** \brief The processor index of the current host thread */
+        inline thread_local unsigned hosted_cpu = 0;
+    }
+}
+
+#define UTOPIAOS_CURRENT_CPU() (std::size_t(UtopiaOS::target::hosted_cpu))
+#else
+#define UTOPIAOS_CURRENT_CPU() (std::size_t(0))
+#endif
+
 /** \def UTOPIAOS_ALLOCA_WITH_ALIGN_HEADER
  * \brief If this macro is defined it contains the header
  *        that needs to be included in order to use
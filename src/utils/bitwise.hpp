@@ -10,27 +10,113 @@
 #define H_utils_bitwise
 
 #include <type_traits>
+#include <limits>
+#include <cstddef>
 
 namespace UtopiaOS
 {
     namespace utils
     {
+        namespace detail
+        {
+            /** \brief Checks that a type can be handled by
+             *         the bit operations below.
+             * \tparam UInteger The type to check
+             */
+            template<class UInteger>
+            constexpr void check_bitwise_type( void )
+            {
+                static_assert( std::is_unsigned<UInteger>::value,
+                              "UInteger has to be an unsigned integer type." );
+                static_assert( std::numeric_limits<UInteger>::digits <=
+                              std::numeric_limits<unsigned long long>::digits,
+                              "UInteger is too wide." );
+            }
+        }
+        
+        /** \brief Counts the leading zero bits.
+         * \tparam UInteger An unsigned integer type (usually inferred)
+         * \param[in] val The value
+         * \returns The number of leading zero bits of \a val,
+         *          which is the number of bits of \a UInteger
+         *          if \a val is zero.
+         */
         template<class UInteger>
-        constexpr std::size_t msb( UInteger val )
+        constexpr std::size_t clz( UInteger val )
         {
-            /** Check assembly and possibly optimize. */
+            detail::check_bitwise_type<UInteger>();
             
-            static_assert( std::is_unsigned<UInteger>::value,
-                          "UInteger has to be an unsigned integer type." );
+            constexpr std::size_t digits = std::numeric_limits<UInteger>::digits;
             
-            std::size_t count = 0;
-            while( val != 0 )
-            {
-                val >>= 1;
-                count++;
-            }
+            if( val == 0 )
+                return digits;
+            
+            if constexpr( digits <= std::numeric_limits<unsigned>::digits )
+                return (__builtin_clz( val ) -
+                        (std::numeric_limits<unsigned>::digits - digits));
+            else if constexpr( digits <= std::numeric_limits<unsigned long>::digits )
+                return (__builtin_clzl( val ) -
+                        (std::numeric_limits<unsigned long>::digits - digits));
+            else
+                return (__builtin_clzll( val ) -
+                        (std::numeric_limits<unsigned long long>::digits - digits));
+        }
+        
+        /** \brief Counts the trailing zero bits.
+         * \tparam UInteger An unsigned integer type (usually inferred)
+         * \param[in] val The value
+         * \returns The number of trailing zero bits of \a val,
+         *          which is the number of bits of \a UInteger
+         *          if \a val is zero.
+         */
+        template<class UInteger>
+        constexpr std::size_t ctz( UInteger val )
+        {
+            detail::check_bitwise_type<UInteger>();
             
-            return count;
+            constexpr std::size_t digits = std::numeric_limits<UInteger>::digits;
+            
+            if( val == 0 )
+                return digits;
+            
+            if constexpr( digits <= std::numeric_limits<unsigned>::digits )
+                return __builtin_ctz( val );
+            else if constexpr( digits <= std::numeric_limits<unsigned long>::digits )
+                return __builtin_ctzl( val );
+            else
+                return __builtin_ctzll( val );
+        }
+        
+        /** \brief Counts the set bits.
+         * \tparam UInteger An unsigned integer type (usually inferred)
+         * \param[in] val The value
+         * \returns The number of bits set in \a val.
+         */
+        template<class UInteger>
+        constexpr std::size_t popcount( UInteger val )
+        {
+            detail::check_bitwise_type<UInteger>();
+            
+            constexpr std::size_t digits = std::numeric_limits<UInteger>::digits;
+            
+            if constexpr( digits <= std::numeric_limits<unsigned>::digits )
+                return __builtin_popcount( val );
+            else if constexpr( digits <= std::numeric_limits<unsigned long>::digits )
+                return __builtin_popcountl( val );
+            else
+                return __builtin_popcountll( val );
+        }
+        
+        /** \brief Returns the position of the most significant bit.
+         * \tparam UInteger An unsigned integer type (usually inferred)
+         * \param[in] val The value
+         * \returns The one-based position of the most significant
+         *          bit set in \a val or zero if \a val is zero.
+         */
+        template<class UInteger>
+        constexpr std::size_t msb( UInteger val )
+        {
+            return (std::numeric_limits<UInteger>::digits - clz( val ));
         }
     }
 }
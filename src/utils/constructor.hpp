@@ -9,6 +9,9 @@
 #ifndef H_utils_constructor
 #define H_utils_constructor
 
+#include <utility>
+#include <new>
+
 namespace UtopiaOS
 {
     namespace utils
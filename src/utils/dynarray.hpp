@@ -79,6 +79,16 @@ namespace UtopiaOS
             
             dynarray( const dynarray & ) = default;
             
+            /** \brief Construct a dynarray from another one
+             *         by stealing its resources.
+             * \param[inout] other The dynarray to steal resources from
+             *
+             * Without it moving would copy the buffer, so that
+             * both dynarrays destroyed the same objects.
+             */
+            dynarray( dynarray &&other )
+            : dynarray( std::move( other ), other.size() ) {}
+            
             dynarray &operator=( const dynarray & ) = delete;
             dynarray &operator=( dynarray && ) = delete;
             
@@ -93,21 +103,21 @@ namespace UtopiaOS
                        constructor )
             {}
             
-            template<class RandomAccessIterator,
+            template<class ForwardIterator,
                 class Constructor = utils::new_constructor<value_type>
             >
-            dynarray( RandomAccessIterator first, RandomAccessIterator last,
+            dynarray( ForwardIterator first, ForwardIterator last,
                      allocator_type &&alloc,
                      Constructor constructor = Constructor() )
             : dynarray( first, last, alloc, constructor ) {}
             
-            template<class RandomAccessIterator,
+            template<class ForwardIterator,
                 class Constructor = utils::new_constructor<value_type>
             >
-            dynarray( RandomAccessIterator first, RandomAccessIterator last,
+            dynarray( ForwardIterator first, ForwardIterator last,
                      const allocator_type &alloc,
                      Constructor constructor = Constructor() )
-            : allocator( alloc ), length( last - first ),
+            : allocator( alloc ), length( std::distance( first, last ) ),
             length_to_deallocate( length ),
             buffer( allocator.allocate( length ) )
             {
@@ -116,8 +126,8 @@ namespace UtopiaOS
                 {
                     while( first != last )
                     {
-                        pointer to_initialize = current++;
-                        constructor( to_initialize, *first );
+                        constructor( current, *first );
+                        ++current;
                         ++first;
                     }
                 } catch( ... )
@@ -148,7 +158,9 @@ namespace UtopiaOS
              */
             dynarray( dynarray &&other, size_type length_to_preserve )
             : allocator( std::move( other.allocator ) ),
-            length( length_to_preserve ), buffer( other.buffer )
+            length( length_to_preserve ),
+            length_to_deallocate( other.length_to_deallocate ),
+            buffer( other.buffer )
             {
                 static_assert( std::is_nothrow_move_constructible<allocator_type>::value,
                               "allocator_type has to be nothrow move constructible" );
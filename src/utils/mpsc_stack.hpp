@@ -0,0 +1,84 @@
+/** \ingroup utils
+ * \{
+ *
+ * \file utils/mpsc_stack.hpp
+ * \brief This file defines a lock-free intrusive stack
+ *        with many producers and a single consumer.
+ */
+
+#ifndef H_utils_mpsc_stack
+#define H_utils_mpsc_stack
+
+#include <target/target.hpp>
+
+#include <atomic>
+
+namespace UtopiaOS
+{
+    namespace utils
+    {
+        /** \class mpsc_stack
+         * \brief An intrusive stack onto which any thread
+         *        can push, but which only a single thread
+         *        empties.
+         * \tparam Node The node type, which has to provide
+         *         a member \a next of type \a Node *.
+         *
+         * Since the consumer always takes the whole stack
+         * at once, nodes are never popped individually and
+         * the stack does not suffer from the ABA problem.
+         */
+        template<class Node>
+        class mpsc_stack
+        {
+        private:
+            std::atomic<Node *> top = { nullptr };
+        public:
+            mpsc_stack( void ) = default;
+            mpsc_stack( const mpsc_stack & ) = delete;
+            mpsc_stack &operator=( const mpsc_stack & ) = delete;
+            
+            /** \brief Pushes a node onto the stack.
+             * \param[in] node The node, which is
+             *            owned by the stack afterwards.
+             */
+            void push( Node *node ) noexcept
+            {
+                node->next = top.load( std::memory_order_relaxed );
+                while( top.compare_exchange_weak( node->next, node,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed ) == false )
+                    UTOPIAOS_CPU_RELAX();
+            }
+            
+            /** \brief Takes all nodes off the stack.
+             * \returns The most recently pushed node, whose
+             *          \a next members link the remaining
+             *          nodes, or \a nullptr if the stack
+             *          is empty.
+             * \note Only one thread may call this function
+             *       at a time.
+             */
+            Node *pop_all( void ) noexcept
+            {
+                // Checking first keeps the cache line
+                // shared while there is nothing to do.
+                if( top.load( std::memory_order_relaxed ) == nullptr )
+                    return nullptr;
+                
+                return top.exchange( nullptr, std::memory_order_acquire );
+            }
+            
+            /** \brief Checks whether the stack is empty.
+             * \returns \a true if no node has been pushed
+             *          since the last call to \a pop_all.
+             */
+            bool empty( void ) const noexcept
+            { return (top.load( std::memory_order_relaxed ) == nullptr); }
+        };
+    }
+}
+
+#endif
+
+/** \} */
@@ -0,0 +1,181 @@
+/** \ingroup utils
+ * \{
+ *
+ * \file utils/radix_sort.hpp
+ * \brief This file defines an in-place radix sort
+ *        for ranges with unsigned integer keys.
+ */
+
+#ifndef H_utils_radix_sort
+#define H_utils_radix_sort
+
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <limits>
+#include <cstddef>
+#include <array>
+
+namespace UtopiaOS
+{
+    namespace utils
+    {
+        namespace detail
+        {
+            /** \brief The number of bits of a radix sort digit */
+            static constexpr unsigned int radix_bits = 8;
+            /** \brief The number of buckets per radix sort digit */
+            static constexpr std::size_t radix_buckets = (std::size_t(1) << radix_bits);
+            /** \brief The size below which buckets are insertion sorted */
+            static constexpr std::ptrdiff_t radix_insertion_threshold = 32;
+            
+            /** \brief Sorts a range by key through insertion.
+             * \tparam RandomAccessIterator The iterator type
+             * \tparam KeyFunction The key projection type
+             * \param[in] first The begin of the range
+             * \param[in] last The end of the range
+             * \param[in] key A function object returning the key
+             *            of an element.
+             */
+            template<class RandomAccessIterator, class KeyFunction>
+            void insertion_sort( RandomAccessIterator first,
+                                RandomAccessIterator last,
+                                KeyFunction key )
+            {
+                if( first == last )
+                    return;
+                
+                for( auto current = first + 1; current != last; ++current )
+                {
+                    auto value = std::move( *current );
+                    auto value_key = key( value );
+                    
+                    auto hole = current;
+                    for( ; hole != first && value_key < key( *(hole - 1) ); --hole )
+                        *hole = std::move( *(hole - 1) );
+                    
+                    *hole = std::move( value );
+                }
+            }
+            
+            /** \brief Sorts a range by the digits of its keys
+             *         up to a given one.
+             * \tparam RandomAccessIterator The iterator type
+             * \tparam KeyFunction The key projection type
+             * \param[in] first The begin of the range
+             * \param[in] last The end of the range
+             * \param[in] key A function object returning the key
+             *            of an element.
+             * \param[in] shift The position of the lowest bit of
+             *            the most significant digit to sort by.
+             *
+             * This is an American flag sort: the elements are
+             * counted per bucket and then cycled into place, so
+             * that no buffer is needed.
+             */
+            template<class RandomAccessIterator, class KeyFunction>
+            void radix_sort( RandomAccessIterator first,
+                            RandomAccessIterator last,
+                            KeyFunction key,
+                            unsigned int shift )
+            {
+                auto digit = [&key, &shift] ( const auto &value ) {
+                    return static_cast<std::size_t>( (key( value ) >> shift) &
+                                                    (radix_buckets - 1) );
+                };
+                
+                std::array<std::ptrdiff_t, radix_buckets> counts;
+                while( true )
+                {
+                    if( last - first <= radix_insertion_threshold )
+                    {
+                        insertion_sort( first, last, key );
+                        return;
+                    }
+                    
+                    counts.fill( 0 );
+                    for( auto current = first; current != last; ++current )
+                        counts[digit( *current )]++;
+                    
+                    // Skip digits that all keys share.
+                    if( std::find( counts.cbegin(), counts.cend(), last - first ) == counts.cend() )
+                        break;
+                    if( shift == 0 )
+                        return;
+                    
+                    shift -= radix_bits;
+                }
+                
+                std::array<std::ptrdiff_t, radix_buckets> heads, tails;
+                std::ptrdiff_t offset = 0;
+                for( std::size_t bucket = 0; bucket != radix_buckets; ++bucket )
+                {
+                    heads[bucket] = offset;
+                    offset += counts[bucket];
+                    tails[bucket] = offset;
+                }
+                
+                using std::swap;
+                for( std::size_t bucket = 0; bucket != radix_buckets; ++bucket )
+                {
+                    while( heads[bucket] != tails[bucket] )
+                    {
+                        auto &element = first[heads[bucket]];
+                        auto element_bucket = digit( element );
+                        
+                        while( element_bucket != bucket )
+                        {
+                            swap( element, first[heads[element_bucket]++] );
+                            element_bucket = digit( element );
+                        }
+                        
+                        heads[bucket]++;
+                    }
+                }
+                
+                if( shift == 0 )
+                    return;
+                
+                std::ptrdiff_t begin = 0;
+                for( std::size_t bucket = 0; bucket != radix_buckets; ++bucket )
+                {
+                    radix_sort( first + begin, first + tails[bucket], key, shift - radix_bits );
+                    begin = tails[bucket];
+                }
+            }
+        }
+        
+        /** \brief Sorts a range by an unsigned integer key.
+         * \tparam RandomAccessIterator The iterator type
+         * \tparam KeyFunction The key projection type
+         * \param[in] first The begin of the range
+         * \param[in] last The end of the range
+         * \param[in] key A function object returning the key
+         *            of an element.
+         *
+         * The range is sorted in place in ascending order of the
+         * keys. The number of steps is linear in the length of
+         * the range and the number of digits of the keys in
+         * which the elements differ. The sort is not stable.
+         */
+        template<class RandomAccessIterator, class KeyFunction>
+        void radix_sort( RandomAccessIterator first,
+                        RandomAccessIterator last,
+                        KeyFunction key )
+        {
+            using key_type = std::decay_t<decltype(key( *first ))>;
+            static_assert( std::is_unsigned<key_type>::value,
+                          "The keys have to be unsigned integers." );
+            static_assert( std::numeric_limits<key_type>::digits % detail::radix_bits == 0,
+                          "The keys have to consist of whole digits." );
+            
+            detail::radix_sort( first, last, key,
+                               std::numeric_limits<key_type>::digits - detail::radix_bits );
+        }
+    }
+}
+
+#endif
+
+/** \} */
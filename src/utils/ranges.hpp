@@ -9,10 +9,15 @@
 #ifndef H_utils_ranges
 #define H_utils_ranges
 
+#include "debug.hpp"
+
 #include <algorithm>
 #include <type_traits>
 #include <memory>
 
+#include <boost/range/iterator_range.hpp>
+#include <boost/range/join.hpp>
+
 namespace UtopiaOS
 {
     namespace utils
@@ -74,6 +79,47 @@ namespace UtopiaOS
             
             return range_by_inserting_reference( range, larger, std::forward<T>( ref ) );
         }
+        
+        /** \brief Given a sorted random access range, find the
+         *         last element whose key does not exceed a value.
+         * \tparam RandomAccessIterator The iterator type
+         * \tparam T The value type
+         * \tparam KeyFunction The key projection type
+         * \param[in] first The begin of the range
+         * \param[in] last The end of the range
+         * \param[in] value The value to compare to
+         * \param[in] key A function object returning the key
+         *            of an element.
+         *
+         * \returns The last element whose key is not greater
+         *          than \a value, \a first if there is no such
+         *          element or \a last if the range is empty.
+         *
+         * The number of iterations only depends on the length of
+         * the range and the selection in every iteration does not
+         * branch, so that the search is predictable.
+         *
+         * \note The range has to be sorted by key in ascending
+         *       order, otherwise the behaviour is undefined.
+         */
+        template<class RandomAccessIterator, class T, class KeyFunction>
+        RandomAccessIterator last_not_greater( RandomAccessIterator first,
+                                              RandomAccessIterator last,
+                                              const T &value, KeyFunction key )
+        {
+            auto length = last - first;
+            if( length == 0 )
+                return last;
+            
+            while( length > 1 )
+            {
+                auto half = length / 2;
+                first = (key( first[half] ) <= value ? first + half : first);
+                length -= half;
+            }
+            
+            return first;
+        }
     }
 }
 
@@ -0,0 +1,88 @@
+/** \ingroup utils
+ * \{
+ *
+ * \file utils/spinlock.hpp
+ * \brief This file defines a simple spinlock.
+ */
+
+#ifndef H_utils_spinlock
+#define H_utils_spinlock
+
+#include <target/target.hpp>
+
+#include <atomic>
+
+namespace UtopiaOS
+{
+    namespace utils
+    {
+        /** \class spinlock
+         * \brief A test-and-test-and-set spinlock that
+         *        satisfies the \a Lockable requirements.
+         */
+        class spinlock
+        {
+        private:
+            std::atomic<bool> locked = { false };
+        public:
+            spinlock( void ) = default;
+            spinlock( const spinlock & ) = delete;
+            spinlock &operator=( const spinlock & ) = delete;
+            
+            void lock( void ) noexcept
+            {
+                while( locked.exchange( true, std::memory_order_acquire ) )
+                {
+                    // Spin on a plain load, so that the cache line
+                    // is not bounced between the waiting processors.
+                    while( locked.load( std::memory_order_relaxed ) )
+                        UTOPIAOS_CPU_RELAX();
+                }
+            }
+            
+            bool try_lock( void ) noexcept
+            {
+                return (locked.load( std::memory_order_relaxed ) == false &&
+                        locked.exchange( true, std::memory_order_acquire ) == false);
+            }
+            
+            void unlock( void ) noexcept
+            { locked.store( false, std::memory_order_release ); }
+        };
+        
+        /** \class spinlock_guard
+         * \brief Holds a spinlock for the duration of a scope.
+         *
+         * If it is constructed from a null pointer,
+         * nothing is locked.
+         */
+        class spinlock_guard
+        {
+        private:
+            spinlock *lock;
+        public:
+            /** \brief Acquires a spinlock
+             * \param[in] l The spinlock or \a nullptr
+             */
+            explicit spinlock_guard( spinlock *l ) noexcept
+            : lock( l )
+            {
+                if( lock != nullptr )
+                    lock->lock();
+            }
+            
+            spinlock_guard( const spinlock_guard & ) = delete;
+            spinlock_guard &operator=( const spinlock_guard & ) = delete;
+            
+            ~spinlock_guard( void )
+            {
+                if( lock != nullptr )
+                    lock->unlock();
+            }
+        };
+    }
+}
+
+#endif
+
+/** \} */